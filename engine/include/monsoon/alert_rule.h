@@ -0,0 +1,76 @@
+#ifndef MONSOON_ALERT_RULE_H
+#define MONSOON_ALERT_RULE_H
+
+#include <monsoon/rule.h>
+#include <monsoon/alert.h>
+#include <monsoon/expression.h>
+#include <monsoon/group_name.h>
+#include <monsoon/simple_group.h>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace monsoon {
+
+
+/**
+ * \brief A rule that raises an alert when its trigger expression is true.
+ *
+ * \details
+ * The trigger is evaluated at each time point.
+ * A vector trigger yields an alert for each tag set, a scalar trigger
+ * yields a single alert.
+ *
+ * While the trigger is true, the alert is \ref alert_state::TRIGGERING "triggering",
+ * until it has been true for at least the trigger duration,
+ * at which point it is \ref alert_state::FIRING "firing".
+ * If the trigger is false, the alert is \ref alert_state::OK "ok".
+ * If the trigger does not yield a boolean value, the alert is
+ * \ref alert_state::UNKNOWN "unknown".
+ */
+class alert_rule
+: public rule
+{
+ public:
+  /**
+   * \brief Create a new alert rule.
+   * \param name The name of the alert.
+   * \param trigger The expression deciding if the alert triggers.
+   * \param trigger_duration How long the trigger must be true before the alert fires.
+   * \param message The alert message.
+   * \param window How much history the trigger expression needs.
+   */
+  alert_rule(simple_group name, expression_ptr trigger,
+      time_point::duration trigger_duration, std::string message,
+      time_point::duration window = time_point::duration(0));
+  ~alert_rule() noexcept override;
+
+  auto operator()(const metric_source& ms, time_point tp)
+  -> std::vector<alert> override;
+  auto window() const noexcept -> time_point::duration override;
+
+ private:
+  struct state_ {
+    alert current;
+    std::optional<time_point> triggered_since;
+  };
+
+  ///\brief Evaluate the trigger at the given time point.
+  auto evaluate_(const metric_source& ms, time_point tp) const
+  -> std::unordered_map<group_name, std::optional<bool>>;
+
+  const simple_group name_;
+  const expression_ptr trigger_;
+  const time_point::duration trigger_duration_;
+  const std::string message_;
+  const time_point::duration window_;
+
+  std::optional<time_point> last_tp_;
+  std::unordered_map<group_name, state_> alerts_;
+};
+
+
+} /* namespace monsoon */
+
+#endif /* MONSOON_ALERT_RULE_H */
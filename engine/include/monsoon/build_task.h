@@ -4,16 +4,31 @@
 #include <monsoon/configuration.h>
 #include <monsoon/time_point.h>
 #include <monsoon/history/collect_history.h>
+#include <monsoon/alert.h>
 #include <objpipe/interlock.h>
+#include <functional>
 #include <memory>
 #include <vector>
 
 namespace monsoon {
 
 
+/**
+ * \brief Build the task that collects metrics.
+ *
+ * \details
+ * Each invocation of the returned task collects metrics at the given time point,
+ * writes them to the histories and evaluates the rules of the configuration.
+ *
+ * \param cfg The configuration.
+ * The configuration must outlive the task.
+ * \param histories Histories to which collected metrics are written.
+ * \param alert_fn Function receiving alert state transitions from the rules.
+ */
 auto build_task(
     const configuration& cfg,
-    const std::vector<std::shared_ptr<collect_history>>& histories)
+    const std::vector<std::shared_ptr<collect_history>>& histories,
+    std::function<void(const alert&)> alert_fn = nullptr)
 -> objpipe::interlock_writer<time_point>;
 
 
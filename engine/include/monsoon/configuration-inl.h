@@ -1,6 +1,8 @@
 #ifndef MONSOON_CONFIGURATION_INL_H
 #define MONSOON_CONFIGURATION_INL_H
 
+#include <numeric>
+#include <stdexcept>
 #include <utility>
 
 namespace monsoon {
@@ -8,13 +10,17 @@ namespace monsoon {
 
 inline configuration::configuration(configuration&& other) noexcept
 : collectors_(std::move(other.collectors_)),
-  rules_(std::move(other.rules_))
+  collectors_options_(std::move(other.collectors_options_)),
+  rules_(std::move(other.rules_)),
+  interval_(std::move(other.interval_))
 {}
 
 inline auto configuration::operator=(configuration&& other) noexcept
 -> configuration& {
   collectors_ = std::move(other.collectors_);
+  collectors_options_ = std::move(other.collectors_options_);
   rules_ = std::move(other.rules_);
+  interval_ = std::move(other.interval_);
   return *this;
 }
 
@@ -23,16 +29,53 @@ inline auto configuration::collectors() const noexcept
   return collectors_;
 }
 
+inline auto configuration::collectors_options() const noexcept
+->  const std::vector<collector_options>& {
+  return collectors_options_;
+}
+
 inline auto configuration::rules() const noexcept
 ->  const std::vector<std::unique_ptr<rule>>& {
   return rules_;
 }
 
+inline auto configuration::interval() const noexcept
+->  time_point::duration {
+  return interval_;
+}
+
+inline configuration& configuration::interval(time_point::duration d) {
+  if (d <= time_point::duration(0))
+    throw std::invalid_argument("interval must be positive");
+
+  interval_ = d;
+  return *this;
+}
+
+inline auto configuration::tick_interval() const noexcept
+->  time_point::duration {
+  std::int64_t millis = 0;
+  if (collectors_options_.empty()) millis = interval_.millis();
+  for (const collector_options& opts : collectors_options_)
+    millis = std::gcd(millis, opts.interval.value_or(interval_).millis());
+  return time_point::duration(millis);
+}
+
 inline configuration& configuration::add(std::unique_ptr<collector>&& c) {
+  return add(std::move(c), collector_options());
+}
+
+inline configuration& configuration::add(std::unique_ptr<collector>&& c, collector_options opts) {
   if (c == nullptr)
     throw std::invalid_argument("nullptr collector");
+  if (opts.interval.has_value() && *opts.interval <= time_point::duration(0))
+    throw std::invalid_argument("collector interval must be positive");
+  if (opts.jitter < time_point::duration(0))
+    throw std::invalid_argument("collector jitter may not be negative");
 
+  collectors_options_.reserve(collectors_.size() + 1u);
   collectors_.push_back(std::move(c));
+  collectors_options_.push_back(std::move(opts));
   return *this;
 }
 
@@ -3,8 +3,10 @@
 
 #include <monsoon/collector.h>
 #include <monsoon/rule.h>
+#include <monsoon/time_point.h>
 #include <monsoon/history/collect_history.h>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace monsoon {
@@ -12,6 +14,34 @@ namespace monsoon {
 
 class configuration {
  public:
+  ///\brief Options controlling how a collector is run.
+  struct collector_options {
+    /**
+     * \brief How long a collector may take, before its collection is
+     * reported as incomplete.
+     * \details
+     * If absent, the collector is waited on until it completes.
+     */
+    std::optional<time_point::duration> deadline;
+    /**
+     * \brief How often the collector runs.
+     * \details
+     * If absent, the collector runs at the configuration \ref interval().
+     */
+    std::optional<time_point::duration> interval;
+    /**
+     * \brief Maximum delay of the collector run, after the start of a tick.
+     * \details
+     * The collector is assigned a fixed, random phase up to this delay,
+     * so collectors sharing a tick don't all start at the same moment.
+     * The deadline is measured from the phase.
+     */
+    time_point::duration jitter = time_point::duration(0);
+  };
+
+  ///\brief Default interval at which collectors run.
+  static constexpr time_point::duration default_interval = time_point::duration(5000);
+
   configuration() = default;
   configuration(const configuration&) = delete;
   configuration(configuration&&) noexcept;
@@ -20,14 +50,30 @@ class configuration {
 
   bool empty() const noexcept;
   const std::vector<std::unique_ptr<collector>>& collectors() const noexcept;
+  ///\brief Options of each collector, in the same order as collectors().
+  const std::vector<collector_options>& collectors_options() const noexcept;
   const std::vector<std::unique_ptr<rule>>& rules() const noexcept;
+  ///\brief Interval of collectors that don't specify one.
+  time_point::duration interval() const noexcept;
+  ///\brief Set the interval of collectors that don't specify one.
+  configuration& interval(time_point::duration d);
+  /**
+   * \brief Interval at which the task created by build_task must be invoked.
+   * \details
+   * This is the greatest common divisor of the intervals of all collectors,
+   * so that each collector runs at a multiple of it.
+   */
+  time_point::duration tick_interval() const noexcept;
 
   configuration& add(std::unique_ptr<collector>&& c);
+  configuration& add(std::unique_ptr<collector>&& c, collector_options opts);
   configuration& add(std::unique_ptr<rule>&& r);
 
  private:
   std::vector<std::unique_ptr<collector>> collectors_;
+  std::vector<collector_options> collectors_options_;
   std::vector<std::unique_ptr<rule>> rules_;
+  time_point::duration interval_ = default_interval;
 };
 
 
@@ -1,16 +1,43 @@
 #ifndef MONSOON_RULE_H
 #define MONSOON_RULE_H
 
+#include <monsoon/alert.h>
 #include <monsoon/metric_source.h>
+#include <monsoon/time_point.h>
+#include <vector>
 
 namespace monsoon {
 
 
+/**
+ * \brief A rule is evaluated each time a scrape completes.
+ *
+ * \details
+ * Rules are evaluated by the \ref rule_engine, in order of time point.
+ * A rule may keep state between evaluations.
+ */
 class rule {
  public:
   virtual ~rule() noexcept;
 
-  virtual void operator()(const metric_source&) const = 0;
+  /**
+   * \brief Evaluate the rule.
+   * \param ms A metric source holding at least \ref window() worth of
+   * metrics before \p tp.
+   * \param tp The time point at which the rule is evaluated.
+   * \return Alerts that changed state as a result of this evaluation.
+   */
+  virtual auto operator()(const metric_source& ms, time_point tp)
+  -> std::vector<alert> = 0;
+
+  /**
+   * \brief The amount of history the rule needs to look at.
+   * \details
+   * Only this much history before the evaluation time point is
+   * guaranteed to be available in the metric source.
+   * The default implementation returns zero.
+   */
+  virtual auto window() const noexcept -> time_point::duration;
 };
 
 
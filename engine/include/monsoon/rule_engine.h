@@ -0,0 +1,125 @@
+#ifndef MONSOON_RULE_ENGINE_H
+#define MONSOON_RULE_ENGINE_H
+
+#include <monsoon/rule.h>
+#include <monsoon/alert.h>
+#include <monsoon/metric_source.h>
+#include <monsoon/time_point.h>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace monsoon {
+
+
+/**
+ * \brief Evaluates rules against the live stream of collected metrics.
+ *
+ * \details
+ * The engine receives the factual emits of each source (usually a collector)
+ * and keeps only as much history in memory as the rules need.
+ * A time point is evaluated once no source is expected to emit data for it:
+ * each source has emitted data at or after it, or its next emit is
+ * due (according to the interval of the source) after the time point.
+ * So each evaluation sees the merged data of all sources,
+ * without sources with a long interval holding back the others.
+ * Sources that close no longer hold back evaluation.
+ * Time points that are more than the maximum delay older than the most
+ * recent data are evaluated regardless, so a source that stops emitting
+ * doesn't stop evaluation, nor cause data to accumulate.
+ * Rules are evaluated in order of time point, each time point only once.
+ *
+ * Alerts that change state are passed to the alert function.
+ * The alert function is invoked with the engine lock held,
+ * so it must not call back into the engine.
+ */
+class rule_engine {
+ public:
+  ///\brief Function receiving alert state transitions.
+  using alert_fn = std::function<void(const alert&)>;
+
+  /**
+   * \brief Create a rule engine.
+   * \param rules The rules to evaluate.
+   * The rules must outlive the engine.
+   * \param intervals The interval at which each source supplies metrics.
+   * \param max_delay How long evaluation of a time point waits for
+   * sources that are late.
+   * \param fn Function receiving alert state transitions.
+   */
+  rule_engine(const std::vector<std::unique_ptr<rule>>& rules,
+      std::vector<time_point::duration> intervals,
+      time_point::duration max_delay,
+      alert_fn fn);
+  rule_engine(const rule_engine&) = delete;
+  rule_engine& operator=(const rule_engine&) = delete;
+  ~rule_engine() noexcept;
+
+  /**
+   * \brief Accept metrics from a source.
+   * \details
+   * Evaluates any time points that have become complete.
+   * \param source The index of the source.
+   * \param emit The metrics emitted by the source.
+   */
+  void push_back(std::size_t source, const metric_source::metric_emit& emit);
+  /**
+   * \brief Indicate a source will supply no more metrics.
+   * \details
+   * Evaluates any time points that have become complete.
+   * \param source The index of the source.
+   */
+  void close(std::size_t source);
+
+  ///\brief The amount of history kept in memory.
+  auto window() const noexcept -> time_point::duration;
+
+ private:
+  class window_source;
+
+  struct source_state {
+    explicit source_state(time_point::duration interval) noexcept
+    : interval(interval)
+    {}
+
+    time_point::duration interval;
+    ///\brief Most recent time point emitted by the source.
+    std::optional<time_point> watermark;
+    bool closed = false;
+  };
+
+  ///\brief Merge emitted metrics into the window.
+  void merge_(const metric_source::metric_emit& emit);
+  ///\brief Test if no source is expected to emit data at the time point.
+  auto complete_(time_point tp) const noexcept -> bool;
+  ///\brief Evaluate all time points that have become complete.
+  void evaluate_complete_();
+  ///\brief Evaluate all rules at the given time point.
+  void evaluate_(time_point tp);
+  ///\brief Discard data that is no longer needed by any rule.
+  void expire_();
+
+  mutable std::mutex mtx_;
+  std::vector<rule*> rules_;
+  alert_fn alert_fn_;
+  time_point::duration window_;
+  const time_point::duration max_delay_;
+  std::vector<source_state> sources_;
+  ///\brief Merged metrics, ordered by time point.
+  std::deque<metric_source::metric_emit> data_;
+  ///\brief Most recent time point emitted by any source.
+  std::optional<time_point> newest_;
+  ///\brief Most recently evaluated time point.
+  std::optional<time_point> evaluated_;
+  ///\brief Data before this time point has been discarded.
+  std::optional<time_point> expired_;
+};
+
+
+} /* namespace monsoon */
+
+#endif /* MONSOON_RULE_ENGINE_H */
@@ -0,0 +1,78 @@
+#ifndef MONSOON_SCHEDULER_H
+#define MONSOON_SCHEDULER_H
+
+#include <monsoon/time_point.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace monsoon {
+
+
+/**
+ * \brief Invokes a task at a fixed interval.
+ *
+ * \details
+ * Ticks are scheduled on absolute deadlines, at multiples of the interval
+ * since the epoch, so the schedule does not drift by however long the
+ * task takes.
+ * The task is passed the scheduled time point, rather than the moment it
+ * started running, so that time points of separate runs line up exactly.
+ *
+ * If the task takes so long that ticks are missed, the missed ticks are
+ * coalesced into the next tick.
+ *
+ * The lateness of each tick (time between the scheduled time point and
+ * the moment the task started) is reported through instrumentation,
+ * as are the missed ticks.
+ */
+class scheduler {
+ public:
+  using task_type = std::function<void(time_point)>;
+
+  /**
+   * \brief Create a scheduler.
+   * \param interval The interval between ticks.
+   * \throw std::invalid_argument if the interval is not positive.
+   */
+  explicit scheduler(time_point::duration interval);
+  scheduler(const scheduler&) = delete;
+  scheduler& operator=(const scheduler&) = delete;
+  ~scheduler() noexcept;
+
+  /**
+   * \brief Invoke the task at each tick, until stop() is called.
+   * \details The task is invoked on the calling thread.
+   */
+  void run(const task_type& task);
+  /**
+   * \brief Make run() return.
+   * \details May be called from any thread, including from the task.
+   * A running task is not interrupted.
+   */
+  void stop() noexcept;
+
+  ///\brief The interval between ticks.
+  auto interval() const noexcept -> time_point::duration;
+  ///\brief The first tick at or after the given time point.
+  auto next_tick(time_point tp) const noexcept -> time_point;
+
+ private:
+  const time_point::duration interval_;
+
+  std::mutex mtx_; // Protects stop_.
+  std::condition_variable cnd_;
+  bool stop_ = false;
+
+  ///\brief Lateness of the most recent tick, in milliseconds.
+  const std::shared_ptr<std::atomic<std::int64_t>> lateness_;
+  std::shared_ptr<void> lateness_gauge_;
+};
+
+
+} /* namespace monsoon */
+
+#endif /* MONSOON_SCHEDULER_H */
@@ -0,0 +1,113 @@
+#include <monsoon/alert_rule.h>
+#include <monsoon/overload.h>
+#include <monsoon/time_range.h>
+#include <stdexcept>
+#include <utility>
+
+namespace monsoon {
+
+
+alert_rule::alert_rule(simple_group name, expression_ptr trigger,
+    time_point::duration trigger_duration, std::string message,
+    time_point::duration window)
+: name_(std::move(name)),
+  trigger_(std::move(trigger)),
+  trigger_duration_(std::move(trigger_duration)),
+  message_(std::move(message)),
+  window_(std::move(window))
+{
+  if (trigger_ == nullptr)
+    throw std::invalid_argument("nullptr trigger expression");
+}
+
+alert_rule::~alert_rule() noexcept {}
+
+auto alert_rule::operator()(const metric_source& ms, time_point tp)
+-> std::vector<alert> {
+  const time_point::duration since_last_eval = (last_tp_.has_value()
+      ? tp - *last_tp_
+      : time_point::duration(0));
+  last_tp_ = tp;
+
+  auto values = evaluate_(ms, tp);
+  // Alerts that were not reported by the trigger become unknown.
+  for (const auto& a : alerts_)
+    values.emplace(a.first, std::nullopt);
+
+  std::vector<alert> transitions;
+  for (auto& v : values) {
+    const group_name& name = v.first;
+    const std::optional<bool>& value = v.second;
+    state_& s = alerts_[name];
+
+    alert_state new_state;
+    if (!value.has_value()) {
+      new_state = alert_state::UNKNOWN;
+      s.triggered_since.reset();
+    } else if (!*value) {
+      new_state = alert_state::OK;
+      s.triggered_since.reset();
+    } else {
+      if (!s.triggered_since.has_value()) s.triggered_since = tp;
+      new_state = (tp - *s.triggered_since >= trigger_duration_
+          ? alert_state::FIRING
+          : alert_state::TRIGGERING);
+    }
+
+    const alert_state old_state = s.current.get_state();
+    s.current.extend_with(alert(name, value, message_, new_state, tp, since_last_eval));
+    if (old_state != new_state) transitions.push_back(s.current);
+
+    // Don't keep unknown alerts around, so tag sets that disappear
+    // don't accumulate.
+    if (new_state == alert_state::UNKNOWN) alerts_.erase(name);
+  }
+
+  return transitions;
+}
+
+auto alert_rule::window() const noexcept -> time_point::duration {
+  return window_;
+}
+
+auto alert_rule::evaluate_(const metric_source& ms, time_point tp) const
+-> std::unordered_map<group_name, std::optional<bool>> {
+  // Without slack, the value of the trigger at tp only depends on data at tp.
+  // So the trigger is evaluated at tp only, instead of over the entire window,
+  // keeping the cost of an evaluation independent of the window.
+  time_range tr;
+  tr.begin(tp);
+  tr.end(tp);
+
+  std::unordered_map<group_name, std::optional<bool>> result;
+  std::visit(
+      overload(
+          [this, tp, &result](expression::scalar_objpipe&& pipe) {
+            std::move(pipe)
+                .filter(
+                    [tp](const expression::scalar_emit_type& e) {
+                      return e.tp == tp && e.data.index() == 1u;
+                    })
+                .for_each(
+                    [this, &result](const expression::scalar_emit_type& e) {
+                      result[group_name(name_)] = std::get<1>(e.data).as_bool();
+                    });
+          },
+          [this, tp, &result](expression::vector_objpipe&& pipe) {
+            std::move(pipe)
+                .filter(
+                    [tp](const expression::vector_emit_type& e) {
+                      return e.tp == tp && e.data.index() == 1u;
+                    })
+                .for_each(
+                    [this, &result](const expression::vector_emit_type& e) {
+                      for (const auto& elem : std::get<1>(e.data))
+                        result[group_name(name_, elem.first)] = elem.second.as_bool();
+                    });
+          }),
+      (*trigger_)(ms, tr, time_point::duration(0)));
+  return result;
+}
+
+
+} /* namespace monsoon */
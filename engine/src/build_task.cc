@@ -1,9 +1,22 @@
 #include <monsoon/build_task.h>
+#include <monsoon/rule_engine.h>
 #include <monsoon/time_series_value.h>
 #include <monsoon/time_series.h>
 #include <objpipe/interlock.h>
 #include <objpipe/push_policies.h>
+#include <instrumentation/counter.h>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -85,43 +98,282 @@ class history_multiplexer {
 };
 
 
+///\brief Bounded set of worker threads, on which collectors run.
+class collector_pool {
+ public:
+  explicit collector_pool(unsigned int threads) {
+    workers_.reserve(threads);
+    try {
+      while (threads-- > 0u)
+        workers_.emplace_back(&collector_pool::worker_, this);
+    } catch (...) {
+      if (workers_.empty()) throw;
+      // Run with the threads that could be started.
+    }
+  }
+
+  collector_pool(const collector_pool&) = delete;
+  collector_pool& operator=(const collector_pool&) = delete;
+
+  ~collector_pool() noexcept {
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      stop_ = true;
+    }
+    cnd_.notify_all();
+    for (std::thread& t : workers_) t.join();
+  }
+
+  ///\brief Run \p fn on a worker thread.
+  auto submit(std::function<void()> fn)
+  -> void {
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      queue_.push_back(std::move(fn));
+    }
+    cnd_.notify_one();
+  }
+
+ private:
+  void worker_() noexcept {
+    std::unique_lock<std::mutex> lck{ mtx_ };
+    for (;;) {
+      cnd_.wait(lck, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return; // Stopped and drained.
+
+      std::function<void()> fn = std::move(queue_.front());
+      queue_.pop_front();
+      lck.unlock();
+      fn();
+      fn = nullptr; // Release captured state before reacquiring the lock.
+      lck.lock();
+    }
+  }
+
+  std::mutex mtx_; // Protects everything below.
+  std::condition_variable cnd_;
+  std::deque<std::function<void()>> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+
 class time_multiplexer {
+ public:
+  ///\brief Invoked with the time point a collector failed to complete in time.
+  ///\details Invoked on the tick thread, so it must not block.
+  using late_fn = std::function<void(time_point)>;
+
  private:
+  ///\brief Feeds time points to a single collector, one at a time.
+  class lane
+  : public std::enable_shared_from_this<lane>
+  {
+   public:
+    lane(objpipe::interlock_writer<time_point>&& w,
+        std::optional<time_point::duration> deadline,
+        time_point::duration interval,
+        std::chrono::milliseconds phase,
+        late_fn&& on_late)
+    : w_(std::move(w)),
+      deadline_(std::move(deadline)),
+      interval_(std::move(interval)),
+      phase_(std::move(phase)),
+      on_late_(std::move(on_late))
+    {}
+
+    /**
+     * \brief Start running the collector for the given time point, if it is due.
+     * \details
+     * The collector is due at the first tick at/after each multiple of its interval.
+     * It starts running at its phase after \p start.
+     *
+     * If the collector is still busy with an earlier time point,
+     * \p tp replaces any time point that is waiting to run,
+     * so a slow collector skips the ticks it can't keep up with.
+     * \return True if the collector was due.
+     */
+    auto schedule(time_point tp, std::chrono::steady_clock::time_point start, collector_pool& pool)
+    -> bool {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      if (errc_ != objpipe::objpipe_errc::success) return false;
+      if (next_due_.has_value() && tp < *next_due_) return false;
+
+      // First multiple of the interval after tp.
+      const std::int64_t interval = interval_.millis();
+      std::int64_t rem = tp.millis_since_posix_epoch() % interval;
+      if (rem < 0) rem += interval;
+      next_due_ = tp + time_point::duration(interval - rem);
+
+      pending_ = tp;
+      pending_start_ = start + phase_;
+      if (!running_) {
+        pool.submit([self = shared_from_this()]() { self->run_(); });
+        running_ = true;
+      }
+      return true;
+    }
+
+    /**
+     * \brief Wait until the collector completed \p tp, or its deadline passed.
+     * \details
+     * If the deadline passes, the late function is invoked
+     * and the collector is left running in the background.
+     * \param tp The time point to wait for.
+     * \param start The moment the time point was scheduled.
+     * The deadline is measured from the collector's phase after this moment.
+     */
+    auto wait(time_point tp, std::chrono::steady_clock::time_point start)
+    -> objpipe::objpipe_errc {
+      static instrumentation::counter deadline_misses("monsoon.collector.deadline_misses", {});
+
+      std::unique_lock<std::mutex> lck{ mtx_ };
+      const auto pred =
+          [this, tp]() {
+            return errc_ != objpipe::objpipe_errc::success
+                || (done_.has_value() && *done_ >= tp);
+          };
+
+      if (!deadline_.has_value()) {
+        cnd_.wait(lck, pred);
+      } else if (!cnd_.wait_until(lck, start + phase_ + std::chrono::milliseconds(deadline_->millis()), pred)) {
+        lck.unlock();
+        ++deadline_misses;
+        on_late_(tp);
+        return objpipe::objpipe_errc::success;
+      }
+      return errc_;
+    }
+
+    auto push_exception(const std::exception_ptr& exptr)
+    noexcept
+    -> void {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      if (running_) {
+        // Deliver it once the current run completes.
+        exptr_ = exptr;
+        pending_.reset();
+      } else if (errc_ == objpipe::objpipe_errc::success) {
+        w_.push_exception(exptr);
+        errc_ = objpipe::objpipe_errc::closed;
+      }
+    }
+
+   private:
+    void run_() noexcept {
+      std::unique_lock<std::mutex> lck{ mtx_ };
+      while (pending_.has_value()) {
+        const time_point tp = *std::exchange(pending_, std::nullopt);
+        const auto run_at = pending_start_;
+        lck.unlock();
+
+        std::this_thread::sleep_until(run_at);
+        objpipe::objpipe_errc e;
+        try {
+          e = w_(tp);
+        } catch (...) {
+          w_.push_exception(std::current_exception());
+          e = objpipe::objpipe_errc::closed;
+        }
+
+        lck.lock();
+        done_ = tp;
+        errc_ = e;
+        cnd_.notify_all();
+        if (errc_ != objpipe::objpipe_errc::success) pending_.reset();
+      }
+
+      if (exptr_ && errc_ == objpipe::objpipe_errc::success) {
+        w_.push_exception(std::exchange(exptr_, nullptr));
+        errc_ = objpipe::objpipe_errc::closed;
+        cnd_.notify_all();
+      }
+      running_ = false;
+    }
+
+    objpipe::interlock_writer<time_point> w_;
+    const std::optional<time_point::duration> deadline_;
+    const time_point::duration interval_;
+    const std::chrono::milliseconds phase_;
+    const late_fn on_late_;
+
+    std::mutex mtx_; // Protects everything below.
+    std::condition_variable cnd_;
+    std::optional<time_point> next_due_;
+    std::optional<time_point> pending_;
+    std::chrono::steady_clock::time_point pending_start_;
+    std::optional<time_point> done_;
+    bool running_ = false;
+    objpipe::objpipe_errc errc_ = objpipe::objpipe_errc::success;
+    std::exception_ptr exptr_;
+  };
+
+  /**
+   * \brief Distributes each time point over the collectors that are due.
+   * \details
+   * Collectors run concurrently on the worker pool.
+   * A time point is done once each due collector completed it or missed its deadline,
+   * so a tick takes as long as the slowest collector.
+   * All collectors that are due on the same tick share its time point.
+   */
   class sink {
    public:
     sink() = default;
 
-    auto new_pipe()
+    auto new_pipe(const configuration::collector_options& opts, time_point::duration interval, late_fn on_late)
     -> objpipe::interlock_reader<time_point> {
       objpipe::interlock_reader<time_point> r;
       objpipe::interlock_writer<time_point> w;
       std::tie(r, w) = objpipe::new_interlock<time_point>();
 
-      sinks_.push_back(std::move(w));
+      interval = opts.interval.value_or(interval);
+      // The phase is less than the interval, so runs don't overlap the next tick.
+      const std::int64_t max_phase = std::min(opts.jitter, interval).millis();
+      const std::chrono::milliseconds phase(max_phase > 0
+          ? std::uniform_int_distribution<std::int64_t>(0, max_phase - 1)(rng_)
+          : 0);
+
+      lanes_.push_back(std::make_shared<lane>(std::move(w), opts.deadline, interval, phase, std::move(on_late)));
       return r;
     }
 
+    ///\brief Start the worker pool.
+    ///\details Each collector runs on at most one thread at a time.
+    ///The pool has a thread per collector, rather than per CPU:
+    ///collectors mostly wait on I/O, and a collector that is stuck past
+    ///its deadline must not keep the others from running.
+    auto start()
+    -> void {
+      pool_ = std::make_shared<collector_pool>(
+          static_cast<unsigned int>(std::max<std::size_t>(lanes_.size(), 1u)));
+    }
+
     auto operator()(time_point tp)
     -> objpipe::objpipe_errc {
       using objpipe::objpipe_errc;
 
-      objpipe_errc rv = objpipe_errc::success;
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<bool> due;
+      due.reserve(lanes_.size());
+      for (const auto& l : lanes_) due.push_back(l->schedule(tp, start, *pool_));
 
-      auto sink_iter = sinks_.begin();
-      while (sink_iter != sinks_.end()) {
-        objpipe_errc e = (*sink_iter)(tp);
+      objpipe_errc rv = objpipe_errc::success;
+      auto lane_iter = lanes_.begin();
+      auto due_iter = due.begin();
+      while (lane_iter != lanes_.end()) {
+        objpipe_errc e = (*due_iter++ ? (*lane_iter)->wait(tp, start) : objpipe_errc::success);
 
         if (e != objpipe_errc::success) {
-          sink_iter = sinks_.erase(sink_iter);
+          lane_iter = lanes_.erase(lane_iter);
           if (e != objpipe_errc::closed)
             rv = e;
         } else {
-          ++sink_iter;
+          ++lane_iter;
         }
       }
 
       if (rv == objpipe_errc::success)
-        return (sinks_.empty() ? objpipe_errc::closed : objpipe_errc::success);
+        return (lanes_.empty() ? objpipe_errc::closed : objpipe_errc::success);
       return rv;
     }
 
@@ -129,18 +381,21 @@ class time_multiplexer {
     noexcept
     -> void {
       std::for_each(
-          sinks_.begin(), sinks_.end(),
-          [exptr](auto& sink) { sink.push_exception(exptr); });
+          lanes_.begin(), lanes_.end(),
+          [exptr](auto& l) { l->push_exception(exptr); });
     }
 
    private:
-    std::vector<objpipe::interlock_writer<time_point>> sinks_;
+    std::mt19937_64 rng_{ std::random_device()() };
+    std::vector<std::shared_ptr<lane>> lanes_;
+    // Destroyed first, so running collectors complete before the lanes are released.
+    std::shared_ptr<collector_pool> pool_;
   };
 
  public:
-  auto new_pipe()
+  auto new_pipe(const configuration::collector_options& opts, time_point::duration interval, late_fn on_late)
   -> objpipe::interlock_reader<time_point> {
-    return sink_.new_pipe();
+    return sink_.new_pipe(opts, interval, std::move(on_late));
   }
 
   auto commit() &&
@@ -149,6 +404,7 @@ class time_multiplexer {
     objpipe::interlock_writer<time_point> w;
     std::tie(r, w) = objpipe::new_interlock<time_point>();
 
+    sink_.start();
     std::move(r)
         .async(objpipe::existingthread_push())
         .push(std::move(sink_));
@@ -160,6 +416,32 @@ class time_multiplexer {
 };
 
 
+///\brief Selects the elements of a collection that a subscriber is interested in.
+///\details A default constructed filter selects all elements.
+class collection_filter_ {
+ public:
+  collection_filter_() = default;
+
+  collection_filter_(
+      path_matcher group_filter,
+      tag_matcher tag_filter,
+      path_matcher metric_filter)
+  : filter_(std::in_place, std::move(group_filter), std::move(tag_filter), std::move(metric_filter))
+  {}
+
+  auto operator()(const collector::collection_element& e) const
+  -> bool {
+    return !filter_.has_value()
+        || (std::get<0>(*filter_)(e.group.get_path())
+            && std::get<1>(*filter_)(e.group.get_tags())
+            && std::get<2>(*filter_)(e.metric));
+  }
+
+ private:
+  std::optional<std::tuple<path_matcher, tag_matcher, path_matcher>> filter_;
+};
+
+
 class collector_metricsource_converter_ {
  private:
   using map_type = std::tuple_element_t<1, metric_source::metric_emit>;
@@ -167,17 +449,18 @@ class collector_metricsource_converter_ {
   struct record {
     record() = default;
 
-    record(const collector::collection& c)
+    record(const collector::collection& c, const collection_filter_& filter)
     : tp(c.tp)
     {
-      this->merge(c);
+      this->merge(c, filter);
     }
 
-    auto merge(const collector::collection& c)
+    auto merge(const collector::collection& c, const collection_filter_& filter)
     -> void {
       assert(tp == c.tp);
 
       for (const auto& elem : c.elements) {
+        if (!filter(elem)) continue;
 #if __cplusplus >= 201703
         data.insert_or_assign(std::make_tuple(elem.group, elem.metric), elem.value);
 #else
@@ -190,20 +473,34 @@ class collector_metricsource_converter_ {
 
     time_point tp;
     map_type data;
-    bool complete;
+    bool complete = false;
   };
 
  public:
+  /**
+   * \brief Create a converter.
+   * \param filter Selects the elements to emit.
+   * \param speculative If set, speculative emits are produced.
+   * Consumers that only handle factual emits should clear this,
+   * to skip creating speculative emits.
+   */
+  explicit collector_metricsource_converter_(
+      collection_filter_ filter = collection_filter_(),
+      bool speculative = true)
+  : filter_(std::move(filter)),
+    speculative_(speculative)
+  {}
+
   auto accept(const collector::collection& c)
   -> void {
     assert(invariant());
 
     if (queue_.empty() || queue_.back().tp < c.tp) {
-      queue_.emplace_back(c);
+      queue_.emplace_back(c, filter_);
     } else if (queue_.back().tp == c.tp) {
-      queue_.back().merge(c);
+      queue_.back().merge(c, filter_);
     } else if (queue_.front().tp == c.tp) {
-      queue_.front().merge(c);
+      queue_.front().merge(c, filter_);
     } else {
       auto pos = std::lower_bound(
           queue_.begin(), queue_.end(),
@@ -211,9 +508,9 @@ class collector_metricsource_converter_ {
           [](const auto& x, const auto& y) { return x.tp < y.tp; });
       assert(pos == queue_.end() || pos->tp >= c.tp);
       if (pos != queue_.end() && pos->tp == c.tp)
-        pos->merge(c);
+        pos->merge(c, filter_);
       else
-        queue_.emplace(pos, c);
+        queue_.emplace(pos, c, filter_);
     }
 
     assert(invariant());
@@ -223,6 +520,14 @@ class collector_metricsource_converter_ {
   -> std::optional<metric_source::emit_type> {
     assert(invariant());
 
+    // Collectors complete time points in order, so an incomplete record
+    // won't be completed once a later record is.
+    // This happens when a collector misses its deadline.
+    while (!queue_.empty() && !queue_.front().complete
+        && std::any_of(std::next(queue_.begin()), queue_.end(),
+            [](const record& r) { return r.complete; }))
+      queue_.pop_front();
+
     std::optional<metric_source::emit_type> result;
     if (!queue_.empty() && queue_.front().complete) {
       result.emplace(
@@ -237,18 +542,21 @@ class collector_metricsource_converter_ {
     return result;
   }
 
-  static auto speculative_entries(const collector::collection& c)
+  auto speculative_entries(const collector::collection& c) const
   -> std::vector<metric_source::emit_type> {
     std::vector<metric_source::emit_type> result;
+    if (!speculative_) return result;
+
     result.reserve(c.elements.size());
     const time_point tp = c.tp;
 
-    std::transform(
-        c.elements.begin(), c.elements.end(),
-        std::back_inserter(result),
-        [tp](const auto& element) -> metric_source::speculative_metric_emit {
-          return { tp, element.group, element.metric, element.value };
-        });
+    for (const auto& element : c.elements) {
+      if (filter_(element)) {
+        result.emplace_back(
+            std::in_place_type<metric_source::speculative_metric_emit>,
+            tp, element.group, element.metric, element.value);
+      }
+    }
     return result;
   }
 
@@ -268,23 +576,26 @@ class collector_metricsource_converter_ {
     return true;
   }
 
+  collection_filter_ filter_;
+  bool speculative_;
   std::deque<record> queue_;
 };
 
 template<typename Acceptor>
 class collector_metricsource_push_ {
  public:
-  collector_metricsource_push_(Acceptor&& dst)
-  : dst_(std::move(dst))
+  collector_metricsource_push_(Acceptor&& dst, collector_metricsource_converter_&& state)
+  : state_(std::move(state)),
+    dst_(std::move(dst))
   {}
 
-  auto operator()(const collector::collection& c)
+  auto operator()(const std::shared_ptr<const collector::collection>& c)
   -> objpipe::objpipe_errc {
-    state_.accept(c);
+    state_.accept(*c);
 
     auto emit = state_.maybe_emit();
     if (!emit.has_value()) {
-      auto se = collector_metricsource_converter_::speculative_entries(c);
+      auto se = state_.speculative_entries(*c);
       for (auto& x : se) {
         const objpipe::objpipe_errc e = dst_(std::move(x));
         if (e != objpipe::objpipe_errc::success)
@@ -319,8 +630,9 @@ class collector_metricsource_pipe_ {
   using objpipe_errc = objpipe::objpipe_errc;
 
  public:
-  collector_metricsource_pipe_(Source&& src)
-  : src_(std::move(src))
+  collector_metricsource_pipe_(Source&& src, collection_filter_ filter, bool speculative)
+  : state_(std::move(filter), speculative),
+    src_(std::move(src))
   {}
 
   collector_metricsource_pipe_(const collector_metricsource_pipe_&) = delete;
@@ -348,13 +660,13 @@ class collector_metricsource_pipe_ {
       auto src_val = objpipe::detail::adapt::raw_pull(src_);
       if (src_val.errc() != objpipe_errc::success)
         return transport_type(std::in_place_index<1>, src_val.errc());
-      state_.accept(src_val.ref());
+      state_.accept(*src_val.ref());
 
       auto emit = state_.maybe_emit();
       if (emit.has_value()) {
         pending_.push_back(*std::move(emit));
       } else {
-        auto se = collector_metricsource_converter_::speculative_entries(src_val.ref());
+        auto se = state_.speculative_entries(*src_val.ref());
         pending_.insert(
             pending_.end(),
             std::make_move_iterator(se.begin()),
@@ -394,7 +706,7 @@ class collector_metricsource_pipe_ {
   -> std::enable_if_t<Enable> {
     using impl = collector_metricsource_push_<std::decay_t<Acceptor>>;
 
-    std::move(src_).ioc_push(tag, impl(std::forward<Acceptor>(acceptor)));
+    std::move(src_).ioc_push(tag, impl(std::forward<Acceptor>(acceptor), std::move(state_)));
   }
 
   template<typename Acceptor, bool Enable = objpipe::detail::adapt::has_ioc_push<Source, objpipe::singlethread_push>>
@@ -403,7 +715,7 @@ class collector_metricsource_pipe_ {
   -> std::enable_if_t<Enable> {
     using impl = collector_metricsource_push_<std::decay_t<Acceptor>>;
 
-    std::move(src_).ioc_push(tag, impl(std::forward<Acceptor>(acceptor)));
+    std::move(src_).ioc_push(tag, impl(std::forward<Acceptor>(acceptor), std::move(state_)));
   }
 
  private:
@@ -415,58 +727,179 @@ class collector_metricsource_pipe_ {
 
 class collector_metric_source {
  private:
+  ///\brief Immutable collection, shared between the subscribers.
+  using collection_ptr = std::shared_ptr<const collector::collection>;
+
+  ///\brief Distributes collections over the subscribers.
+  ///\details The sink is shared between the collector and its deadline handling,
+  ///so it is synchronized.
+  ///
+  ///Each collection is published once, as a shared snapshot,
+  ///so subscribers don't each copy the collection.
   class sink {
    public:
     sink() = default;
 
-    auto operator()(const collector::collection& c) -> objpipe::objpipe_errc {
+    auto operator()(collector::collection c) -> objpipe::objpipe_errc {
+      using objpipe::objpipe_errc;
+      const collection_ptr cptr = std::make_shared<const collector::collection>(std::move(c));
+
+      std::vector<time_point> late;
+      {
+        std::lock_guard<std::mutex> late_lck{ late_mtx_ };
+        late.swap(late_);
+      }
+
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      objpipe_errc rv = objpipe_errc::success;
+      for (time_point tp : late) {
+        objpipe_errc e = publish_(std::make_shared<const collector::collection>(collector::collection(tp, {}, false)));
+        if (e != objpipe_errc::success) rv = e;
+      }
+      objpipe_errc e = publish_(cptr);
+      if (e != objpipe_errc::success) rv = e;
+
+      if (rv == objpipe_errc::success)
+        return (sinks_.empty() ? objpipe_errc::closed : objpipe_errc::success);
+      return rv;
+    }
+
+    /**
+     * \brief Report that the collector missed its deadline for \p tp.
+     * \details
+     * Called from the tick thread, so this doesn't block:
+     * the collector may hold the sink while a subscriber applies back pressure.
+     * The incomplete collection is published by the collector's thread,
+     * ahead of the next collection it publishes.
+     */
+    auto late(time_point tp) -> void {
+      std::lock_guard<std::mutex> lck{ late_mtx_ };
+      late_.push_back(tp);
+    }
+
+    auto push_exception(std::exception_ptr ex) noexcept -> void {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      for (objpipe::interlock_writer<collection_ptr>& sink : sinks_)
+        sink.push_exception(ex);
+      sinks_.clear();
+    }
+
+    auto new_pipe() -> objpipe::interlock_reader<collection_ptr> {
+      objpipe::interlock_reader<collection_ptr> r;
+      objpipe::interlock_writer<collection_ptr> w;
+      std::tie(r, w) = objpipe::new_interlock<collection_ptr>();
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      sinks_.emplace_back(std::move(w));
+      return r;
+    }
+
+   private:
+    ///\brief Publish \p cptr to all subscribers.
+    ///\details Must be called with mtx_ held.
+    ///\return The error of a failing subscriber, if any failed for a reason other than being closed.
+    auto publish_(const collection_ptr& cptr) -> objpipe::objpipe_errc {
       using objpipe::objpipe_errc;
       objpipe_errc rv = objpipe_errc::success;
 
       auto sink_iter = sinks_.begin();
       while (sink_iter != sinks_.end()) {
-        objpipe::interlock_writer<collector::collection>& sink = *sink_iter;
-        objpipe_errc e = sink(c);
+        objpipe::interlock_writer<collection_ptr>& sink = *sink_iter;
+        objpipe_errc e = sink(cptr);
 
         // Erase sinks that are closed/bad.
         if (e != objpipe_errc::success) {
           sink_iter = sinks_.erase(sink_iter);
-          if (rv != objpipe_errc::success && e != objpipe_errc::closed)
+          if (e != objpipe_errc::closed)
             rv = e;
         } else {
           ++sink_iter;
         }
       }
-
-      if (rv == objpipe_errc::success)
-        return (sinks_.empty() ? objpipe_errc::closed : objpipe_errc::success);
       return rv;
     }
 
+    std::mutex mtx_;
+    std::vector<objpipe::interlock_writer<collection_ptr>> sinks_;
+    std::mutex late_mtx_; // Protects late_, never held while blocking.
+    std::vector<time_point> late_;
+  };
+
+  ///\brief Acceptor that forwards to a shared sink.
+  class sink_ref {
+   public:
+    explicit sink_ref(std::shared_ptr<sink> s)
+    : s_(std::move(s))
+    {}
+
+    auto operator()(collector::collection c) -> objpipe::objpipe_errc {
+      return (*s_)(std::move(c));
+    }
+
     auto push_exception(std::exception_ptr ex) noexcept -> void {
-      for (objpipe::interlock_writer<collector::collection>& sink : sinks_)
-        sink.push_exception(ex);
-      sinks_.clear();
+      s_->push_exception(std::move(ex));
     }
 
-    auto new_pipe() -> objpipe::interlock_reader<collector::collection> {
-      objpipe::interlock_reader<collector::collection> r;
-      objpipe::interlock_writer<collector::collection> w;
-      std::tie(r, w) = objpipe::new_interlock<collector::collection>();
-      sinks_.emplace_back(std::move(w));
-      return r;
+   private:
+    std::shared_ptr<sink> s_;
+  };
+
+  ///\brief Receiver of the factual emits of a collector.
+  class factual_subscriber {
+   public:
+    virtual ~factual_subscriber() noexcept {}
+
+    ///\brief Accept a factual emit.
+    ///\details \p c always holds a metric_source::metric_emit.
+    virtual auto push_back(const metric_source::emit_type& c) -> void = 0;
+    virtual auto push_exception(const std::exception_ptr& ex) noexcept -> void = 0;
+  };
+
+  ///\brief Acceptor handing each factual emit to all factual subscribers.
+  ///\details The emit is built once and shared by reference,
+  ///so subscribers don't each build their own copy.
+  ///A subscriber that throws is handed the exception and dropped,
+  ///so it doesn't stop the others.
+  class factual_fanout {
+   public:
+    explicit factual_fanout(std::vector<std::shared_ptr<factual_subscriber>> subscribers)
+    : subscribers_(std::move(subscribers))
+    {}
+
+    auto operator()(const metric_source::emit_type& c) -> objpipe::objpipe_errc {
+      if (!std::holds_alternative<metric_source::metric_emit>(c))
+        return objpipe::objpipe_errc::success;
+
+      auto iter = subscribers_.begin();
+      while (iter != subscribers_.end()) {
+        try {
+          (*iter)->push_back(c);
+          ++iter;
+        } catch (...) {
+          (*iter)->push_exception(std::current_exception());
+          iter = subscribers_.erase(iter);
+        }
+      }
+
+      return (subscribers_.empty() ? objpipe::objpipe_errc::closed : objpipe::objpipe_errc::success);
+    }
+
+    auto push_exception(const std::exception_ptr& ex) noexcept -> void {
+      for (const auto& s : subscribers_) s->push_exception(ex);
+      subscribers_.clear();
     }
 
    private:
-    std::vector<objpipe::interlock_writer<collector::collection>> sinks_;
+    std::vector<std::shared_ptr<factual_subscriber>> subscribers_;
   };
 
   ///\brief Convert collection to metric_source::emit_type.
+  ///\details Only elements selected by \p filter are emitted.
+  ///Speculative emits are only produced if \p speculative is set.
   template<typename CollectionPipe>
-  static auto collection_to_msemit_(CollectionPipe&& pipe) {
+  static auto collection_to_msemit_(CollectionPipe&& pipe, collection_filter_ filter, bool speculative) {
     using raw_pipe_t = objpipe::detail::adapter_underlying_type_t<std::decay_t<CollectionPipe>>;
     using result_t = collector_metricsource_pipe_<raw_pipe_t>;
-    return objpipe::detail::adapter(result_t(std::forward<CollectionPipe>(pipe).underlying()));
+    return objpipe::detail::adapter(result_t(std::forward<CollectionPipe>(pipe).underlying(), std::move(filter), speculative));
   }
 
  public:
@@ -475,6 +908,14 @@ class collector_metric_source {
   {}
 
   void commit(objpipe::reader<time_point>&& ts_pipe) && {
+    // History and rules only handle factual emits,
+    // so they share a single conversion of the collections.
+    if (!factual_.empty()) {
+      collection_to_msemit_(sink_->new_pipe(), collection_filter_(), false)
+          .async(objpipe::existingthread_push())
+          .push(factual_fanout(std::move(factual_)));
+    }
+
     std::move(ts_pipe)
         .perform(
             [this](auto&& pipe) {
@@ -485,7 +926,20 @@ class collector_metric_source {
               return maybe_perform_validation_(c_->provides(), std::forward<decltype(pipe)>(pipe));
             })
         .async(objpipe::existingthread_push())
-        .push(std::move(sink_));
+        .push(sink_ref(sink_));
+  }
+
+  ///\brief Function reporting a missed deadline as an incomplete collection.
+  ///\details The function only queues the collection, so it won't block the tick thread.
+  auto late_fn() const -> time_multiplexer::late_fn {
+    return
+        [s = sink_](time_point tp) {
+          try {
+            s->late(tp);
+          } catch (...) {
+            // SKIP: subscribers will see the collection once the collector completes.
+          }
+        };
   }
 
   auto emit(
@@ -494,32 +948,28 @@ class collector_metric_source {
       path_matcher metric_filter)
   -> std::optional<objpipe::reader<metric_source::emit_type>> {
     if (intersects_(group_filter, tag_filter, metric_filter)) {
-      return sink_.new_pipe()
-          .peek(
-              [group_filter, tag_filter, metric_filter](collector::collection& c) -> void {
-                filter_collection_elements_(group_filter, tag_filter, metric_filter, c);
-              })
-          .perform(
-              [](auto&& x) {
-                return collector_metric_source::collection_to_msemit_(std::forward<decltype(x)>(x));
-              });
+      return collection_to_msemit_(
+          sink_->new_pipe(),
+          collection_filter_(group_filter, tag_filter, metric_filter),
+          true);
     }
     return {};
   }
 
   auto attach_history(const history_multiplexer& h) -> void {
-    class wrapper {
+    class history_subscriber
+    : public factual_subscriber
+    {
      public:
-      wrapper(history_multiplexer hm)
+      history_subscriber(history_multiplexer hm)
       : hm_(std::move(hm))
       {}
 
-      auto operator()(const metric_source::emit_type& c) {
+      auto push_back(const metric_source::emit_type& c) -> void override {
         hm_(c);
-        return objpipe::objpipe_errc::success;
       }
 
-      auto push_exception(const std::exception_ptr& ex) noexcept {
+      auto push_exception(const std::exception_ptr& ex) noexcept -> void override {
         /* Discard exception. */
       }
 
@@ -527,31 +977,50 @@ class collector_metric_source {
       history_multiplexer hm_;
     };
 
-    collection_to_msemit_(sink_.new_pipe())
-        .async(objpipe::existingthread_push())
-        .push(wrapper(h));
+    factual_.push_back(std::make_shared<history_subscriber>(h));
   }
 
- private:
-  ///\brief Remove names from collection, keeping only matching names.
-  static auto filter_collection_elements_(
-      const path_matcher& group_filter,
-      const tag_matcher& tag_filter,
-      const path_matcher& metric_filter,
-      collector::collection& c)
-  -> void {
-    c.elements.erase(
-        std::remove_if(
-            c.elements.begin(),
-            c.elements.end(),
-            [&group_filter, &tag_filter, &metric_filter](const collector::collection_element& e) -> bool {
-              return !group_filter(e.group.get_path())
-                  || !tag_filter(e.group.get_tags())
-                  || !metric_filter(e.metric);
-            }),
-        c.elements.end());
+  auto attach_rules(const std::shared_ptr<rule_engine>& engine, std::size_t idx) -> void {
+    ///\brief Feeds the engine, closing the source in the engine once the pipe is done.
+    class rules_subscriber
+    : public factual_subscriber
+    {
+     public:
+      rules_subscriber(std::shared_ptr<rule_engine> engine, std::size_t idx)
+      : engine_(std::move(engine)),
+        idx_(idx)
+      {}
+
+      ~rules_subscriber() noexcept override {
+        close_();
+      }
+
+      auto push_back(const metric_source::emit_type& c) -> void override {
+        engine_->push_back(idx_, std::get<metric_source::metric_emit>(c));
+      }
+
+      auto push_exception(const std::exception_ptr& ex) noexcept -> void override {
+        // The source won't supply more data, so don't wait for it.
+        close_();
+      }
+
+     private:
+      auto close_() noexcept -> void {
+        try {
+          engine_->close(idx_);
+        } catch (...) {
+          /* Discard exception. */
+        }
+      }
+
+      std::shared_ptr<rule_engine> engine_;
+      std::size_t idx_;
+    };
+
+    factual_.push_back(std::make_shared<rules_subscriber>(engine, idx));
   }
 
+ private:
   ///\brief Test if the given filters intersect with provided names.
   auto intersects_(
       path_matcher group_filter,
@@ -580,7 +1049,8 @@ class collector_metric_source {
   }
 
   const collector* c_ = nullptr;
-  sink sink_;
+  std::shared_ptr<sink> sink_ = std::make_shared<sink>();
+  std::vector<std::shared_ptr<factual_subscriber>> factual_;
 };
 
 
@@ -589,7 +1059,8 @@ class collector_metric_source {
 
 auto build_task(
     const configuration& cfg,
-    const std::vector<std::shared_ptr<collect_history>>& histories)
+    const std::vector<std::shared_ptr<collect_history>>& histories,
+    std::function<void(const alert&)> alert_fn)
 -> objpipe::interlock_writer<time_point> {
   time_multiplexer tm;
   std::vector<collector_metric_source> collectors;
@@ -608,11 +1079,29 @@ auto build_task(
         cms.attach_history(history_multiplexer(histories));
       });
 
-  // XXX: handle rules (this will likely affect how histories are attached).
+  // Attach rules.
+  // The engine merges the emits of all collectors, evaluating each time point
+  // once all collectors have reached it.
+  // Collectors that miss their deadline, are no longer waited for.
+  if (!cfg.rules().empty() && !collectors.empty()) {
+    std::vector<time_point::duration> intervals;
+    time_point::duration max_delay(0);
+    for (const auto& opts : cfg.collectors_options()) {
+      const time_point::duration interval = opts.interval.value_or(cfg.interval());
+      intervals.push_back(interval);
+      max_delay = std::max(max_delay, interval + opts.jitter + opts.deadline.value_or(interval));
+    }
+
+    auto engine = std::make_shared<rule_engine>(cfg.rules(), std::move(intervals), max_delay, std::move(alert_fn));
+    for (std::size_t i = 0; i < collectors.size(); ++i)
+      collectors[i].attach_rules(engine, i);
+  }
 
   // Attach time to all collectors.
-  for (collector_metric_source& cms : collectors)
-    std::move(cms).commit(tm.new_pipe());
+  for (std::size_t i = 0; i < collectors.size(); ++i) {
+    collector_metric_source& cms = collectors[i];
+    std::move(cms).commit(tm.new_pipe(cfg.collectors_options()[i], cfg.interval(), cms.late_fn()));
+  }
   // Return functor.
   return std::move(tm).commit();
 }
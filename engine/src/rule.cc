@@ -5,5 +5,9 @@ namespace monsoon {
 
 rule::~rule() noexcept {}
 
+auto rule::window() const noexcept -> time_point::duration {
+  return time_point::duration(0);
+}
+
 
 } /* namespace monsoon */
@@ -0,0 +1,249 @@
+#include <monsoon/rule_engine.h>
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+#include <objpipe/of.h>
+#include <instrumentation/counter.h>
+
+namespace monsoon {
+namespace {
+
+
+auto rule_eval_counter_(bool success)
+-> instrumentation::counter& {
+  static instrumentation::counter success_counter("monsoon.rules.evaluate", { {"result", "success"} });
+  static instrumentation::counter failure_counter("monsoon.rules.evaluate", { {"result", "failure"} });
+
+  return (success ? success_counter : failure_counter);
+}
+
+struct emit_tp_less_ {
+  auto operator()(const metric_source::metric_emit& x, time_point y) const
+  noexcept
+  -> bool {
+    return std::get<0>(x) < y;
+  }
+
+  auto operator()(time_point x, const metric_source::metric_emit& y) const
+  noexcept
+  -> bool {
+    return x < std::get<0>(y);
+  }
+};
+
+
+} /* namespace monsoon::<unnamed> */
+
+
+/**
+ * \brief Metric source exposing the in-memory window of a rule engine.
+ *
+ * \details
+ * Only data at or before the evaluation time point is visible,
+ * so evaluations don't see data of sources that are running ahead.
+ */
+class rule_engine::window_source
+: public metric_source
+{
+ public:
+  window_source(const std::deque<metric_emit>& data, time_point tp)
+  : data_(data),
+    tp_(tp)
+  {}
+
+  ~window_source() noexcept override {}
+
+  auto emit(
+      time_range tr,
+      path_matcher group_filter,
+      tag_matcher group_tag_filter,
+      path_matcher metric_filter,
+      time_point::duration slack) const
+  -> objpipe::reader<emit_type> override {
+    std::vector<emit_type> result;
+
+    std::for_each(
+        begin_(tr, slack), end_(tr, slack),
+        [&](const metric_emit& e) {
+          metric_emit filtered{ std::get<0>(e), {} };
+          for (const auto& elem : std::get<1>(e)) {
+            const group_name& group = std::get<0>(elem.first);
+            const metric_name& metric = std::get<1>(elem.first);
+
+            if (group_filter(group.get_path())
+                && group_tag_filter(group.get_tags())
+                && metric_filter(metric))
+              std::get<1>(filtered).insert(elem);
+          }
+          result.emplace_back(std::in_place_type<metric_emit>, std::move(filtered));
+        });
+
+    return objpipe::of(std::move(result)).iterate();
+  }
+
+  auto emit_time(
+      time_range tr,
+      time_point::duration slack) const
+  -> objpipe::reader<time_point> override {
+    std::vector<time_point> result;
+
+    std::transform(
+        begin_(tr, slack), end_(tr, slack),
+        std::back_inserter(result),
+        [](const metric_emit& e) { return std::get<0>(e); });
+
+    return objpipe::of(std::move(result)).iterate();
+  }
+
+ private:
+  auto begin_(const time_range& tr, time_point::duration slack) const
+  -> std::deque<metric_emit>::const_iterator {
+    if (!tr.begin().has_value()) return data_.begin();
+    return std::lower_bound(data_.begin(), data_.end(), *tr.begin() - slack, emit_tp_less_());
+  }
+
+  auto end_(const time_range& tr, time_point::duration slack) const
+  -> std::deque<metric_emit>::const_iterator {
+    time_point end = tp_;
+    if (tr.end().has_value() && *tr.end() + slack < end) end = *tr.end() + slack;
+    return std::upper_bound(data_.begin(), data_.end(), end, emit_tp_less_());
+  }
+
+  const std::deque<metric_emit>& data_;
+  const time_point tp_;
+};
+
+
+rule_engine::rule_engine(const std::vector<std::unique_ptr<rule>>& rules,
+    std::vector<time_point::duration> intervals,
+    time_point::duration max_delay,
+    alert_fn fn)
+: alert_fn_(std::move(fn)),
+  window_(0),
+  max_delay_(max_delay)
+{
+  rules_.reserve(rules.size());
+  for (const auto& r : rules) {
+    rules_.push_back(r.get());
+    window_ = std::max(window_, r->window());
+  }
+
+  sources_.reserve(intervals.size());
+  for (const auto& interval : intervals)
+    sources_.emplace_back(interval);
+}
+
+rule_engine::~rule_engine() noexcept {}
+
+void rule_engine::push_back(std::size_t source, const metric_source::metric_emit& emit) {
+  const time_point tp = std::get<0>(emit);
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  assert(source < sources_.size());
+
+  // Data for time points that have been evaluated already can't change
+  // the outcome of that evaluation, but may still be used by later ones.
+  merge_(emit);
+  std::optional<time_point>& watermark = sources_[source].watermark;
+  if (!watermark.has_value() || *watermark < tp) watermark = tp;
+  if (!newest_.has_value() || *newest_ < tp) newest_ = tp;
+
+  evaluate_complete_();
+}
+
+void rule_engine::close(std::size_t source) {
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  assert(source < sources_.size());
+
+  sources_[source].closed = true;
+  evaluate_complete_();
+}
+
+auto rule_engine::window() const noexcept -> time_point::duration {
+  return window_;
+}
+
+void rule_engine::merge_(const metric_source::metric_emit& emit) {
+  const time_point tp = std::get<0>(emit);
+
+  // Usually, the time point is the most recent.
+  auto pos = (data_.empty() || std::get<0>(data_.back()) < tp
+      ? data_.end()
+      : std::lower_bound(data_.begin(), data_.end(), tp, emit_tp_less_()));
+  if (pos == data_.end() || std::get<0>(*pos) != tp) {
+    // Don't resurrect data that has expired.
+    if (pos == data_.begin() && expired_.has_value() && tp < *expired_)
+      return;
+    pos = data_.emplace(pos, tp, std::tuple_element_t<1, metric_source::metric_emit>());
+  }
+
+  auto& dst = std::get<1>(*pos);
+  for (const auto& elem : std::get<1>(emit)) {
+#if __cplusplus >= 201703
+    dst.insert_or_assign(elem.first, elem.second);
+#else
+    dst[elem.first] = elem.second;
+#endif
+  }
+}
+
+auto rule_engine::complete_(time_point tp) const noexcept -> bool {
+  // Sources that are late are not waited for indefinitely.
+  if (newest_.has_value() && tp <= *newest_ - max_delay_) return true;
+
+  return std::all_of(sources_.begin(), sources_.end(),
+      [tp](const source_state& s) {
+        return s.closed
+            || (s.watermark.has_value()
+                && (tp <= *s.watermark || tp < *s.watermark + s.interval));
+      });
+}
+
+void rule_engine::evaluate_complete_() {
+  auto iter = (evaluated_.has_value()
+      ? std::upper_bound(data_.cbegin(), data_.cend(), *evaluated_, emit_tp_less_())
+      : data_.cbegin());
+  while (iter != data_.cend() && complete_(std::get<0>(*iter)))
+    evaluate_(std::get<0>(*iter++));
+  expire_();
+}
+
+void rule_engine::evaluate_(time_point tp) {
+  const window_source ms(data_, tp);
+
+  for (rule* r : rules_) {
+    std::vector<alert> transitions;
+    try {
+      transitions = (*r)(ms, tp);
+    } catch (...) {
+      ++rule_eval_counter_(false);
+      continue;
+    }
+    ++rule_eval_counter_(true);
+
+    if (alert_fn_) {
+      for (const alert& a : transitions)
+        alert_fn_(a);
+    }
+  }
+
+  evaluated_ = tp;
+}
+
+void rule_engine::expire_() {
+  // Time points that are yet to be evaluated, are after both the evaluated
+  // time point and the maximum delay before the most recent data.
+  std::optional<time_point> oldest;
+  if (evaluated_.has_value())
+    oldest = *evaluated_ - window_;
+  if (newest_.has_value() && (!oldest.has_value() || *oldest < *newest_ - max_delay_ - window_))
+    oldest = *newest_ - max_delay_ - window_;
+  if (!oldest.has_value()) return;
+
+  if (!expired_.has_value() || *expired_ < *oldest) expired_ = oldest;
+  while (!data_.empty() && std::get<0>(data_.front()) < *expired_)
+    data_.pop_front();
+}
+
+
+} /* namespace monsoon */
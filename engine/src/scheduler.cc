@@ -0,0 +1,94 @@
+#include <monsoon/scheduler.h>
+#include <chrono>
+#include <stdexcept>
+#include <instrumentation/engine.h>
+#include <instrumentation/counter.h>
+
+namespace monsoon {
+namespace {
+
+
+// time_point::now() has a resolution of seconds, too coarse for scheduling.
+auto now_()
+-> time_point {
+  return time_point(std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+      .count());
+}
+
+auto to_system_clock_(time_point tp)
+-> std::chrono::system_clock::time_point {
+  return std::chrono::system_clock::time_point(
+      std::chrono::milliseconds(tp.millis_since_posix_epoch()));
+}
+
+
+} /* namespace monsoon::<unnamed> */
+
+
+scheduler::scheduler(time_point::duration interval)
+: interval_(interval),
+  lateness_(std::make_shared<std::atomic<std::int64_t>>(0))
+{
+  if (interval_ <= time_point::duration(0))
+    throw std::invalid_argument("scheduler interval must be positive");
+
+  lateness_gauge_ = instrumentation::engine::global().new_gauge_cb(
+      instrumentation::path("monsoon.scheduler.lateness_msec"),
+      instrumentation::tags(),
+      [lateness=std::weak_ptr<std::atomic<std::int64_t>>(lateness_)]() -> double {
+        const auto lptr = lateness.lock();
+        return (lptr ? lptr->load() : 0);
+      });
+}
+
+scheduler::~scheduler() noexcept {}
+
+void scheduler::run(const task_type& task) {
+  static instrumentation::counter missed_ticks("monsoon.scheduler.missed_ticks", {});
+
+  time_point next = next_tick(now_());
+  std::unique_lock<std::mutex> lck{ mtx_ };
+  for (;;) {
+    if (cnd_.wait_until(lck, to_system_clock_(next), [this]() { return stop_; }))
+      return;
+    lck.unlock();
+
+    lateness_->store((now_() - next).millis());
+    task(next);
+
+    // Ticks that passed while the task ran are coalesced into the next one.
+    const time_point following = next + interval_;
+    next = next_tick(now_());
+    if (next < following) {
+      next = following;
+    } else {
+      for (auto missed = (next - following).millis() / interval_.millis(); missed > 0; --missed)
+        ++missed_ticks;
+    }
+
+    lck.lock();
+  }
+}
+
+void scheduler::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    stop_ = true;
+  }
+  cnd_.notify_all();
+}
+
+auto scheduler::interval() const noexcept -> time_point::duration {
+  return interval_;
+}
+
+auto scheduler::next_tick(time_point tp) const noexcept -> time_point {
+  const std::int64_t interval = interval_.millis();
+  std::int64_t rem = tp.millis_since_posix_epoch() % interval;
+  if (rem < 0) rem += interval;
+  return (rem == 0 ? tp : tp + time_point::duration(interval - rem));
+}
+
+
+} /* namespace monsoon */
@@ -0,0 +1,242 @@
+#include "UnitTest++/UnitTest++.h"
+#include <monsoon/rule_engine.h>
+#include <monsoon/alert_rule.h>
+#include <monsoon/expressions/constant.h>
+#include <monsoon/expressions/operators.h>
+#include <monsoon/expressions/selector.h>
+#include <monsoon/metric_value.h>
+#include <monsoon/path_matcher.h>
+#include <monsoon/tag_matcher.h>
+#include <monsoon/time_range.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using monsoon::alert;
+using monsoon::alert_state;
+using monsoon::rule;
+using monsoon::rule_engine;
+using monsoon::time_point;
+
+namespace monsoon {
+inline auto operator<<(std::ostream& out, alert_state s)
+-> std::ostream& {
+  return out << static_cast<int>(s);
+}
+} /* namespace monsoon */
+
+namespace std {
+template<typename T>
+inline auto operator<<(std::ostream& out, const std::vector<T>& vec)
+-> std::ostream& {
+  auto i = vec.cbegin();
+  out << "[";
+  if (i != vec.cend()) out << " " << *i++;
+  while (i != vec.cend()) out << ", " << *i++;
+  out << (vec.empty() ? "]" : " ]");
+  return out;
+}
+} /* namespace std */
+
+namespace {
+
+
+const time_point base_time = time_point("2000-01-01T00:00:00.000Z");
+const time_point::duration interval = time_point::duration(10000);
+
+auto intervals(std::int64_t n) -> time_point::duration {
+  return time_point::duration(n * interval.millis());
+}
+
+///\brief The i'th collection time point.
+auto t(std::int64_t i) -> time_point {
+  return base_time + intervals(i);
+}
+
+auto emit_at(time_point tp, const std::string& metric, std::int64_t value)
+-> monsoon::metric_source::metric_emit {
+  monsoon::metric_source::metric_emit result{ tp, {} };
+  std::get<1>(result)[
+      std::make_tuple(
+          monsoon::group_name(monsoon::simple_group({ "test" })),
+          monsoon::metric_name({ metric }))] = monsoon::metric_value(value);
+  return result;
+}
+
+///\brief Rule recording what each evaluation sees.
+class recording_rule
+: public rule
+{
+ public:
+  explicit recording_rule(time_point::duration window = time_point::duration(0))
+  : window_(window)
+  {}
+
+  auto operator()(const monsoon::metric_source& ms, time_point tp)
+  -> std::vector<alert> override {
+    monsoon::path_matcher all_paths;
+    all_paths.push_back_double_wildcard();
+    monsoon::time_range tr;
+    tr.begin(tp);
+    tr.end(tp);
+
+    std::size_t metrics = 0;
+    for (const auto& e : ms.emit(tr, all_paths, monsoon::tag_matcher(), all_paths).to_vector())
+      metrics += std::get<1>(std::get<monsoon::metric_source::metric_emit>(e)).size();
+
+    evaluated.push_back(tp);
+    metric_counts.push_back(metrics);
+    visible.push_back(ms.emit_time(monsoon::time_range(), time_point::duration(0)).to_vector());
+    return {};
+  }
+
+  auto window() const noexcept -> time_point::duration override {
+    return window_;
+  }
+
+  std::vector<time_point> evaluated;
+  ///\brief Number of metrics at the evaluated time point.
+  std::vector<std::size_t> metric_counts;
+  ///\brief Time points visible to the evaluation.
+  std::vector<std::vector<time_point>> visible;
+
+ private:
+  time_point::duration window_;
+};
+
+struct fixture {
+  explicit fixture(time_point::duration window = time_point::duration(0)) {
+    rules.push_back(std::make_unique<recording_rule>(window));
+  }
+
+  auto rec() const -> const recording_rule& {
+    return static_cast<const recording_rule&>(*rules.front());
+  }
+
+  std::vector<std::unique_ptr<rule>> rules;
+};
+
+
+} /* namespace <unnamed> */
+
+TEST(out_of_order_sources) {
+  fixture f;
+  rule_engine engine(f.rules, { interval, interval }, intervals(30), nullptr);
+
+  engine.push_back(1, emit_at(t(1), "b", 1));
+  CHECK_EQUAL(std::vector<time_point>(), f.rec().evaluated);
+
+  engine.push_back(0, emit_at(t(0), "a", 1));
+  CHECK_EQUAL(std::vector<time_point>({ t(0) }), f.rec().evaluated);
+
+  engine.push_back(0, emit_at(t(1), "a", 1));
+  engine.push_back(1, emit_at(t(0), "b", 1)); // Late, t(0) was already evaluated.
+  CHECK_EQUAL(std::vector<time_point>({ t(0), t(1) }), f.rec().evaluated);
+  CHECK_EQUAL(std::vector<std::size_t>({ 1u, 2u }), f.rec().metric_counts);
+}
+
+TEST(slow_source_does_not_delay_evaluation) {
+  fixture f;
+  rule_engine engine(f.rules, { interval, intervals(6) }, intervals(30), nullptr);
+
+  engine.push_back(1, emit_at(t(0), "b", 1));
+  engine.push_back(0, emit_at(t(0), "a", 1));
+  engine.push_back(0, emit_at(t(1), "a", 1));
+  engine.push_back(0, emit_at(t(2), "a", 1));
+  CHECK_EQUAL(std::vector<time_point>({ t(0), t(1), t(2) }), f.rec().evaluated);
+}
+
+TEST(closed_source_is_not_waited_for) {
+  fixture f;
+  rule_engine engine(f.rules, { interval, interval }, intervals(30), nullptr);
+
+  engine.push_back(0, emit_at(t(0), "a", 1));
+  engine.push_back(1, emit_at(t(0), "b", 1));
+  engine.push_back(0, emit_at(t(1), "a", 1));
+  CHECK_EQUAL(std::vector<time_point>({ t(0) }), f.rec().evaluated);
+
+  engine.close(1);
+  CHECK_EQUAL(std::vector<time_point>({ t(0), t(1) }), f.rec().evaluated);
+}
+
+TEST(late_source_is_waited_for_at_most_max_delay) {
+  fixture f;
+  rule_engine engine(f.rules, { interval, interval }, intervals(3), nullptr);
+
+  for (int i = 0; i <= 5; ++i)
+    engine.push_back(0, emit_at(t(i), "a", 1));
+  CHECK_EQUAL(std::vector<time_point>({ t(0), t(1), t(2) }), f.rec().evaluated);
+}
+
+TEST(data_expires) {
+  const time_point::duration window = intervals(2);
+  fixture f(window);
+  rule_engine engine(f.rules, { interval }, interval, nullptr);
+
+  for (int i = 0; i < 100; ++i)
+    engine.push_back(0, emit_at(t(i), "a", 1));
+
+  REQUIRE CHECK_EQUAL(100u, f.rec().evaluated.size());
+  for (std::size_t i = 0; i < f.rec().visible.size(); ++i) {
+    const time_point tp = f.rec().evaluated[i];
+    const std::vector<time_point>& visible = f.rec().visible[i];
+    // The window is available, and not much more.
+    CHECK(visible.front() <= std::max(tp - window, t(0)));
+    CHECK(visible.size() <= 4u);
+    CHECK_EQUAL(tp, visible.back());
+  }
+}
+
+TEST(data_expires_while_source_is_late) {
+  fixture f;
+  rule_engine engine(f.rules, { interval, interval }, intervals(5), nullptr);
+
+  engine.push_back(1, emit_at(t(0), "b", 1));
+  for (int i = 0; i < 100; ++i)
+    engine.push_back(0, emit_at(t(i), "a", 1));
+
+  REQUIRE CHECK_EQUAL(95u, f.rec().evaluated.size());
+  // Data kept for the time points that are waiting for source 1 is bounded.
+  CHECK(f.rec().visible.back().size() <= 7u);
+}
+
+TEST(alert_transitions) {
+  monsoon::path_matcher group, metric;
+  group.push_back_literal("test");
+  metric.push_back_literal("x");
+
+  std::vector<std::unique_ptr<rule>> rules;
+  rules.push_back(std::make_unique<monsoon::alert_rule>(
+          monsoon::simple_group({ "test_alert" }),
+          monsoon::expressions::cmp_gt(
+              monsoon::expressions::selector(group, metric),
+              monsoon::expressions::constant(monsoon::metric_value(5))),
+          intervals(2),
+          "x is too large"));
+
+  std::vector<alert_state> states;
+  rule_engine engine(rules, { interval }, interval,
+      [&states](const alert& a) { states.push_back(a.get_state()); });
+
+  const std::int64_t values[] = { 1, 10, 10, 10, 1 };
+  for (std::size_t i = 0; i < std::size(values); ++i)
+    engine.push_back(0, emit_at(t(i), "x", values[i]));
+
+  CHECK_EQUAL(
+      std::vector<alert_state>({
+          alert_state::OK,
+          alert_state::TRIGGERING,
+          alert_state::FIRING,
+          alert_state::OK
+      }),
+      states);
+}
+
+int main() {
+  return UnitTest::RunAllTests();
+}
@@ -2,9 +2,16 @@
 #define MONSOON_HISTORY_DIR_DIRHISTORY_H
 
 #include <monsoon/history/dir/dirhistory_export_.h>
+#include <monsoon/history/dir/tsdata.h>
 #include <monsoon/history/collect_history.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 #if __has_include(<filesystem>)
 # include <filesystem>
@@ -21,14 +28,62 @@ namespace filesystem = ::std::filesystem;
 namespace filesystem = ::boost::filesystem;
 #endif
 
-class tsdata;
-
 
 class monsoon_dirhistory_export_ dirhistory
 : public collect_history
 {
  public:
+  ///\brief When appended data is made durable.
+  enum class durability_mode {
+    ///\brief Each append is synced to disk before it completes.
+    PER_APPEND,
+    ///\brief Appends are synced to disk in the background,
+    ///once \ref options::sync_appends appends are pending or
+    ///\ref options::sync_interval passed since the oldest pending append.
+    BATCHED,
+    ///\brief Data is written back by the operating system.
+    ///\details
+    ///The file header is updated in the background, with the same triggers as
+    ///\ref durability_mode::BATCHED, but not synced.
+    ///After a crash of the machine, the file may refer to data that never
+    ///reached the disk.
+    OS_MANAGED
+  };
+
+  ///\brief Rotation and retention settings.
+  ///\details Unset fields are not applied.
+  struct options {
+    ///\brief Start a new file once the current file reaches this size in bytes.
+    std::optional<std::uintmax_t> max_file_size;
+    ///\brief Start a new file once the current file holds this many records.
+    std::optional<std::uint64_t> max_file_records;
+    ///\brief Start a new file whenever a multiple of this interval
+    ///(since the posix epoch) is crossed.
+    ///\details For example, 24 hours rotates daily at UTC midnight.
+    std::optional<time_point::duration> rotate_interval;
+    ///\brief Files with no data newer than this are expired.
+    std::optional<time_point::duration> retention;
+    ///\brief If set, expired files are moved into this directory,
+    ///instead of being deleted.
+    std::optional<filesystem::path> archive_dir;
+    ///\brief Compression of newly started files.
+    ///\details Defaults to gzip.
+    std::optional<tsdata::compression_type> compression;
+    ///\brief Compression of files written by compaction.
+    ///\details Defaults to the value of \ref compression.
+    std::optional<tsdata::compression_type> compaction_compression;
+    ///\brief When appended data is made durable.
+    ///\details Defaults to \ref durability_mode::PER_APPEND.
+    std::optional<durability_mode> durability;
+    ///\brief Number of pending appends that triggers a background sync.
+    std::optional<std::uint64_t> sync_appends;
+    ///\brief Maximum age of a pending append before a background sync.
+    ///\details Defaults to 1 second, unless \ref sync_appends is set.
+    std::optional<time_point::duration> sync_interval;
+  };
+
   dirhistory(filesystem::path, bool = true);
+  dirhistory(filesystem::path, options, bool = true);
   ~dirhistory() noexcept override;
 
  private:
@@ -49,21 +104,84 @@ class monsoon_dirhistory_export_ dirhistory
       time_point::duration = time_point::duration(0)) const
   -> objpipe::reader<time_point> override;
 
+  ///\brief Number of background syncs that completed successfully.
+  ///\details Only advances for \ref durability_mode::BATCHED and
+  ///\ref durability_mode::OS_MANAGED.
+  auto background_syncs() const noexcept -> std::uint64_t;
+
  private:
   dirhistory(const dirhistory&&) = delete;
   dirhistory(dirhistory&&) = delete;
 
   monsoon_dirhistory_local_
   void maybe_start_new_file_(time_point);
+  ///\brief Test if the write file should be closed before writing \p tp.
+  ///\note Must be called with mtx_ held and write_file_ set.
+  monsoon_dirhistory_local_
+  auto should_rotate_(time_point) -> bool;
   monsoon_dirhistory_local_
   static auto decide_fname_(time_point) -> filesystem::path;
+  monsoon_dirhistory_local_
+  auto files_snapshot_() const -> std::vector<std::shared_ptr<tsdata>>;
+  ///\brief Change the write file, syncing the previous one.
+  ///\param records The number of records in the new write file.
+  ///\note Must be called with mtx_ held.
+  monsoon_dirhistory_local_
+  void set_write_file_(std::shared_ptr<tsdata>, std::uint64_t records = 0u);
+
+  ///\brief Background thread, syncing appends for
+  ///\ref durability_mode::BATCHED and \ref durability_mode::OS_MANAGED.
+  monsoon_dirhistory_local_
+  void flusher_run_();
+  ///\brief Sync the write file.
+  ///\note Must be called with mtx_ held, which is released during the sync.
+  monsoon_dirhistory_local_
+  void flush_(std::unique_lock<std::mutex>&);
+
+  ///\brief Background thread, expiring old files and
+  ///rewriting closed list files as tables files.
+  monsoon_dirhistory_local_
+  void compactor_run_();
+  ///\brief Select a file for compaction.
+  ///\note Must be called with mtx_ held.
+  monsoon_dirhistory_local_
+  auto compaction_candidate_() const -> std::shared_ptr<tsdata>;
+  ///\brief Rewrite the given file as a tables file and swap it into files_.
+  monsoon_dirhistory_local_
+  void compact_(const std::shared_ptr<tsdata>&);
+  ///\brief Remove files that fell outside the retention period.
+  monsoon_dirhistory_local_
+  void expire_files_();
 
   const filesystem::path dir_;
+  const options opts_;
+  std::mutex append_mtx_; // Serializes appends; acquired before mtx_.
+  mutable std::mutex mtx_; // Protects files_, write_file_, write_file_records_, write_file_size_ and compaction_failed_.
   std::shared_ptr<std::vector<std::shared_ptr<tsdata>>> files_ = std::make_shared<std::vector<std::shared_ptr<tsdata>>>();
   std::shared_ptr<tsdata> write_file_; // May be null.
+  std::uint64_t write_file_records_ = 0u; // Records in write_file_, maintained by appends.
+  std::optional<std::uintmax_t> write_file_size_; // Size of write_file_, if known.
   const bool writable_;
 
   std::shared_ptr<void> file_count_;
+
+  ///\brief Appends that were not yet synced.
+  struct pending_sync {
+    std::atomic<std::uint64_t> appends{ 0u };
+    ///\brief Steady clock time of the oldest pending append, in msec.
+    std::atomic<std::int64_t> since{ 0 };
+  };
+  const std::shared_ptr<pending_sync> pending_sync_ = std::make_shared<pending_sync>();
+  std::shared_ptr<void> pending_appends_gauge_, pending_age_gauge_;
+  std::condition_variable flusher_cv_;
+  std::atomic<bool> flusher_stop_{ false };
+  std::atomic<std::uint64_t> background_syncs_{ 0u };
+  std::thread flusher_;
+
+  std::vector<std::shared_ptr<tsdata>> compaction_failed_; // Not retried.
+  std::condition_variable compactor_cv_;
+  std::atomic<bool> compactor_stop_{ false };
+  std::thread compactor_;
 };
 
 
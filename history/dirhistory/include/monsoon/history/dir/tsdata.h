@@ -3,7 +3,9 @@
 
 #include <monsoon/history/dir/dirhistory_export_.h>
 #include <monsoon/io/fd.h>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <tuple>
@@ -18,6 +20,15 @@ class monsoon_dirhistory_export_ tsdata {
  public:
   using emit_type = metric_source::metric_emit;
 
+  ///\brief Compression applied to the data in a file.
+  enum class compression_type {
+    NONE,
+    GZIP,
+    ///\brief Snappy framing format, decoding much faster than gzip,
+    ///at the cost of larger files.
+    SNAPPY
+  };
+
   virtual ~tsdata() noexcept;
 
   monsoon_dirhistory_export_
@@ -35,6 +46,37 @@ class monsoon_dirhistory_export_ tsdata {
   static auto new_file(io::fd&&, std::uint16_t) -> std::shared_ptr<tsdata>;
   monsoon_dirhistory_export_
   static auto new_file(io::fd&&) -> std::shared_ptr<tsdata>;
+  /**
+   * \brief Create a new, read-only file, holding the given data.
+   *
+   * \details
+   * The file is written using the tables layout, which is optimized for
+   * reading, but can not be appended to.
+   * \param[in] fd The file to write.
+   * \param[in] data The data to write, usually the emit() of another tsdata.
+   * \param[in] compression The compression used for the file contents.
+   */
+  monsoon_dirhistory_export_
+  static auto new_tables_file(io::fd&& fd, objpipe::reader<emit_type> data,
+      compression_type compression)
+      -> std::shared_ptr<tsdata>;
+  monsoon_dirhistory_export_
+  static auto new_tables_file(io::fd&& fd, objpipe::reader<emit_type> data)
+      -> std::shared_ptr<tsdata>;
+  /**
+   * \brief Create a new, read-only file, holding the given time series.
+   *
+   * \details
+   * Unlike emitted data, time series can hold groups without metrics,
+   * which are preserved in the file.
+   * \param[in] fd The file to write.
+   * \param[in] data The data to write, usually the read_all() of another tsdata.
+   * \param[in] compression The compression used for the file contents.
+   */
+  monsoon_dirhistory_export_
+  static auto new_tables_file(io::fd&& fd, const std::vector<time_series>& data,
+      compression_type compression)
+      -> std::shared_ptr<tsdata>;
 
   /**
    * \brief Return the file version.
@@ -61,9 +103,39 @@ class monsoon_dirhistory_export_ tsdata {
 
   virtual void push_back(const emit_type& c) = 0;
 
+  /**
+   * \brief Select if push_back() makes appended data durable.
+   *
+   * \details
+   * By default, push_back() waits for the appended data and the updated
+   * file header to reach the disk.
+   * If disabled, push_back() leaves writing back the data to the operating
+   * system, and defers the header update until sync() is called.
+   * Appended data is visible to readers of this tsdata either way.
+   *
+   * Files that do not support deferred header updates ignore this.
+   */
+  virtual void set_sync_on_push_back(bool);
+
+  /**
+   * \brief Write deferred header updates.
+   * \param durable If set, wait for the data and header to reach the disk.
+   * \sa set_sync_on_push_back
+   */
+  virtual void sync(bool durable);
+
   ///\brief Returns the path to the underlying file.
   virtual std::optional<std::string> get_path() const = 0;
 
+  /**
+   * \brief Returns the size of the file in bytes.
+   *
+   * \details
+   * Files that track their size in memory answer without touching the disk.
+   * \note Must not be called concurrently with push_back().
+   */
+  virtual auto file_size() const -> std::optional<std::uintmax_t>;
+
   /**
    * \brief Emit metrics matching the given constraints.
    *
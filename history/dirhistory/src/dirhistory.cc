@@ -1,6 +1,7 @@
 #include <monsoon/history/dir/dirhistory.h>
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <functional>
 #include <iomanip>
@@ -20,18 +21,76 @@
 #include <monsoon/history/collect_history.h>
 #include <monsoon/history/dir/tsdata.h>
 #include <monsoon/interpolate.h>
+#include <monsoon/path_matcher.h>
+#include <monsoon/tag_matcher.h>
 #include <objpipe/callback.h>
 #include <objpipe/array.h>
 #include <objpipe/push_policies.h>
 #include <objpipe/merge.h>
 #include <objpipe/of.h>
 #include <instrumentation/engine.h>
+#include <instrumentation/counter.h>
 #include "v2/tsdata.h"
+#include "v2/tsdata_list.h"
 
 namespace monsoon::history {
 namespace {
 
 
+///\brief Extension of files that are being compacted.
+constexpr char compact_tmp_extension[] = ".compact-tmp";
+///\brief How often the maintenance thread checks for expired files.
+constexpr auto expire_check_interval = std::chrono::minutes(10);
+///\brief Default maximum age of appends that were not synced.
+constexpr auto default_sync_interval = std::chrono::seconds(1);
+///\brief Delay before retrying a failed background sync.
+constexpr auto sync_retry_interval = std::chrono::seconds(1);
+
+auto steady_millis_() noexcept -> std::int64_t {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+///\brief Counter of syncs of appended data.
+auto sync_counter_(dirhistory::durability_mode mode, bool success)
+-> instrumentation::counter& {
+  using mode_t = dirhistory::durability_mode;
+
+  static instrumentation::counter per_append("monsoon.dirhistory.sync", { {"durability", "per_append"}, {"result", "success"} });
+  static instrumentation::counter batched("monsoon.dirhistory.sync", { {"durability", "batched"}, {"result", "success"} });
+  static instrumentation::counter batched_failure("monsoon.dirhistory.sync", { {"durability", "batched"}, {"result", "failure"} });
+  static instrumentation::counter os_managed("monsoon.dirhistory.sync", { {"durability", "os_managed"}, {"result", "success"} });
+  static instrumentation::counter os_managed_failure("monsoon.dirhistory.sync", { {"durability", "os_managed"}, {"result", "failure"} });
+
+  switch (mode) {
+    case mode_t::PER_APPEND:
+      break;
+    case mode_t::BATCHED:
+      return (success ? batched : batched_failure);
+    case mode_t::OS_MANAGED:
+      return (success ? os_managed : os_managed_failure);
+  }
+  return per_append;
+}
+
+///\brief Number of whole intervals since the posix epoch, rounded down.
+auto interval_index_(time_point tp, time_point::duration interval)
+noexcept
+-> std::int64_t {
+  const std::int64_t millis = tp.millis_since_posix_epoch();
+  const std::int64_t width = interval.millis();
+  return millis / width - (millis % width < 0 ? 1 : 0);
+}
+
+void remove_noexcept_(const filesystem::path& p) noexcept {
+  try {
+    filesystem::remove(p);
+  } catch (...) {
+    // Ignore.
+  }
+}
+
 struct merge_emit_greater_ {
   template<typename X, typename Y>
   auto operator()(const X& x, const Y& y) const
@@ -718,7 +777,12 @@ auto interpolation_based_emit(
 
 
 dirhistory::dirhistory(filesystem::path dir, bool open_for_write)
+: dirhistory(std::move(dir), options(), open_for_write)
+{}
+
+dirhistory::dirhistory(filesystem::path dir, options opts, bool open_for_write)
 : dir_(std::move(dir)),
+  opts_(std::move(opts)),
   writable_(open_for_write),
   file_count_(
       instrumentation::engine::global().new_gauge_cb(
@@ -736,18 +800,34 @@ dirhistory::dirhistory(filesystem::path dir, bool open_for_write)
   if (!dir_.is_absolute())
     throw std::invalid_argument("dirhistory requires an absolute path");
   if (open_for_write &&
-      (filesystem::status(dir_).permissions() & perms::owner_write) != perms::none)
+      (filesystem::status(dir_).permissions() & perms::owner_write) == perms::none)
     throw std::invalid_argument("dirhistory path is not writable");
+  if (opts_.rotate_interval.has_value()
+      && *opts_.rotate_interval <= time_point::duration(0))
+    throw std::invalid_argument("dirhistory rotate interval must be positive");
+  if (opts_.archive_dir.has_value() && !filesystem::is_directory(*opts_.archive_dir))
+    throw std::invalid_argument("dirhistory archive path is not a directory");
+  if (opts_.sync_appends.has_value() && *opts_.sync_appends == 0u)
+    throw std::invalid_argument("dirhistory sync appends must be positive");
+  if (opts_.sync_interval.has_value()
+      && *opts_.sync_interval <= time_point::duration(0))
+    throw std::invalid_argument("dirhistory sync interval must be positive");
 
   // Scan directory for files to manage.
   std::for_each(
       filesystem::directory_iterator(dir_), filesystem::directory_iterator(),
       [this, open_for_write](const filesystem::path& fname) {
+        // Remove compactions that were interrupted.
+        if (fname.extension() == compact_tmp_extension) {
+          if (open_for_write) remove_noexcept_(fname);
+          return;
+        }
+
         const auto fstat = filesystem::status(fname);
         if (filesystem::is_regular_file(fstat)) {
           io::fd::open_mode mode = io::fd::READ_WRITE;
           if (!open_for_write ||
-              (fstat.permissions() & perms::owner_write) != perms::none)
+              (fstat.permissions() & perms::owner_write) == perms::none)
             mode = io::fd::READ_ONLY;
 
           auto fd = io::fd(fname.native(), mode);
@@ -760,34 +840,203 @@ dirhistory::dirhistory(filesystem::path dir, bool open_for_write)
     auto fiter = std::find_if(files_->begin(), files_->end(),
         [](const auto& tsdata_ptr) { return tsdata_ptr->is_writable(); });
     if (fiter != files_->end()) {
-      write_file_ = *fiter;
+      std::shared_ptr<tsdata> candidate = *fiter;
 
       while (++fiter != files_->end()) {
         if ((*fiter)->is_writable()
-            && std::get<0>((*fiter)->time()) > std::get<0>(write_file_->time()))
-          write_file_ = *fiter;
+            && std::get<0>((*fiter)->time()) > std::get<0>(candidate->time()))
+          candidate = *fiter;
       }
+
+      // Count records once, so appends don't have to scan the file.
+      std::uint64_t records = 0u;
+      if (opts_.max_file_records.has_value())
+        records = candidate->emit_time(std::nullopt, std::nullopt).to_vector().size();
+      set_write_file_(std::move(candidate), records);
     }
+
+    if (opts_.durability.value_or(durability_mode::PER_APPEND) != durability_mode::PER_APPEND) {
+      const auto tags = instrumentation::tags({ {"path", this->dir_.native()} });
+      pending_appends_gauge_ = instrumentation::engine::global().new_gauge_cb(
+          instrumentation::path("monsoon.history.sync.pending_appends"),
+          tags,
+          [pending=std::weak_ptr<pending_sync>(pending_sync_)]() -> double {
+            const auto pptr = pending.lock();
+            return (pptr ? pptr->appends.load() : 0u);
+          });
+      pending_age_gauge_ = instrumentation::engine::global().new_gauge_cb(
+          instrumentation::path("monsoon.history.sync.pending_age_msec"),
+          tags,
+          [pending=std::weak_ptr<pending_sync>(pending_sync_)]() -> double {
+            const auto pptr = pending.lock();
+            if (!pptr || pptr->appends.load() == 0u) return 0;
+            return steady_millis_() - pptr->since.load();
+          });
+
+      flusher_ = std::thread(&dirhistory::flusher_run_, this);
+    }
+
+    compactor_ = std::thread(&dirhistory::compactor_run_, this);
   }
 }
 
-dirhistory::~dirhistory() noexcept {}
+dirhistory::~dirhistory() noexcept {
+  if (compactor_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      compactor_stop_ = true;
+    }
+    compactor_cv_.notify_all();
+    compactor_.join();
+  }
+
+  if (flusher_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      flusher_stop_ = true;
+    }
+    flusher_cv_.notify_all();
+    flusher_.join();
+  }
+
+  try {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    set_write_file_(nullptr);
+  } catch (...) {
+    // Appends since the last sync may be lost.
+  }
+}
 
 void dirhistory::do_push_back_(const metric_emit& ts) {
-  maybe_start_new_file_(std::get<0>(ts));
-  write_file_->push_back(ts);
+  // Once a file is rotated out, no append to it can be in progress,
+  // so it can safely be compacted.
+  std::lock_guard<std::mutex> append_lck{ append_mtx_ };
+
+  std::shared_ptr<tsdata> f;
+  {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    maybe_start_new_file_(std::get<0>(ts));
+    f = write_file_;
+  }
+
+  // Append without holding mtx_, so readers don't wait for the write and sync.
+  f->push_back(ts);
+
+  const auto mode = opts_.durability.value_or(durability_mode::PER_APPEND);
+  if (mode == durability_mode::PER_APPEND) ++sync_counter_(mode, true);
+
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  if (f == write_file_) {
+    ++write_file_records_;
+    write_file_size_ = f->file_size();
+  }
+
+  if (mode != durability_mode::PER_APPEND) {
+    // Counted and notified with mtx_ held, so the wakeup can't land between
+    // the flusher checking for pending appends and starting to wait.
+    const std::uint64_t appends = ++pending_sync_->appends;
+    if (appends == 1u) pending_sync_->since = steady_millis_();
+    if (appends == 1u
+        || (opts_.sync_appends.has_value() && appends == *opts_.sync_appends))
+      flusher_cv_.notify_all();
+  }
+}
+
+void dirhistory::set_write_file_(std::shared_ptr<tsdata> f, std::uint64_t records) {
+  const auto mode = opts_.durability.value_or(durability_mode::PER_APPEND);
+
+  if (write_file_ != nullptr && mode != durability_mode::PER_APPEND) {
+    write_file_->sync(mode == durability_mode::BATCHED);
+    pending_sync_->appends = 0u;
+  }
+
+  write_file_ = std::move(f);
+  write_file_records_ = records;
+  write_file_size_ = (write_file_ != nullptr ? write_file_->file_size() : std::nullopt);
+  if (write_file_ != nullptr && mode != durability_mode::PER_APPEND)
+    write_file_->set_sync_on_push_back(false);
+}
+
+void dirhistory::flusher_run_() {
+  using std::chrono::milliseconds;
+  using std::chrono::steady_clock;
+
+  std::optional<milliseconds> interval;
+  if (opts_.sync_interval.has_value())
+    interval = milliseconds(opts_.sync_interval->millis());
+  else if (!opts_.sync_appends.has_value())
+    interval = default_sync_interval;
+
+  std::unique_lock<std::mutex> lck{ mtx_ };
+  while (!flusher_stop_) {
+    const std::uint64_t appends = pending_sync_->appends;
+    if (appends == 0u) {
+      flusher_cv_.wait(lck);
+      continue;
+    }
+
+    if (!opts_.sync_appends.has_value() || appends < *opts_.sync_appends) {
+      if (!interval.has_value()) {
+        flusher_cv_.wait(lck);
+        continue;
+      }
+
+      const auto deadline =
+          steady_clock::time_point(milliseconds(pending_sync_->since.load()))
+          + *interval;
+      if (steady_clock::now() < deadline) {
+        flusher_cv_.wait_until(lck, deadline);
+        continue;
+      }
+    }
+
+    flush_(lck);
+  }
+}
+
+void dirhistory::flush_(std::unique_lock<std::mutex>& lck) {
+  assert(lck.owns_lock());
+  const auto mode = opts_.durability.value_or(durability_mode::PER_APPEND);
+  const std::shared_ptr<tsdata> f = write_file_;
+  const std::uint64_t appends = pending_sync_->appends.exchange(0u);
+  if (f == nullptr) return;
+
+  // Appends during the sync are counted towards the next sync.
+  lck.unlock();
+  bool failed = false;
+  try {
+    f->sync(mode == durability_mode::BATCHED);
+  } catch (...) {
+    failed = true;
+  }
+  lck.lock();
+  ++sync_counter_(mode, !failed);
+  if (!failed) ++background_syncs_;
+
+  if (failed && f == write_file_) {
+    if (pending_sync_->appends.fetch_add(appends) == 0u)
+      pending_sync_->since = steady_millis_();
+    flusher_cv_.wait_for(lck, sync_retry_interval);
+  }
+}
+
+auto dirhistory::files_snapshot_() const
+-> std::vector<std::shared_ptr<tsdata>> {
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  return *files_;
 }
 
 auto dirhistory::time() const -> std::tuple<time_point, time_point> {
-  if (files_->empty()) {
+  const auto files = files_snapshot_();
+  if (files.empty()) {
     auto rv = time_point::now();
     return std::make_tuple(rv, rv);
   }
 
 #if __cplusplus >= 201703
   return std::transform_reduce(
-      std::next(files_->begin()), files_->end(),
-      files_->front()->time(),
+      std::next(files.begin()), files.end(),
+      files.front()->time(),
       [](const auto& x, const auto& y) {
         return std::make_tuple(
             std::min(std::get<0>(x), std::get<0>(y)),
@@ -797,10 +1046,10 @@ auto dirhistory::time() const -> std::tuple<time_point, time_point> {
         return f->time();
       });
 #else
-  auto iter = files_.begin();
+  auto iter = files.begin();
   auto result = (*iter)->time();
   ++iter;
-  while (iter != files_.end()) {
+  while (iter != files.end()) {
     auto ft = (*iter)->time();
     result = std::make_tuple(
         std::min(std::get<0>(result), std::get<0>(ft)),
@@ -840,7 +1089,8 @@ auto dirhistory::emit(
   auto tr_begin = tr.begin();
   auto tr_end = tr.end();
 
-  auto file_set = filter_files_(*files_, tr_begin, tr_end);
+  const auto files = files_snapshot_();
+  auto file_set = filter_files_(files, tr_begin, tr_end);
   return interpolation_based_emit(
       merge_emit(
           file_set.begin(),
@@ -859,7 +1109,8 @@ auto dirhistory::emit_time(
   auto tr_begin = tr.begin();
   auto tr_end = tr.end();
 
-  auto file_set = filter_files_(*files_, tr_begin, tr_end);
+  const auto files = files_snapshot_();
+  auto file_set = filter_files_(files, tr_begin, tr_end);
   return merge_emit(
       file_set.begin(),
       file_set.end(),
@@ -870,14 +1121,21 @@ auto dirhistory::emit_time(
       });
 }
 
+auto dirhistory::background_syncs() const noexcept -> std::uint64_t {
+  return background_syncs_.load();
+}
+
 void dirhistory::maybe_start_new_file_(time_point tp) {
   using std::to_string;
 
   if (!writable_) throw std::runtime_error("history is not writable");
 
+  if (write_file_ != nullptr && should_rotate_(tp))
+    set_write_file_(nullptr);
+
   if (write_file_ == nullptr) {
     auto fname = dir_ / decide_fname_(tp);
-    io::fd new_file = io::fd::create(fname.native());
+    io::fd new_file;
     try {
       new_file = io::fd::create(fname.native());
     } catch (...) {
@@ -894,14 +1152,192 @@ void dirhistory::maybe_start_new_file_(time_point tp) {
     if (!new_file.is_open())
       throw std::runtime_error("unable to create file");
     try {
-      auto new_file_ptr = v2::tsdata_v2::new_list_file(std::move(new_file), tp); // write mime header
+      auto new_file_ptr = v2::tsdata_v2::new_list_file( // write mime header
+          std::move(new_file), tp,
+          opts_.compression.value_or(tsdata::compression_type::GZIP));
       files_->push_back(new_file_ptr);
-      write_file_ = new_file_ptr; // Fill in write_file_ pointer
+      set_write_file_(new_file_ptr); // Fill in write_file_ pointer
     } catch (...) {
       new_file.unlink();
       throw;
     }
+
+    // The previous write file, if any, is now eligible for compaction.
+    compactor_cv_.notify_all();
+  }
+}
+
+auto dirhistory::should_rotate_(time_point tp) -> bool {
+  assert(write_file_ != nullptr);
+
+  if (opts_.rotate_interval.has_value()) {
+    const time_point file_begin = std::get<0>(write_file_->time());
+    if (interval_index_(tp, *opts_.rotate_interval)
+        != interval_index_(file_begin, *opts_.rotate_interval))
+      return true;
+  }
+
+  if (opts_.max_file_records.has_value()
+      && write_file_records_ >= *opts_.max_file_records)
+    return true;
+
+  if (opts_.max_file_size.has_value()
+      && write_file_size_.has_value()
+      && *write_file_size_ >= *opts_.max_file_size)
+    return true;
+
+  return false;
+}
+
+void dirhistory::compactor_run_() {
+  std::unique_lock<std::mutex> lck{ mtx_ };
+  while (!compactor_stop_) {
+    if (opts_.retention.has_value()) {
+      lck.unlock();
+      expire_files_();
+      lck.lock();
+      if (compactor_stop_) break;
+    }
+
+    const std::shared_ptr<tsdata> candidate = compaction_candidate_();
+    if (candidate == nullptr) {
+      if (opts_.retention.has_value())
+        compactor_cv_.wait_for(lck, expire_check_interval);
+      else
+        compactor_cv_.wait(lck);
+      continue;
+    }
+
+    lck.unlock();
+    bool failed = false;
+    try {
+      compact_(candidate);
+    } catch (...) {
+      failed = true;
+    }
+    lck.lock();
+
+    if (failed) {
+      if (!compactor_stop_) {
+        static instrumentation::counter stat("monsoon.dirhistory.compaction", { {"result", "failure"} });
+        ++stat;
+      }
+      compaction_failed_.push_back(candidate);
+    }
+  }
+}
+
+auto dirhistory::compaction_candidate_() const
+-> std::shared_ptr<tsdata> {
+  const auto iter = std::find_if(
+      files_->begin(), files_->end(),
+      [this](const std::shared_ptr<tsdata>& f) {
+        return f != write_file_
+            && f->is_writable()
+            && dynamic_cast<const v2::tsdata_v2_list*>(f.get()) != nullptr
+            && f->get_path().has_value()
+            && std::find(compaction_failed_.begin(), compaction_failed_.end(), f) == compaction_failed_.end();
+      });
+  return (iter == files_->end() ? nullptr : *iter);
+}
+
+void dirhistory::compact_(const std::shared_ptr<tsdata>& src) {
+  const filesystem::path src_path = src->get_path().value();
+  filesystem::path tmp_path = src_path;
+  tmp_path += compact_tmp_extension;
+
+  try {
+    // Rewrite from time series, since emitted data can't represent groups
+    // without metrics.
+    // The source is a closed list file, so its size is bounded by rotation.
+    const std::vector<time_series> data = src->read_all();
+    if (compactor_stop_) throw std::runtime_error("compaction cancelled");
+
+    // Tables file is fully written, before it becomes visible.
+    tsdata::new_tables_file(
+        io::fd::create(tmp_path.native()),
+        data,
+        opts_.compaction_compression.value_or(
+            opts_.compression.value_or(tsdata::compression_type::GZIP)));
+    // Atomically replace the list file on disk.
+    filesystem::rename(tmp_path, src_path);
+  } catch (...) {
+    remove_noexcept_(tmp_path);
+    throw;
+  }
+
+  std::shared_ptr<tsdata> replacement =
+      tsdata::open(src_path.native(), io::fd::READ_ONLY);
+
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  const auto iter = std::find(files_->begin(), files_->end(), src);
+  if (iter == files_->end()) {
+    // Source expired during compaction; don't resurrect it.
+    remove_noexcept_(src_path);
+    return;
   }
+  *iter = replacement;
+
+  static instrumentation::counter stat("monsoon.dirhistory.compaction", { {"result", "success"} });
+  ++stat;
+}
+
+void dirhistory::expire_files_() {
+  const time_point cutoff = time_point::now() - opts_.retention.value();
+
+  std::vector<std::shared_ptr<tsdata>> expired;
+  {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    std::copy_if(
+        files_->begin(), files_->end(),
+        std::back_inserter(expired),
+        [this, &cutoff](const std::shared_ptr<tsdata>& f) {
+          return f != write_file_ && std::get<1>(f->time()) < cutoff;
+        });
+  }
+
+  // Readers holding on to an expired file can still use it,
+  // since they keep the file descriptor open.
+  // Files that fail to be removed stay in files_, so the next pass retries them.
+  std::vector<std::shared_ptr<tsdata>> removed;
+  for (const auto& f : expired) {
+    const auto path = f->get_path();
+    if (!path.has_value()) {
+      removed.push_back(f);
+      continue;
+    }
+
+    bool failed = false;
+    try {
+      if (opts_.archive_dir.has_value())
+        filesystem::rename(*path, *opts_.archive_dir / filesystem::path(*path).filename());
+      else
+        filesystem::remove(*path);
+    } catch (...) {
+      failed = true;
+    }
+
+    if (failed) {
+      static instrumentation::counter stat("monsoon.dirhistory.expire", { {"result", "failure"} });
+      ++stat;
+    } else {
+      static instrumentation::counter stat("monsoon.dirhistory.expire", { {"result", "success"} });
+      ++stat;
+      removed.push_back(f);
+    }
+  }
+
+  const auto is_removed =
+      [&removed](const std::shared_ptr<tsdata>& f) {
+        return std::find(removed.begin(), removed.end(), f) != removed.end();
+      };
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  files_->erase(
+      std::remove_if(files_->begin(), files_->end(), is_removed),
+      files_->end());
+  compaction_failed_.erase(
+      std::remove_if(compaction_failed_.begin(), compaction_failed_.end(), is_removed),
+      compaction_failed_.end());
 }
 
 auto dirhistory::decide_fname_(time_point tp) -> filesystem::path {
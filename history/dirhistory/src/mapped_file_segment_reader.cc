@@ -0,0 +1,81 @@
+#include "mapped_file_segment_reader.h"
+#include <monsoon/history/dir/hdir_exception.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <boost/endian/conversion.hpp>
+
+namespace monsoon {
+namespace history {
+
+
+mapped_file_segment_reader::mapped_file_segment_reader(
+    const io::mmap_view& map,
+    io::fd::offset_type offset, io::fd::size_type length)
+: data_(map.data() + offset),
+  len_(length)
+{
+  assert(fits(map, offset, length));
+}
+
+mapped_file_segment_reader::mapped_file_segment_reader(
+    std::vector<std::uint8_t>&& segment, io::fd::size_type length)
+: owned_(std::move(segment)),
+  data_(owned_.data()),
+  len_(length)
+{
+  if (owned_.size() < padded_size_(length) + 4u)
+    throw std::invalid_argument("segment buffer too short");
+}
+
+mapped_file_segment_reader::~mapped_file_segment_reader() noexcept {}
+
+bool mapped_file_segment_reader::fits(const io::mmap_view& map,
+    io::fd::offset_type offset, io::fd::size_type length) noexcept {
+  return offset <= map.size()
+      && padded_size_(length) + 4u <= map.size() - offset;
+}
+
+std::size_t mapped_file_segment_reader::read(void* buf, std::size_t len) {
+  const auto [span, span_len] = read_span(len);
+  std::memcpy(buf, span, span_len);
+  return span_len;
+}
+
+auto mapped_file_segment_reader::read_span(std::size_t len)
+-> std::tuple<const void*, std::size_t> {
+  if (len > len_ - off_) len = len_ - off_;
+  const std::uint8_t* span = data_ + off_;
+  crc32_.process_bytes(span, len);
+  off_ += len;
+  return { span, len };
+}
+
+void mapped_file_segment_reader::close() {
+  if (off_ != len_)
+    throw dirhistory_exception("mapped_file_segment_reader data remaining");
+
+  const io::fd::size_type padded_len = padded_size_(len_);
+  if (std::any_of(data_ + len_, data_ + padded_len, [](std::uint8_t byte) { return byte != 0u; }))
+    throw dirhistory_exception("mapped_file_segment_reader non-zero bytes in padding");
+  crc32_.process_bytes(data_ + len_, padded_len - len_);
+
+  std::uint32_t expected_crc32;
+  std::memcpy(&expected_crc32, data_ + padded_len, sizeof(expected_crc32)); // memcpy is blessed not to cause type punning issues.
+  if (boost::endian::big_to_native(expected_crc32) != crc32_.checksum())
+    throw dirhistory_exception("mapped_file_segment_reader CRC mismatch");
+}
+
+bool mapped_file_segment_reader::at_end() const {
+  return off_ == len_;
+}
+
+auto mapped_file_segment_reader::padded_size_(io::fd::size_type len) noexcept
+-> io::fd::size_type {
+  return (len + 3u) / 4u * 4u;
+}
+
+
+}} /* namespace monsoon::history */
@@ -0,0 +1,56 @@
+#ifndef MAPPED_FILE_SEGMENT_READER_H
+#define MAPPED_FILE_SEGMENT_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <monsoon/io/crc32.h>
+#include <monsoon/io/fd.h>
+#include <monsoon/io/mmap_view.h>
+#include <monsoon/io/stream.h>
+#include <monsoon/history/dir/dirhistory_export_.h>
+
+namespace monsoon {
+namespace history {
+
+
+/**
+ * File segment reader, reading from a memory mapped file,
+ * or from a copy of the segment that was read ahead.
+ *
+ * Performs the same validation as raw_file_segment_reader,
+ * but hands out the segment data directly from memory.
+ *
+ * When reading from a mapping, the segment reader uses a reference
+ * to the mapping and thus is only valid as long as the mapping is valid.
+ */
+class monsoon_dirhistory_local_ mapped_file_segment_reader
+: public io::stream_reader
+{
+ public:
+  mapped_file_segment_reader(const io::mmap_view&, io::fd::offset_type, io::fd::size_type);
+  ///\brief Read from a segment of the given length, followed by its padding and CRC.
+  mapped_file_segment_reader(std::vector<std::uint8_t>&&, io::fd::size_type);
+  ~mapped_file_segment_reader() noexcept override;
+
+  ///\brief Test if the segment, including its padding and CRC, lies in the mapping.
+  static bool fits(const io::mmap_view&, io::fd::offset_type, io::fd::size_type) noexcept;
+
+  std::size_t read(void* buf, std::size_t len) override;
+  auto read_span(std::size_t len) -> std::tuple<const void*, std::size_t> override;
+  void close() override;
+  bool at_end() const override;
+
+ private:
+  static auto padded_size_(io::fd::size_type) noexcept -> io::fd::size_type;
+
+  std::vector<std::uint8_t> owned_; // Empty when reading from a mapping.
+  const std::uint8_t* data_;
+  io::fd::size_type off_ = 0, len_;
+  io::crc32 crc32_;
+};
+
+
+}} /* namespace monsoon::history */
+
+#endif /* MAPPED_FILE_SEGMENT_READER_H */
@@ -3,10 +3,10 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <monsoon/io/crc32.h>
 #include <monsoon/io/fd.h>
 #include <monsoon/io/positional_stream.h>
 #include <monsoon/history/dir/dirhistory_export_.h>
-#include <boost/crc.hpp>
 
 namespace monsoon {
 namespace history {
@@ -41,7 +41,7 @@ class monsoon_dirhistory_local_ raw_file_segment_reader
   std::uint32_t read_expected_crc32_();
 
   io::fd::size_type avail_, pad_len_ = 0;
-  boost::crc_32_type crc32_;
+  io::crc32 crc32_;
 };
 
 
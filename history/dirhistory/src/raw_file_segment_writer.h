@@ -2,10 +2,10 @@
 #define RAW_FILE_SEGMENT_WRITER_H
 
 #include <cstddef>
+#include <monsoon/io/crc32.h>
 #include <monsoon/io/fd.h>
 #include <monsoon/io/positional_stream.h>
 #include <monsoon/history/dir/dirhistory_export_.h>
-#include <boost/crc.hpp>
 
 namespace monsoon {
 namespace history {
@@ -30,7 +30,7 @@ class monsoon_dirhistory_local_ raw_file_segment_writer
   std::size_t write_crc_();
 
   io::fd::size_type wlen_ = 0;
-  boost::crc_32_type crc32_;
+  io::crc32 crc32_;
   io::fd::size_type *out_data_len_ = nullptr;
   io::fd::size_type *out_storage_len_ = nullptr;
 };
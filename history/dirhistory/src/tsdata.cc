@@ -37,6 +37,14 @@ std::optional<tsfile_mimeheader> get_mimeheader_from_plain(const io::fd& fd) {
 
 tsdata::~tsdata() noexcept {}
 
+void tsdata::set_sync_on_push_back([[maybe_unused]] bool enable) {}
+
+void tsdata::sync([[maybe_unused]] bool durable) {}
+
+auto tsdata::file_size() const -> std::optional<std::uintmax_t> {
+  return {};
+}
+
 auto tsdata::open(const std::string& fname, io::fd::open_mode mode)
 -> std::shared_ptr<tsdata> {
   return open(io::fd(fname, mode));
@@ -93,6 +101,25 @@ auto tsdata::new_file(io::fd&& fd) -> std::shared_ptr<tsdata> {
   return new_file(std::move(fd), v2::tsdata_v2::MAJOR);
 }
 
+auto tsdata::new_tables_file(io::fd&& fd, objpipe::reader<emit_type> data,
+    compression_type compression)
+-> std::shared_ptr<tsdata> {
+  return v2::tsdata_v2::new_tables_file(std::move(fd), std::move(data),
+      compression);
+}
+
+auto tsdata::new_tables_file(io::fd&& fd, objpipe::reader<emit_type> data)
+-> std::shared_ptr<tsdata> {
+  return new_tables_file(std::move(fd), std::move(data),
+      compression_type::GZIP);
+}
+
+auto tsdata::new_tables_file(io::fd&& fd, const std::vector<time_series>& data,
+    compression_type compression)
+-> std::shared_ptr<tsdata> {
+  return v2::tsdata_v2::new_tables_file(std::move(fd), data, compression);
+}
+
 auto tsdata::make_time_series(const metric_source::metric_emit& c) -> time_series {
   std::unordered_map<group_name, time_series_value> tsv_map;
   const time_point tp = std::get<0>(c);
@@ -103,6 +103,10 @@ std::optional<std::string> tsdata_v0::get_path() const {
   return file_.get_path();
 }
 
+auto tsdata_v0::file_size() const -> std::optional<std::uintmax_t> {
+  return file_.size();
+}
+
 void tsdata_v0::push_back(const time_series& ts) {
   if (gzipped_) throw std::runtime_error("not writable");
 
@@ -45,6 +45,7 @@ class monsoon_dirhistory_local_ tsdata_v0
   void push_back(const time_series&);
   void push_back(const emit_type&) override;
   std::optional<std::string> get_path() const override;
+  auto file_size() const -> std::optional<std::uintmax_t> override;
   auto time() const -> std::tuple<time_point, time_point> override;
 
   static std::shared_ptr<tsdata_v0> new_file(io::fd&&, time_point tp);
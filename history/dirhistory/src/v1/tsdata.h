@@ -76,6 +76,7 @@ class monsoon_dirhistory_local_ tsdata_v1
       override;
   bool is_writable() const noexcept override;
   std::optional<std::string> get_path() const override;
+  auto file_size() const -> std::optional<std::uintmax_t> override;
   void push_back(const time_series&);
   void push_back(const emit_type&) override;
   auto time() const -> std::tuple<time_point, time_point> override;
@@ -0,0 +1,92 @@
+#ifndef MONSOON_HISTORY_V2_BITSET_INL_H
+#define MONSOON_HISTORY_V2_BITSET_INL_H
+
+namespace monsoon::history::v2 {
+
+
+///\brief Index of the lowest set bit of \p w.
+///\note \p w may not be zero.
+inline auto packed_bitset_ctz_(std::uint64_t w) noexcept -> unsigned int {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned int>(__builtin_ctzll(w));
+#else
+  unsigned int n = 0;
+  while ((w & 1u) == 0u) {
+    w >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+
+inline auto packed_bitset::test(size_type i) const noexcept -> bool {
+  return (words_[i / word_bits] >> (i % word_bits)) & 1u;
+}
+
+inline void packed_bitset::push_back(bool b) {
+  if (size_ % word_bits == 0u) words_.push_back(0u);
+  if (b) words_.back() |= word_type(1) << (size_ % word_bits);
+  ++size_;
+}
+
+inline auto packed_bitset::begin_set() const noexcept -> set_bit_iterator {
+  return set_bit_iterator(words_.data(), 0, words_.size());
+}
+
+inline auto packed_bitset::end_set() const noexcept -> set_bit_iterator {
+  return set_bit_iterator(words_.data(), words_.size(), words_.size());
+}
+
+
+inline packed_bitset::set_bit_iterator::set_bit_iterator(
+    const word_type* words, size_type word_idx, size_type word_count) noexcept
+: words_(words),
+  word_idx_(word_idx),
+  word_count_(word_count),
+  current_(word_idx < word_count ? words[word_idx] : 0u)
+{
+  skip_empty_();
+}
+
+inline auto packed_bitset::set_bit_iterator::operator*() const noexcept
+-> reference {
+  return word_idx_ * word_bits + packed_bitset_ctz_(current_);
+}
+
+inline auto packed_bitset::set_bit_iterator::operator++() noexcept
+-> set_bit_iterator& {
+  current_ &= current_ - 1u; // Clear lowest set bit.
+  skip_empty_();
+  return *this;
+}
+
+inline auto packed_bitset::set_bit_iterator::operator++(int) noexcept
+-> set_bit_iterator {
+  set_bit_iterator copy = *this;
+  ++*this;
+  return copy;
+}
+
+inline auto packed_bitset::set_bit_iterator::operator==(
+    const set_bit_iterator& y) const noexcept
+-> bool {
+  return word_idx_ == y.word_idx_ && current_ == y.current_;
+}
+
+inline auto packed_bitset::set_bit_iterator::operator!=(
+    const set_bit_iterator& y) const noexcept
+-> bool {
+  return !(*this == y);
+}
+
+inline void packed_bitset::set_bit_iterator::skip_empty_() noexcept {
+  while (current_ == 0u && word_idx_ < word_count_) {
+    if (++word_idx_ < word_count_) current_ = words_[word_idx_];
+  }
+}
+
+
+} /* namespace monsoon::history::v2 */
+
+#endif /* MONSOON_HISTORY_V2_BITSET_INL_H */
@@ -1,20 +1,44 @@
 #include "bitset.h"
+#include "xdr_primitives.h"
+#include <algorithm>
+#include <numeric>
 
 namespace monsoon::history::v2 {
+namespace {
+
+
+///\brief Number of set bits in \p w.
+auto popcount_(std::uint64_t w) noexcept -> unsigned int {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned int>(__builtin_popcountll(w));
+#else
+  unsigned int n = 0;
+  for (; w != 0u; w &= w - 1u) ++n;
+  return n;
+#endif
+}
+
+///\brief Read the run lengths of an encoded bitset.
+auto decode_runs_(xdr::xdr_istream& in) -> std::vector<std::uint16_t> {
+  std::vector<std::uint16_t> runs;
+  in.get_array_collection(runs);
+  return runs;
+}
+
+
+} /* namespace monsoon::history::v2::<unnamed> */
 
 
 void bitset::decode(xdr::xdr_istream& in) {
-  clear();
+  const std::vector<std::uint16_t> runs = decode_runs_(in);
 
+  clear();
+  reserve(std::accumulate(runs.begin(), runs.end(), size_type(0)));
   bool current = true;
-  in.accept_collection(
-      [](xdr::xdr_istream& in) {
-        return in.get_uint16();
-      },
-      [this, &current](std::uint16_t count) {
-        std::fill_n(std::back_inserter(*this), count, current);
-        current = !current;
-      });
+  for (const std::uint16_t count : runs) {
+    insert(end(), count, current);
+    current = !current;
+  }
 }
 
 void bitset::encode(xdr::xdr_ostream& out) const {
@@ -46,4 +70,98 @@ void bitset::encode(xdr::xdr_ostream& out) const {
 }
 
 
+auto packed_bitset::count() const noexcept -> size_type {
+  size_type n = 0;
+  for (const word_type w : words_) n += popcount_(w);
+  return n;
+}
+
+void packed_bitset::clear() noexcept {
+  words_.clear();
+  size_ = 0;
+}
+
+void packed_bitset::append(size_type n, bool b) {
+  const size_type new_size = size_ + n;
+  words_.resize((new_size + word_bits - 1u) / word_bits, word_type(0));
+
+  if (b) {
+    size_type i = size_;
+    // Leading partial word.
+    if (i % word_bits != 0u && i != new_size) {
+      const size_type off = i % word_bits;
+      const size_type len = std::min(new_size - i, word_bits - off);
+      const word_type mask = (len == word_bits - off
+          ? ~word_type(0)
+          : (word_type(1) << len) - 1u);
+      words_[i / word_bits] |= mask << off;
+      i += len;
+    }
+    // Whole words.
+    for (; new_size - i >= word_bits; i += word_bits)
+      words_[i / word_bits] = ~word_type(0);
+    // Trailing partial word.
+    if (i != new_size)
+      words_[i / word_bits] |= (word_type(1) << (new_size - i)) - 1u;
+  }
+
+  size_ = new_size;
+}
+
+auto packed_bitset::find_(size_type pos, bool b) const noexcept -> size_type {
+  if (pos >= size_) return size_;
+
+  size_type word_idx = pos / word_bits;
+  word_type w = (b ? words_[word_idx] : ~words_[word_idx])
+      & (~word_type(0) << (pos % word_bits));
+  while (w == 0u) {
+    if (++word_idx == words_.size()) return size_;
+    w = (b ? words_[word_idx] : ~words_[word_idx]);
+  }
+  return std::min(size_, word_idx * word_bits + packed_bitset_ctz_(w));
+}
+
+void packed_bitset::decode(xdr::xdr_istream& in) {
+  const std::vector<std::uint16_t> runs = decode_runs_(in);
+
+  clear();
+  words_.reserve(
+      (std::accumulate(runs.begin(), runs.end(), size_type(0)) + word_bits - 1u)
+      / word_bits);
+  bool current = true;
+  for (const std::uint16_t count : runs) {
+    append(count, current);
+    current = !current;
+  }
+}
+
+void packed_bitset::encode(xdr::xdr_ostream& out) const {
+  std::vector<std::uint16_t> counters;
+
+  bool current = true;
+
+  size_type bit_idx = 0;
+  while (bit_idx != size_) {
+    const size_type end = find_(bit_idx, !current);
+    auto count = end - bit_idx;
+
+    while (count > 0x7fff) {
+      counters.push_back(0x7fff);
+      counters.push_back(0);
+      count -= 0x7fff;
+    }
+    counters.push_back(count);
+
+    current = !current;
+    bit_idx = end;
+  }
+
+  out.put_collection(
+      [](xdr::xdr_ostream& out, std::uint16_t v) {
+        out.put_uint16(v);
+      },
+      counters.cbegin(), counters.cend());
+}
+
+
 } /* namespace monsoon::history::v2 */
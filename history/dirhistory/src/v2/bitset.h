@@ -2,6 +2,9 @@
 #define MONSOON_HISTORY_V2_BITSET_H
 
 #include <monsoon/history/dir/dirhistory_export_.h>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 #include <monsoon/xdr/xdr.h>
 
@@ -19,7 +22,73 @@ class monsoon_dirhistory_local_ bitset
   void encode(xdr::xdr_ostream& out) const;
 };
 
+///\brief Bitset stored as 64-bit words.
+///\details Uses the same encoding as bitset, but is able to
+///skip over unset bits a word at a time.
+class monsoon_dirhistory_local_ packed_bitset {
+ public:
+  using word_type = std::uint64_t;
+  using size_type = std::size_t;
+  class set_bit_iterator;
+
+  static constexpr size_type word_bits = 64;
+
+  auto size() const noexcept -> size_type { return size_; }
+  auto empty() const noexcept -> bool { return size_ == 0u; }
+  auto test(size_type i) const noexcept -> bool;
+  ///\brief Number of set bits.
+  auto count() const noexcept -> size_type;
+
+  void clear() noexcept;
+  void push_back(bool b);
+  ///\brief Append \p n copies of \p b.
+  void append(size_type n, bool b);
+
+  ///\brief Iterate over the indices of the set bits.
+  auto begin_set() const noexcept -> set_bit_iterator;
+  auto end_set() const noexcept -> set_bit_iterator;
+
+  void decode(xdr::xdr_istream& in);
+  void encode(xdr::xdr_ostream& out) const;
+
+ private:
+  ///\brief Find the first index at or after \p pos, with value \p b.
+  ///\returns The index, or size() if there is none.
+  auto find_(size_type pos, bool b) const noexcept -> size_type;
+
+  // Bits at or beyond size_ are always zero.
+  std::vector<word_type> words_;
+  size_type size_ = 0;
+};
+
+class monsoon_dirhistory_local_ packed_bitset::set_bit_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = size_type;
+  using reference = value_type;
+  using pointer = void;
+  using difference_type = std::ptrdiff_t;
+
+  set_bit_iterator() = default;
+  set_bit_iterator(const word_type* words, size_type word_idx, size_type word_count) noexcept;
+
+  auto operator*() const noexcept -> reference;
+  auto operator++() noexcept -> set_bit_iterator&;
+  auto operator++(int) noexcept -> set_bit_iterator;
+  auto operator==(const set_bit_iterator& y) const noexcept -> bool;
+  auto operator!=(const set_bit_iterator& y) const noexcept -> bool;
+
+ private:
+  void skip_empty_() noexcept;
+
+  const word_type* words_ = nullptr;
+  size_type word_idx_ = 0, word_count_ = 0;
+  word_type current_ = 0; // Unvisited bits of words_[word_idx_].
+};
+
 
 } /* namespace monsoon::history::v2 */
 
+#include "bitset-inl.h"
+
 #endif /* MONSOON_HISTORY_V2_BITSET_H */
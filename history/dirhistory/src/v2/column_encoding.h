@@ -0,0 +1,353 @@
+#ifndef V2_COLUMN_ENCODING_H
+#define V2_COLUMN_ENCODING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <monsoon/xdr/xdr.h>
+
+namespace monsoon::history::v2 {
+
+
+template<typename T> struct serialization_fn;
+
+template<>
+struct serialization_fn<std::int16_t> {
+  static auto decode(xdr::xdr_istream& in) -> std::int16_t {
+    return in.get_int16();
+  }
+
+  static auto encode(xdr::xdr_ostream& out, std::int16_t v) -> void {
+    out.put_int16(v);
+  }
+};
+
+template<>
+struct serialization_fn<std::int32_t> {
+  static auto decode(xdr::xdr_istream& in) -> std::int32_t {
+    return in.get_int32();
+  }
+
+  static auto encode(xdr::xdr_ostream& out, std::int32_t v) -> void {
+    out.put_int32(v);
+  }
+};
+
+template<>
+struct serialization_fn<std::int64_t> {
+  static auto decode(xdr::xdr_istream& in) -> std::int64_t {
+    return in.get_int64();
+  }
+
+  static auto encode(xdr::xdr_ostream& out, std::int64_t v) -> void {
+    out.put_int64(v);
+  }
+};
+
+template<>
+struct serialization_fn<double> {
+  static auto decode(xdr::xdr_istream& in) -> double {
+    return in.get_flt64();
+  }
+
+  static auto encode(xdr::xdr_ostream& out, double v) -> void {
+    out.put_flt64(v);
+  }
+};
+
+
+/**
+ * \brief Encoding of an integer or floating point metric table section.
+ * \details
+ * Sections are prefixed with their encoding, starting at minor version
+ * \ref tsdata_v2::MINOR_COLUMN_ENCODINGS.
+ * Older files only contain the raw encoding, without prefix.
+ */
+enum class column_encoding : std::uint32_t {
+  RAW = 0, ///<\brief XDR collection of values.
+  RLE = 1, ///<\brief XDR collection of (value, run length) pairs.
+  DELTA_DELTA = 2, ///<\brief Zigzag varints of the delta-of-delta (integers only).
+  XOR = 3 ///<\brief Byte packed XOR with the previous value (floating point only).
+};
+
+namespace detail {
+
+
+inline auto zigzag_(std::int64_t v) noexcept -> std::uint64_t {
+  return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline auto unzigzag_(std::uint64_t v) noexcept -> std::int64_t {
+  return static_cast<std::int64_t>((v >> 1) ^ (~(v & 1u) + 1u));
+}
+
+inline void put_varint_(std::vector<std::uint8_t>& out, std::uint64_t v) {
+  while (v >= 0x80u) {
+    out.push_back(static_cast<std::uint8_t>(v | 0x80u));
+    v >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(v));
+}
+
+inline auto get_varint_(const std::vector<std::uint8_t>& in, std::size_t& off)
+-> std::uint64_t {
+  std::uint64_t v = 0;
+  for (unsigned int shift = 0; shift < 64u; shift += 7u) {
+    if (off == in.size()) throw xdr::xdr_exception("truncated varint");
+    const std::uint8_t b = in[off++];
+    v |= std::uint64_t(b & 0x7fu) << shift;
+    if ((b & 0x80u) == 0u) return v;
+  }
+  throw xdr::xdr_exception("varint too long");
+}
+
+inline auto double_bits_(double v) noexcept -> std::uint64_t {
+  static_assert(sizeof(double) == sizeof(std::uint64_t));
+  std::uint64_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+inline auto bits_double_(std::uint64_t bits) noexcept -> double {
+  double v;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+///\brief Value equality for run length encoding; compares doubles bitwise.
+template<typename T>
+auto same_value_(const T& x, const T& y) noexcept -> bool {
+  if constexpr(std::is_floating_point_v<T>)
+    return double_bits_(x) == double_bits_(y);
+  else
+    return x == y;
+}
+
+template<typename T>
+void encode_rle_(xdr::xdr_ostream& out, const std::vector<T>& values) {
+  std::vector<std::tuple<T, std::uint32_t>> runs;
+  for (const T& v : values) {
+    if (!runs.empty() && same_value_(std::get<0>(runs.back()), v))
+      ++std::get<1>(runs.back());
+    else
+      runs.emplace_back(v, 1u);
+  }
+
+  out.put_collection(
+      [](xdr::xdr_ostream& out, const std::tuple<T, std::uint32_t>& run) {
+        serialization_fn<T>::encode(out, std::get<0>(run));
+        out.put_uint32(std::get<1>(run));
+      },
+      runs.begin(), runs.end());
+}
+
+template<typename T>
+void decode_rle_(xdr::xdr_istream& in, std::vector<T>& values) {
+  const auto runs = in.get_collection(
+      [](xdr::xdr_istream& in) {
+        const T v = serialization_fn<T>::decode(in);
+        return std::make_tuple(v, in.get_uint32());
+      },
+      std::vector<std::tuple<T, std::uint32_t>>());
+
+  for (const auto& run : runs)
+    values.insert(values.end(), std::get<1>(run), std::get<0>(run));
+}
+
+template<typename T>
+void encode_delta_delta_(xdr::xdr_ostream& out, const std::vector<T>& values) {
+  static_assert(std::is_integral_v<T>);
+
+  // Arithmetic is done modulo 2^64, so overflow wraps predictably.
+  std::vector<std::uint8_t> bytes;
+  std::uint64_t prev = 0, prev_delta = 0;
+  for (typename std::vector<T>::size_type i = 0; i < values.size(); ++i) {
+    const auto cur = static_cast<std::uint64_t>(static_cast<std::int64_t>(values[i]));
+    const std::uint64_t delta = cur - prev;
+    const std::uint64_t enc = (i < 2 ? delta : delta - prev_delta);
+    put_varint_(bytes, zigzag_(static_cast<std::int64_t>(enc)));
+    prev = cur;
+    prev_delta = delta;
+  }
+
+  out.put_uint32(static_cast<std::uint32_t>(values.size()));
+  out.put_opaque(bytes);
+}
+
+template<typename T>
+void decode_delta_delta_(xdr::xdr_istream& in, std::vector<T>& values) {
+  static_assert(std::is_integral_v<T>);
+
+  const std::uint32_t count = in.get_uint32();
+  const std::vector<std::uint8_t> bytes = in.get_opaque();
+  values.reserve(values.size() + count);
+
+  std::size_t off = 0;
+  std::uint64_t prev = 0, prev_delta = 0;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    const auto enc = static_cast<std::uint64_t>(unzigzag_(get_varint_(bytes, off)));
+    const std::uint64_t delta = (i < 2 ? enc : prev_delta + enc);
+    const std::uint64_t cur = prev + delta;
+    values.push_back(static_cast<T>(static_cast<std::int64_t>(cur)));
+    prev = cur;
+    prev_delta = delta;
+  }
+  if (off != bytes.size()) throw xdr::xdr_exception("xdr data remaining");
+}
+
+inline void encode_xor_(xdr::xdr_ostream& out, const std::vector<double>& values) {
+  // Each value is a header byte, followed by the non-zero bytes of the XOR.
+  // Header 0 means: same as previous value.
+  // Otherwise, the header is 0x40 | (leading zero bytes << 3) | trailing zero bytes.
+  std::vector<std::uint8_t> bytes;
+  std::uint64_t prev = 0;
+  for (const double v : values) {
+    const std::uint64_t cur = double_bits_(v);
+    const std::uint64_t x = cur ^ prev;
+    prev = cur;
+
+    if (x == 0u) {
+      bytes.push_back(0u);
+      continue;
+    }
+
+    unsigned int lead = 0, trail = 0;
+    while (((x >> (56u - 8u * lead)) & 0xffu) == 0u) ++lead;
+    while (((x >> (8u * trail)) & 0xffu) == 0u) ++trail;
+
+    bytes.push_back(static_cast<std::uint8_t>(0x40u | (lead << 3) | trail));
+    for (unsigned int i = 8u - lead; i-- > trail; )
+      bytes.push_back(static_cast<std::uint8_t>(x >> (8u * i)));
+  }
+
+  out.put_uint32(static_cast<std::uint32_t>(values.size()));
+  out.put_opaque(bytes);
+}
+
+inline void decode_xor_(xdr::xdr_istream& in, std::vector<double>& values) {
+  const std::uint32_t count = in.get_uint32();
+  const std::vector<std::uint8_t> bytes = in.get_opaque();
+  values.reserve(values.size() + count);
+
+  std::size_t off = 0;
+  std::uint64_t prev = 0;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    if (off == bytes.size()) throw xdr::xdr_exception("truncated xor column");
+    const std::uint8_t hdr = bytes[off++];
+
+    std::uint64_t x = 0;
+    if (hdr != 0u) {
+      const unsigned int lead = (hdr >> 3) & 0x7u;
+      const unsigned int trail = hdr & 0x7u;
+      if ((hdr & 0xc0u) != 0x40u || lead + trail >= 8u)
+        throw xdr::xdr_exception("invalid xor column header");
+      if (bytes.size() - off < 8u - lead - trail)
+        throw xdr::xdr_exception("truncated xor column");
+
+      for (unsigned int i = 8u - lead; i-- > trail; )
+        x |= std::uint64_t(bytes[off++]) << (8u * i);
+    }
+
+    prev ^= x;
+    values.push_back(bits_double_(prev));
+  }
+  if (off != bytes.size()) throw xdr::xdr_exception("xdr data remaining");
+}
+
+
+} /* namespace monsoon::history::v2::detail */
+
+///\brief Encode the values using the given encoding.
+///\throws xdr::xdr_exception if the encoding does not apply to \p T.
+template<typename T>
+void encode_column_as(xdr::xdr_ostream& out, column_encoding enc, const std::vector<T>& values) {
+  switch (enc) {
+    case column_encoding::RAW:
+      out.put_collection(&serialization_fn<T>::encode, values.cbegin(), values.cend());
+      break;
+    case column_encoding::RLE:
+      detail::encode_rle_(out, values);
+      break;
+    case column_encoding::DELTA_DELTA:
+      if constexpr(std::is_integral_v<T>)
+        detail::encode_delta_delta_(out, values);
+      else
+        throw xdr::xdr_exception("column encoding not applicable");
+      break;
+    case column_encoding::XOR:
+      if constexpr(std::is_floating_point_v<T>)
+        detail::encode_xor_(out, values);
+      else
+        throw xdr::xdr_exception("column encoding not applicable");
+      break;
+  }
+}
+
+///\brief Encode the values, using whichever encoding yields the smallest output.
+template<typename T>
+void encode_column(xdr::xdr_ostream& out, const std::vector<T>& values) {
+  constexpr column_encoding packed = (std::is_integral_v<T>
+      ? column_encoding::DELTA_DELTA
+      : column_encoding::XOR);
+
+  column_encoding best_enc = column_encoding::RAW;
+  xdr::xdr_bytevector_ostream<> best;
+  encode_column_as(best, best_enc, values);
+
+  for (const column_encoding enc : { column_encoding::RLE, packed }) {
+    xdr::xdr_bytevector_ostream<> candidate;
+    encode_column_as(candidate, enc, values);
+    if (candidate.size() < best.size()) {
+      best_enc = enc;
+      best.as_vector().swap(candidate.as_vector());
+    }
+  }
+
+  out.put_uint32(static_cast<std::uint32_t>(best_enc));
+  best.copy_to(out);
+}
+
+///\brief Decode a collection of values, using bulk decoding where possible.
+template<typename T>
+void decode_raw_column(xdr::xdr_istream& in, std::vector<T>& values) {
+  if constexpr(std::is_arithmetic_v<T>)
+    in.get_array_collection(values);
+  else
+    in.get_collection(&serialization_fn<T>::decode, values);
+}
+
+///\brief Decode values written by encode_column(), appending them to \p values.
+template<typename T>
+void decode_column(xdr::xdr_istream& in, std::vector<T>& values) {
+  const auto enc = column_encoding(in.get_uint32());
+  switch (enc) {
+    case column_encoding::RAW:
+      decode_raw_column(in, values);
+      break;
+    case column_encoding::RLE:
+      detail::decode_rle_(in, values);
+      break;
+    case column_encoding::DELTA_DELTA:
+      if constexpr(std::is_integral_v<T>)
+        detail::decode_delta_delta_(in, values);
+      else
+        throw xdr::xdr_exception("column encoding not applicable");
+      break;
+    case column_encoding::XOR:
+      if constexpr(std::is_floating_point_v<T>)
+        detail::decode_xor_(in, values);
+      else
+        throw xdr::xdr_exception("column encoding not applicable");
+      break;
+    default:
+      throw xdr::xdr_exception("column encoding not recognized");
+  }
+}
+
+
+} /* namespace monsoon::history::v2 */
+
+#endif /* V2_COLUMN_ENCODING_H */
@@ -0,0 +1,101 @@
+#include "decode_pool.h"
+#include <algorithm>
+
+namespace monsoon::history::v2 {
+
+
+auto decode_pool::instance() -> decode_pool& {
+  static decode_pool impl{
+      std::max(std::thread::hardware_concurrency(), 1u) - 1u };
+  return impl;
+}
+
+decode_pool::decode_pool(unsigned int threads) {
+  workers_.reserve(threads);
+  try {
+    while (threads-- > 0u)
+      workers_.emplace_back(&decode_pool::worker_, this);
+  } catch (...) {
+    // Run with the threads that could be started.
+  }
+}
+
+decode_pool::~decode_pool() noexcept {
+  {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    stop_ = true;
+  }
+  cnd_.notify_all();
+  for (std::thread& t : workers_) t.join();
+}
+
+void decode_pool::for_each_index(std::size_t n,
+    std::function<void(std::size_t)> fn) {
+  if (n == 0u) return;
+
+  const auto b = std::make_shared<batch>(n, std::move(fn));
+  if (n > 1u && !workers_.empty()) {
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      queue_.push_back(b);
+    }
+    if (n > 2u)
+      cnd_.notify_all();
+    else
+      cnd_.notify_one();
+  }
+
+  b->run();
+  if (n > 1u && !workers_.empty()) {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    const auto iter = std::find(queue_.begin(), queue_.end(), b);
+    if (iter != queue_.end()) queue_.erase(iter);
+  }
+
+  std::unique_lock<std::mutex> lck{ b->mtx };
+  b->done_cnd.wait(lck, [&b]() { return b->done == b->n; });
+  if (b->ex) std::rethrow_exception(b->ex);
+}
+
+void decode_pool::batch::run() noexcept {
+  std::size_t ran = 0;
+  std::exception_ptr first_ex;
+  for (std::size_t i = next++; i < n; i = next++) {
+    if (!failed.load(std::memory_order_relaxed)) {
+      try {
+        fn(i);
+      } catch (...) {
+        failed.store(true, std::memory_order_relaxed);
+        if (!first_ex) first_ex = std::current_exception();
+      }
+    }
+    ++ran;
+  }
+  if (ran == 0u) return;
+
+  std::lock_guard<std::mutex> lck{ mtx };
+  if (first_ex && !ex) ex = std::move(first_ex);
+  done += ran;
+  if (done == n) done_cnd.notify_all();
+}
+
+void decode_pool::worker_() noexcept {
+  std::unique_lock<std::mutex> lck{ mtx_ };
+  for (;;) {
+    cnd_.wait(lck, [this]() { return stop_ || !queue_.empty(); });
+    if (stop_) return;
+
+    const std::shared_ptr<batch> b = queue_.front();
+    if (b->next.load() >= b->n) { // All indices claimed.
+      queue_.pop_front();
+      continue;
+    }
+
+    lck.unlock();
+    b->run();
+    lck.lock();
+  }
+}
+
+
+} /* namespace monsoon::history::v2 */
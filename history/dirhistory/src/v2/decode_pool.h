@@ -0,0 +1,88 @@
+#ifndef V2_DECODE_POOL_H
+#define V2_DECODE_POOL_H
+
+#include <monsoon/history/dir/dirhistory_export_.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace monsoon::history::v2 {
+
+
+/**
+ * \brief Worker threads for decoding independent segments.
+ *
+ * \details
+ * Decompression and decoding of a segment does not depend on other segments,
+ * so a query that needs many segments can decode them concurrently.
+ *
+ * The calling thread participates in the work it submits,
+ * so tasks may themselves use the pool without risk of deadlock.
+ */
+class monsoon_dirhistory_local_ decode_pool {
+ public:
+  ///\brief Pool shared by all files, sized to the hardware concurrency.
+  static auto instance() -> decode_pool&;
+
+  explicit decode_pool(unsigned int threads);
+  decode_pool(const decode_pool&) = delete;
+  decode_pool& operator=(const decode_pool&) = delete;
+  ~decode_pool() noexcept;
+
+  ///\brief Number of threads that may run tasks, including the caller.
+  auto concurrency() const noexcept -> std::size_t {
+    return workers_.size() + 1u;
+  }
+
+  /**
+   * \brief Invoke \p fn(i) for each \p i in [0, n).
+   * \details
+   * Indices are started in increasing order.
+   * Returns once all invocations have completed.
+   * If any invocation throws, the remaining indices are skipped
+   * and the first exception is rethrown.
+   */
+  void for_each_index(std::size_t n, std::function<void(std::size_t)> fn);
+
+ private:
+  ///\brief Indices of a single for_each_index call.
+  struct batch {
+    batch(std::size_t n, std::function<void(std::size_t)>&& fn)
+    : n(n),
+      fn(std::move(fn))
+    {}
+
+    ///\brief Claim and run indices until none are left.
+    void run() noexcept;
+
+    const std::size_t n;
+    const std::function<void(std::size_t)> fn;
+    std::atomic<std::size_t> next{ 0u };
+    std::atomic<bool> failed{ false };
+
+    std::mutex mtx; // Protects everything below.
+    std::condition_variable done_cnd;
+    std::size_t done = 0;
+    std::exception_ptr ex;
+  };
+
+  void worker_() noexcept;
+
+  std::mutex mtx_; // Protects everything below.
+  std::condition_variable cnd_;
+  std::deque<std::shared_ptr<batch>> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+
+} /* namespace monsoon::history::v2 */
+
+#endif /* V2_DECODE_POOL_H */
@@ -1,5 +1,7 @@
 #include "dictionary.h"
 #include "xdr_primitives.h"
+#include <algorithm>
+#include <cstddef>
 #include <stdexcept>
 #include <iterator>
 
@@ -7,6 +9,10 @@ namespace monsoon::history::v2 {
 namespace {
 
 
+///\brief Maximum number of distinct matchers remembered per dictionary.
+constexpr std::size_t max_cached_filters = 64;
+
+
 // Transformation iterator that maintains the iterator category.
 template<typename Iter, typename Fn>
 class transform_iterator {
@@ -388,10 +394,9 @@ auto path_dictionary::decode_update(xdr::xdr_istream& in) -> void {
   try {
     in.get_collection(
         [](xdr::xdr_istream& in) {
-          return in.get_collection<path>(
-              [](xdr::xdr_istream& in) {
-                return in.get_uint32();
-              });
+          path p;
+          in.get_array_collection(p);
+          return p;
         },
         values_);
     if (values_.size() > 0xffffffffU)
@@ -531,10 +536,8 @@ auto tag_dictionary::decode_update(xdr::xdr_istream& in) -> void {
   try {
     in.get_collection(
         [this](xdr::xdr_istream& in) {
-          const auto keys = in.get_collection<std::vector<std::uint32_t>>(
-              [](xdr::xdr_istream& in) {
-                return in.get_uint32();
-              });
+          std::vector<std::uint32_t> keys;
+          in.get_array_collection(keys);
           auto keys_iter = keys.begin();
 
           tag_data result = in.get_collection<tag_data>(
@@ -573,7 +576,72 @@ auto tag_dictionary::make_inverse_() const
 }
 
 
+filter_bits::filter_bits(std::uint32_t size)
+: size_(size),
+  state_(std::make_unique<std::atomic<std::uint8_t>[]>(size))
+{}
+
+filter_bits::filter_bits(std::uint32_t size, const filter_bits& prev)
+: filter_bits(size)
+{
+  for (std::uint32_t i = 0, n = std::min(size, prev.size_); i < n; ++i)
+    state_[i].store(prev.state_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+
 dictionary::~dictionary() noexcept {}
 
+auto dictionary::group_filter_bits(const path_matcher& m) const
+-> std::shared_ptr<const filter_bits> {
+  const std::string key = to_string(m);
+  const std::uint32_t sz = paths_.size();
+
+  std::lock_guard<std::mutex> lck{ filters_mtx_ };
+  auto iter = group_filters_.find(key);
+  if (iter != group_filters_.end()) {
+    // Extend, if the dictionary grew.
+    if (iter->second->size() != sz)
+      iter->second = std::make_shared<const filter_bits>(sz, *iter->second);
+    return iter->second;
+  }
+
+  if (group_filters_.size() >= max_cached_filters) group_filters_.clear();
+  return group_filters_.emplace(key, std::make_shared<const filter_bits>(sz)).first->second;
+}
+
+auto dictionary::tag_filter_bits(const tag_matcher& m) const
+-> std::shared_ptr<const filter_bits> {
+  const std::string key = to_string(m);
+  const std::uint32_t sz = tags_.size();
+
+  std::lock_guard<std::mutex> lck{ filters_mtx_ };
+  auto iter = tag_filters_.find(key);
+  if (iter != tag_filters_.end()) {
+    // Extend, if the dictionary grew.
+    if (iter->second->size() != sz)
+      iter->second = std::make_shared<const filter_bits>(sz, *iter->second);
+    return iter->second;
+  }
+
+  if (tag_filters_.size() >= max_cached_filters) tag_filters_.clear();
+  return tag_filters_.emplace(key, std::make_shared<const filter_bits>(sz)).first->second;
+}
+
+auto dictionary::clear_filters_()
+-> void {
+  std::lock_guard<std::mutex> lck{ filters_mtx_ };
+  group_filters_.clear();
+  tag_filters_.clear();
+}
+
+
+group_ref_filter::group_ref_filter(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict)
+: g_(&g),
+  t_(&t),
+  dict_(std::move(dict)),
+  grp_bits_(dict_->group_filter_bits(g)),
+  tag_bits_(dict_->tag_filter_bits(t))
+{}
+
 
 } /* namespace monsoon::history::v2 */
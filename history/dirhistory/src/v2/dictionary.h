@@ -2,7 +2,11 @@
 #define V2_DICTIONARY_H
 
 #include <monsoon/history/dir/dirhistory_export_.h>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -12,6 +16,8 @@
 #include <monsoon/memoid.h>
 #include <monsoon/metric_name.h>
 #include <monsoon/metric_value.h>
+#include <monsoon/path_matcher.h>
+#include <monsoon/tag_matcher.h>
 #include <monsoon/tags.h>
 #include <monsoon/xdr/xdr.h>
 #include "../dynamics.h"
@@ -126,6 +132,12 @@ class monsoon_dirhistory_local_ path_dictionary {
     return update_start_ < values_.size();
   }
 
+  auto size() const
+  noexcept
+  -> std::uint32_t {
+    return values_.size();
+  }
+
   auto operator[](std::uint32_t idx) const -> proxy;
   auto operator[](const path_common& pc) const -> std::uint32_t;
   auto operator[](const path_common& pc) -> std::uint32_t;
@@ -193,6 +205,12 @@ class monsoon_dirhistory_local_ tag_dictionary {
     return update_start_ < values_.size();
   }
 
+  auto size() const
+  noexcept
+  -> std::uint32_t {
+    return values_.size();
+  }
+
   auto operator[](std::uint32_t idx) const -> tags;
   auto operator[](const tags& t) const -> std::uint32_t;
   auto operator[](const tags& t) -> std::uint32_t;
@@ -215,11 +233,42 @@ class monsoon_dirhistory_local_ tag_dictionary {
   std::uint32_t update_start_ = 0;
 };
 
+/**
+ * \brief Matcher results for dictionary references.
+ * \details
+ * Results are computed on first lookup, so a matcher only runs for
+ * references that are used by the filter.
+ * Lookups may happen concurrently.
+ *
+ * References added after the bitmap was created are not covered.
+ */
+class monsoon_dirhistory_local_ filter_bits {
+ public:
+  explicit filter_bits(std::uint32_t size);
+  ///\brief Create a bitmap of \p size references,
+  ///keeping the results known in \p prev.
+  filter_bits(std::uint32_t size, const filter_bits& prev);
+
+  auto size() const noexcept -> std::uint32_t { return size_; }
+
+  ///\brief Test if \p ref is accepted, using \p eval to compute the result
+  ///if it is not yet known.
+  template<typename Eval>
+  auto test(std::uint32_t ref, Eval&& eval) const -> bool;
+
+ private:
+  enum : std::uint8_t { UNKNOWN = 0, REJECTED = 1, ACCEPTED = 2 };
+
+  std::uint32_t size_;
+  std::unique_ptr<std::atomic<std::uint8_t>[]> state_;
+};
+
 class monsoon_dirhistory_local_ dictionary
 : public dynamics
 {
  public:
   using allocator_type = strval_dictionary::allocator_type;
+  using filter_bits = v2::filter_bits;
 
   static constexpr bool is_compressed = true;
 
@@ -246,6 +295,7 @@ class monsoon_dirhistory_local_ dictionary
 
   dictionary& operator=(const dictionary& y) {
     this->dynamics::operator=(y);
+    clear_filters_();
     strval_ = y.strval_;
     paths_ = y.paths_;
     tags_ = y.tags_;
@@ -254,6 +304,7 @@ class monsoon_dirhistory_local_ dictionary
 
   dictionary& operator=(dictionary&& y) {
     this->dynamics::operator=(std::move(y));
+    clear_filters_();
     strval_ = std::move(y.strval_);
     paths_ = std::move(y.paths_);
     tags_ = std::move(y.tags_);
@@ -327,17 +378,85 @@ class monsoon_dirhistory_local_ dictionary
 
   auto reset()
   -> void {
+    clear_filters_();
     strval_.reset();
     paths_.reset();
     tags_.reset();
   }
 
+  ///\brief Bitmap of path references accepted by the group matcher.
+  ///\details
+  ///The bitmap is shared by all users of this dictionary.
+  ///If the dictionary grew, known results are carried over.
+  auto group_filter_bits(const path_matcher& m) const
+  -> std::shared_ptr<const filter_bits>;
+  ///\brief Bitmap of tag references accepted by the tag matcher.
+  ///\details
+  ///The bitmap is shared by all users of this dictionary.
+  ///If the dictionary grew, known results are carried over.
+  auto tag_filter_bits(const tag_matcher& m) const
+  -> std::shared_ptr<const filter_bits>;
+
  private:
+  using filter_map = std::unordered_map<std::string, std::shared_ptr<const filter_bits>>;
+
+  auto clear_filters_() -> void;
+
   strval_dictionary strval_;
   path_dictionary paths_;
   tag_dictionary tags_;
+
+  mutable std::mutex filters_mtx_; // Protects group_filters_ and tag_filters_.
+  mutable filter_map group_filters_, tag_filters_;
+};
+
+
+/**
+ * \brief Group name predicate on dictionary references.
+ * \details Uses the filter bitmaps of the dictionary,
+ * so matchers are only evaluated once per distinct path and tag set.
+ */
+class monsoon_dirhistory_local_ group_ref_filter {
+ public:
+  group_ref_filter(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict);
+
+  auto operator()(std::uint32_t grp_ref, std::uint32_t tag_ref) const -> bool;
+
+ private:
+  const path_matcher* g_;
+  const tag_matcher* t_;
+  std::shared_ptr<const dictionary> dict_;
+  std::shared_ptr<const dictionary::filter_bits> grp_bits_, tag_bits_;
 };
 
+
+template<typename Eval>
+auto filter_bits::test(std::uint32_t ref, Eval&& eval) const
+-> bool {
+  if (ref >= size_) return std::invoke(eval, ref);
+
+  // Concurrent evaluations of the same reference store the same result.
+  std::uint8_t state = state_[ref].load(std::memory_order_relaxed);
+  if (state == UNKNOWN) {
+    state = (std::invoke(eval, ref) ? ACCEPTED : REJECTED);
+    state_[ref].store(state, std::memory_order_relaxed);
+  }
+  return state == ACCEPTED;
+}
+
+
+inline auto group_ref_filter::operator()(std::uint32_t grp_ref, std::uint32_t tag_ref) const
+-> bool {
+  const bool grp_match = grp_bits_->test(
+      grp_ref,
+      [this](std::uint32_t ref) { return (*g_)(simple_group(dict_->pdd()[ref])); });
+  if (!grp_match) return false;
+
+  return tag_bits_->test(
+      tag_ref,
+      [this](std::uint32_t ref) { return (*t_)(monsoon::tags(dict_->tdd()[ref])); });
+}
+
 using dictionary_delta = dictionary;
 
 
@@ -126,7 +126,7 @@ auto decode_tsdata(xdr::xdr_istream& in, const encdec_ctx& ctx)
 }
 
 auto encode_tsdata(encdec_writer& writer, const time_series& ts,
-    dictionary_delta dict, std::optional<file_segment_ptr> pred)
+    dictionary_delta& dict, std::optional<file_segment_ptr> pred)
 -> file_segment_ptr {
   file_segment_ptr records_ptr =
       encode_record_array(writer, ts.get_data(), dict);
@@ -187,7 +187,7 @@ auto decode_tsdata(xdr::xdr_istream&, const encdec_ctx&)
   -> std::shared_ptr<tsdata_list>;
 [[deprecated]]
 monsoon_dirhistory_local_
-auto encode_tsdata(encdec_writer&, const time_series&, dictionary_delta,
+auto encode_tsdata(encdec_writer&, const time_series&, dictionary_delta&,
     std::optional<file_segment_ptr>)
   -> file_segment_ptr;
 
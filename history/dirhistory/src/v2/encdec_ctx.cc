@@ -1,6 +1,8 @@
 #include "encdec_ctx.h"
 #include "../raw_file_segment_reader.h"
+#include "../mapped_file_segment_reader.h"
 #include <monsoon/io/gzip_stream.h>
+#include <monsoon/io/snappy_stream.h>
 
 namespace monsoon::history::v2 {
 
@@ -8,9 +10,24 @@ namespace monsoon::history::v2 {
 auto encdec_ctx::new_reader(const file_segment_ptr& ptr, bool compression)
   const
 -> xdr::xdr_stream_reader<io::ptr_stream_reader> {
-  auto rd = io::make_ptr_reader<raw_file_segment_reader>(
-      *fd_, ptr.offset(),
-      ptr.size());
+  auto rd = [this, &ptr]() {
+    if (map_ != nullptr
+        && mapped_file_segment_reader::fits(*map_, ptr.offset(), ptr.size())) {
+      return io::make_ptr_reader<mapped_file_segment_reader>(
+          *map_, ptr.offset(),
+          ptr.size());
+    }
+    if (readahead_ != nullptr) {
+      if (auto data = readahead_->take(ptr); data.has_value()) {
+        return io::make_ptr_reader<mapped_file_segment_reader>(
+            std::move(*data),
+            ptr.size());
+      }
+    }
+    return io::make_ptr_reader<raw_file_segment_reader>(
+        *fd_, ptr.offset(),
+        ptr.size());
+  }();
   if (compression) rd = decompress(std::move(rd), true);
   return xdr::xdr_stream_reader<io::ptr_stream_reader>(std::move(rd));
 }
@@ -20,12 +37,13 @@ auto encdec_ctx::decompress(io::ptr_stream_reader&& rd, bool validate) const
   switch (compression()) {
     default:
     case compression_type::LZO_1X1: // XXX implement reader
-    case compression_type::SNAPPY: // XXX implement reader
       throw std::logic_error("Unsupported compression");
     case compression_type::NONE:
       return std::move(rd).get();
     case compression_type::GZIP:
       return io::new_gzip_decompression(std::move(rd), validate);
+    case compression_type::SNAPPY:
+      return io::new_snappy_decompression(std::move(rd), validate);
   }
 }
 
@@ -33,13 +51,14 @@ auto encdec_ctx::compress(io::ptr_stream_writer&& wr) const
 -> std::unique_ptr<io::stream_writer> {
   switch (compression()) {
     default:
-    case compression_type::LZO_1X1: // XXX implement reader
-    case compression_type::SNAPPY: // XXX implement reader
+    case compression_type::LZO_1X1: // XXX implement writer
       throw std::logic_error("Unsupported compression");
     case compression_type::NONE:
       return std::move(wr).get();
     case compression_type::GZIP:
       return io::new_gzip_compression(std::move(wr));
+    case compression_type::SNAPPY:
+      return io::new_snappy_compression(std::move(wr));
   }
 }
 
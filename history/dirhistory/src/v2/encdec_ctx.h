@@ -3,13 +3,16 @@
 
 #include <monsoon/history/dir/dirhistory_export_.h>
 #include <monsoon/io/fd.h>
+#include <monsoon/io/mmap_view.h>
 #include <monsoon/xdr/xdr_stream.h>
 #include <monsoon/io/stream.h>
 #include <monsoon/io/ptr_stream.h>
 #include "file_segment_ptr.h"
+#include "segment_readahead.h"
 #include "tsfile_header.h"
 #include <cassert>
 #include <cstdint>
+#include <vector>
 
 namespace monsoon::history::v2 {
 
@@ -25,9 +28,15 @@ class monsoon_dirhistory_local_ encdec_ctx {
 
   constexpr encdec_ctx() noexcept = default;
 
-  constexpr encdec_ctx(io::fd& fd, std::uint32_t hdr_flags)
+  ///\param map If not null, a mapping of \p fd used to read segments.
+  ///\param readahead If not null, used to read segments ahead of decoding.
+  constexpr encdec_ctx(io::fd& fd, std::uint32_t hdr_flags, std::uint16_t minor_version = 0u,
+      const io::mmap_view* map = nullptr, segment_readahead* readahead = nullptr)
   : fd_(&fd),
-    hdr_flags_(hdr_flags)
+    map_(map),
+    readahead_(readahead),
+    hdr_flags_(hdr_flags),
+    minor_version_(minor_version)
   {}
 
   auto fd() const noexcept -> io::fd& {
@@ -36,6 +45,14 @@ class monsoon_dirhistory_local_ encdec_ctx {
   }
 
   auto flags() const noexcept -> std::uint32_t { return hdr_flags_; }
+  ///\brief Minor version of the file format, selecting optional encodings.
+  auto minor_version() const noexcept -> std::uint16_t { return minor_version_; }
+
+  ///\brief Read the given segments ahead of decoding them, in order.
+  auto readahead(std::vector<file_segment_ptr> segments) const
+  -> readahead_cursor {
+    return readahead_cursor(readahead_, std::move(segments));
+  }
 
   auto new_reader(const file_segment_ptr&, bool = true) const
       -> xdr::xdr_stream_reader<io::ptr_stream_reader>;
@@ -50,7 +67,10 @@ class monsoon_dirhistory_local_ encdec_ctx {
 
  private:
   io::fd* fd_ = nullptr;
+  const io::mmap_view* map_ = nullptr;
+  segment_readahead* readahead_ = nullptr;
   std::uint32_t hdr_flags_ = 0;
+  std::uint16_t minor_version_ = 0;
 };
 
 
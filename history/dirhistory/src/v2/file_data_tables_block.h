@@ -39,6 +39,10 @@ class monsoon_dirhistory_local_ file_data_tables_block
   }
 
   auto get() const -> std::shared_ptr<const tables>;
+  ///\brief Location of the dictionary.
+  auto dictionary_ptr() const noexcept -> const file_segment_ptr& { return dict_; }
+  ///\brief Location of the tables.
+  auto tables_ptr() const noexcept -> const file_segment_ptr& { return tables_; }
 
   auto time() const
   noexcept
@@ -74,6 +74,11 @@ class monsoon_dirhistory_local_ group_table
       return dict_->pdd()[item_->first];
     }
 
+    ///\brief Location of the metric table.
+    auto fptr() const noexcept -> const file_segment_ptr& {
+      return item_->second;
+    }
+
     auto operator*() const
     -> const metric_table& {
       return *get();
@@ -1,59 +1,21 @@
 #include "metric_table.h"
 #include "bitset.h"
+#include "column_encoding.h"
 #include "dictionary.h"
 #include "group_table.h"
+#include "tsdata.h"
 #include "xdr_primitives.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <monsoon/xdr/xdr.h>
 
 namespace monsoon::history::v2 {
-namespace {
-
-
-template<typename T> struct serialization_fn;
-
-template<>
-struct serialization_fn<std::int16_t> {
-  static auto decode(xdr::xdr_istream& in) -> std::int16_t {
-    return in.get_int16();
-  }
-
-  static auto encode(xdr::xdr_ostream& out, std::int16_t v) -> void {
-    out.put_int16(v);
-  }
-};
-
-template<>
-struct serialization_fn<std::int32_t> {
-  static auto decode(xdr::xdr_istream& in) -> std::int32_t {
-    return in.get_int32();
-  }
-
-  static auto encode(xdr::xdr_ostream& out, std::int32_t v) -> void {
-    out.put_int32(v);
-  }
-};
-
-template<>
-struct serialization_fn<std::int64_t> {
-  static auto decode(xdr::xdr_istream& in) -> std::int64_t {
-    return in.get_int64();
-  }
-
-  static auto encode(xdr::xdr_ostream& out, std::int64_t v) -> void {
-    out.put_int64(v);
-  }
-};
 
-template<>
-struct serialization_fn<double> {
-  static auto decode(xdr::xdr_istream& in) -> double {
-    return in.get_flt64();
-  }
-
-  static auto encode(xdr::xdr_ostream& out, double v) -> void {
-    out.put_flt64(v);
-  }
-};
 
 template<>
 struct serialization_fn<histogram> {
@@ -66,25 +28,26 @@ struct serialization_fn<histogram> {
   }
 };
 
+namespace {
+
+
 template<typename ValueIter>
 class mt_data_iterator {
  public:
   using iterator_category = std::input_iterator_tag;
-  using value_type = std::pair<bitset::size_type, typename std::iterator_traits<ValueIter>::value_type>;
-  using reference = std::pair<bitset::size_type, typename std::iterator_traits<ValueIter>::reference>;
+  using value_type = std::pair<packed_bitset::size_type, typename std::iterator_traits<ValueIter>::value_type>;
+  using reference = std::pair<packed_bitset::size_type, typename std::iterator_traits<ValueIter>::reference>;
   using pointer = void;
-  using difference_type = bitset::const_iterator::difference_type;
+  using difference_type = packed_bitset::set_bit_iterator::difference_type;
 
   mt_data_iterator() = default;
 
   mt_data_iterator(
-      bitset::const_iterator presence_iter,
-      bitset::const_iterator presence_begin,
-      bitset::const_iterator presence_end,
+      packed_bitset::set_bit_iterator presence_iter,
+      packed_bitset::set_bit_iterator presence_end,
       ValueIter value_iter,
       ValueIter value_end)
-  : presence_iter_(std::find(presence_iter, presence_end, true)),
-    presence_begin_(presence_begin),
+  : presence_iter_(presence_iter),
     presence_end_(presence_end),
     value_iter_(value_iter),
     value_end_(value_end)
@@ -94,7 +57,7 @@ class mt_data_iterator {
     assert(!at_end_());
 
     ++value_iter_;
-    presence_iter_ = std::find(std::next(presence_iter_), presence_end_, true);
+    ++presence_iter_;
     return *this;
   }
 
@@ -107,9 +70,7 @@ class mt_data_iterator {
   auto operator*() -> reference {
     assert(!at_end_());
 
-    auto index = presence_iter_ - presence_begin_;
-    assert(index >= 0);
-    return reference(bitset::size_type(index), *value_iter_);
+    return reference(*presence_iter_, *value_iter_);
   }
 
   auto operator==(const mt_data_iterator& y) const -> bool {
@@ -126,7 +87,7 @@ class mt_data_iterator {
     return presence_iter_ == presence_end_ || value_iter_ == value_end_;
   }
 
-  bitset::const_iterator presence_iter_, presence_begin_, presence_end_;
+  packed_bitset::set_bit_iterator presence_iter_, presence_end_;
   ValueIter value_iter_, value_end_;
 };
 
@@ -134,26 +95,24 @@ template<>
 class mt_data_iterator<void> {
  public:
   using iterator_category = std::input_iterator_tag;
-  using value_type = bitset::size_type;
+  using value_type = packed_bitset::size_type;
   using reference = value_type;
   using pointer = void;
-  using difference_type = bitset::const_iterator::difference_type;
+  using difference_type = packed_bitset::set_bit_iterator::difference_type;
 
   mt_data_iterator() = default;
 
   mt_data_iterator(
-      bitset::const_iterator presence_iter,
-      bitset::const_iterator presence_begin,
-      bitset::const_iterator presence_end)
-  : presence_iter_(std::find(presence_iter, presence_end, true)),
-    presence_begin_(presence_begin),
+      packed_bitset::set_bit_iterator presence_iter,
+      packed_bitset::set_bit_iterator presence_end)
+  : presence_iter_(presence_iter),
     presence_end_(presence_end)
   {}
 
   auto operator++() -> mt_data_iterator& {
     assert(!at_end_());
 
-    presence_iter_ = std::find(std::next(presence_iter_), presence_end_, true);
+    ++presence_iter_;
     return *this;
   }
 
@@ -166,9 +125,7 @@ class mt_data_iterator<void> {
   auto operator*() -> reference {
     assert(!at_end_());
 
-    auto index = presence_iter_ - presence_begin_;
-    assert(index >= 0);
-    return reference(bitset::size_type(index));
+    return *presence_iter_;
   }
 
   auto operator==(const mt_data_iterator& y) const -> bool {
@@ -185,41 +142,61 @@ class mt_data_iterator<void> {
     return presence_iter_ == presence_end_;
   }
 
-  bitset::const_iterator presence_iter_, presence_begin_, presence_end_;
+  packed_bitset::set_bit_iterator presence_iter_, presence_end_;
 };
 
 template<typename T>
 class mt_data {
+ private:
+  ///\brief Test if the values are encoded with a column_encoding prefix.
+  static auto has_column_encoding(std::uint16_t minor_version) noexcept
+  -> bool {
+    return std::is_arithmetic_v<T>
+        && minor_version >= tsdata_v2::MINOR_COLUMN_ENCODINGS;
+  }
+
  public:
   using const_iterator = mt_data_iterator<typename std::vector<T>::const_iterator>;
   using iterator = const_iterator;
 
-  auto decode(xdr::xdr_istream& in)
+  auto decode(xdr::xdr_istream& in, std::uint16_t minor_version)
   -> void {
     presence.decode(in);
     values.clear();
-    in.get_collection(&serialization_fn<T>::decode, values);
+    if constexpr(std::is_arithmetic_v<T>) {
+      if (has_column_encoding(minor_version)) {
+        decode_column(in, values);
+        return;
+      }
+    }
+    decode_raw_column(in, values);
   }
 
-  auto encode(xdr::xdr_ostream& out) const
+  auto encode(xdr::xdr_ostream& out, std::uint16_t minor_version) const
   -> void {
     presence.encode(out);
+    if constexpr(std::is_arithmetic_v<T>) {
+      if (has_column_encoding(minor_version)) {
+        encode_column(out, values);
+        return;
+      }
+    }
     out.put_collection(
         &serialization_fn<T>::encode,
         values.cbegin(), values.cend());
   }
 
   auto size() const noexcept
-  -> bitset::size_type {
+  -> packed_bitset::size_type {
     return presence.size();
   }
 
   auto begin() const -> const_iterator {
-    return const_iterator(presence.begin(), presence.begin(), presence.end(), values.begin(), values.end());
+    return const_iterator(presence.begin_set(), presence.end_set(), values.begin(), values.end());
   }
 
   auto end() const -> const_iterator {
-    return const_iterator(presence.end(), presence.begin(), presence.end(), values.end(), values.end());
+    return const_iterator(presence.end_set(), presence.end_set(), values.end(), values.end());
   }
 
   auto push_absence()
@@ -234,7 +211,7 @@ class mt_data {
   }
 
  private:
-  bitset presence;
+  packed_bitset presence;
   std::vector<T> values;
 };
 
@@ -248,11 +225,14 @@ class mt_data<std::string_view> {
   -> void {
     presence.decode(in);
     values.clear();
-    in.get_collection(
-        [&dict](xdr::xdr_istream& in) -> std::string_view {
-          return dict[in.get_uint32()];
-        },
-        values);
+
+    std::vector<std::uint32_t> indices;
+    in.get_array_collection(indices);
+    values.reserve(indices.size());
+    std::transform(indices.begin(), indices.end(), std::back_inserter(values),
+        [&dict](std::uint32_t idx) -> std::string_view {
+          return dict[idx];
+        });
   }
 
   auto encode(xdr::xdr_ostream& out, strval_dictionary& dict) const
@@ -266,16 +246,16 @@ class mt_data<std::string_view> {
   }
 
   auto size() const noexcept
-  -> bitset::size_type {
+  -> packed_bitset::size_type {
     return presence.size();
   }
 
   auto begin() const -> const_iterator {
-    return const_iterator(presence.begin(), presence.begin(), presence.end(), values.begin(), values.end());
+    return const_iterator(presence.begin_set(), presence.end_set(), values.begin(), values.end());
   }
 
   auto end() const -> const_iterator {
-    return const_iterator(presence.end(), presence.begin(), presence.end(), values.end(), values.end());
+    return const_iterator(presence.end_set(), presence.end_set(), values.end(), values.end());
   }
 
   auto push_absence()
@@ -290,7 +270,7 @@ class mt_data<std::string_view> {
   }
 
  private:
-  bitset presence;
+  packed_bitset presence;
   std::vector<std::string_view> values;
 };
 
@@ -313,16 +293,16 @@ class mt_data<bool> {
   }
 
   auto size() const noexcept
-  -> bitset::size_type {
+  -> packed_bitset::size_type {
     return presence.size();
   }
 
   auto begin() const -> const_iterator {
-    return const_iterator(presence.begin(), presence.begin(), presence.end(), values.begin(), values.end());
+    return const_iterator(presence.begin_set(), presence.end_set(), values.begin(), values.end());
   }
 
   auto end() const -> const_iterator {
-    return const_iterator(presence.end(), presence.begin(), presence.end(), values.end(), values.end());
+    return const_iterator(presence.end_set(), presence.end_set(), values.end(), values.end());
   }
 
   auto push_absence()
@@ -337,7 +317,7 @@ class mt_data<bool> {
   }
 
  private:
-  bitset presence;
+  packed_bitset presence;
   bitset values;
 };
 
@@ -369,16 +349,16 @@ class mt_data<void> {
   }
 
   auto size() const noexcept
-  -> bitset::size_type {
+  -> packed_bitset::size_type {
     return presence.size();
   }
 
   auto begin() const -> const_iterator {
-    return const_iterator(presence.begin(), presence.begin(), presence.end(), values.begin(), values.end());
+    return const_iterator(presence.begin_set(), presence.end_set(), values.begin(), values.end());
   }
 
   auto end() const -> const_iterator {
-    return const_iterator(presence.end(), presence.begin(), presence.end(), values.end(), values.end());
+    return const_iterator(presence.end_set(), presence.end_set(), values.end(), values.end());
   }
 
   auto push_absence()
@@ -393,7 +373,7 @@ class mt_data<void> {
   }
 
  private:
-  bitset presence;
+  packed_bitset presence;
   std::vector<metric_value> values;
 };
 
@@ -414,16 +394,16 @@ class mt_data<metric_value::empty> {
   }
 
   auto size() const noexcept
-  -> bitset::size_type {
+  -> packed_bitset::size_type {
     return presence.size();
   }
 
   auto begin() const -> const_iterator {
-    return const_iterator(presence.begin(), presence.begin(), presence.end());
+    return const_iterator(presence.begin_set(), presence.end_set());
   }
 
   auto end() const -> const_iterator {
-    return const_iterator(presence.end(), presence.begin(), presence.end());
+    return const_iterator(presence.end_set(), presence.end_set());
   }
 
   auto push_absence()
@@ -437,7 +417,7 @@ class mt_data<metric_value::empty> {
   }
 
  private:
-  bitset presence;
+  packed_bitset presence;
 };
 
 template<typename T>
@@ -448,6 +428,14 @@ auto decode_mt_data(xdr::xdr_istream& in)
   return result;
 }
 
+template<typename T>
+auto decode_mt_data(xdr::xdr_istream& in, std::uint16_t minor_version)
+-> mt_data<T> {
+  mt_data<T> result;
+  result.decode(in, minor_version);
+  return result;
+}
+
 template<typename T>
 auto decode_mt_data(xdr::xdr_istream& in, const strval_dictionary& dict)
 -> mt_data<T> {
@@ -683,17 +671,17 @@ class mt_enc {
     assert(invariant());
   }
 
-  auto write(xdr::xdr_ostream& out, strval_dictionary& dict) const
+  auto write(xdr::xdr_ostream& out, strval_dictionary& dict, std::uint16_t minor_version) const
   -> void {
     assert(invariant());
 
     std::get<mt_data<bool>>(data).encode(out);
-    std::get<mt_data<std::int16_t>>(data).encode(out);
-    std::get<mt_data<std::int32_t>>(data).encode(out);
-    std::get<mt_data<std::int64_t>>(data).encode(out);
-    std::get<mt_data<double>>(data).encode(out);
+    std::get<mt_data<std::int16_t>>(data).encode(out, minor_version);
+    std::get<mt_data<std::int32_t>>(data).encode(out, minor_version);
+    std::get<mt_data<std::int64_t>>(data).encode(out, minor_version);
+    std::get<mt_data<double>>(data).encode(out, minor_version);
     std::get<mt_data<std::string_view>>(data).encode(out, dict);
-    std::get<mt_data<histogram>>(data).encode(out);
+    std::get<mt_data<histogram>>(data).encode(out, minor_version);
     std::get<mt_data<metric_value::empty>>(data).encode(out);
     std::get<mt_data<void>>(data).encode(out, dict);
   }
@@ -734,14 +722,16 @@ auto metric_table::from_xdr(std::shared_ptr<group_table> parent, xdr::xdr_istrea
 
 auto metric_table::decode(xdr::xdr_istream& in)
 -> void {
+  const std::uint16_t minor_version = parent().get_ctx().minor_version();
+
   data_.clear();
   decode_apply(data_, decode_mt_data<bool>(in));
-  decode_apply(data_, decode_mt_data<std::int16_t>(in));
-  decode_apply(data_, decode_mt_data<std::int32_t>(in));
-  decode_apply(data_, decode_mt_data<std::int64_t>(in));
-  decode_apply(data_, decode_mt_data<double>(in));
+  decode_apply(data_, decode_mt_data<std::int16_t>(in, minor_version));
+  decode_apply(data_, decode_mt_data<std::int32_t>(in, minor_version));
+  decode_apply(data_, decode_mt_data<std::int64_t>(in, minor_version));
+  decode_apply(data_, decode_mt_data<double>(in, minor_version));
   decode_apply(data_, decode_mt_data<std::string_view>(in, parent().get_dictionary()->sdd()));
-  decode_apply(data_, decode_mt_data<histogram>(in));
+  decode_apply(data_, decode_mt_data<histogram>(in, minor_version));
   decode_apply(data_, decode_mt_data<metric_value::empty>(in));
   decode_apply(data_, decode_mt_data<void>(in, parent().get_dictionary()->sdd()));
 }
@@ -751,7 +741,21 @@ auto metric_table::encode(xdr::xdr_ostream& out) const -> void {
   std::for_each(
       data_.begin(), data_.end(),
       [&enc](const std::optional<metric_value>& v) { enc.push_back(v); });
-  enc.write(out, parent().get_dictionary()->sdd());
+  enc.write(out, parent().get_dictionary()->sdd(), parent().get_ctx().minor_version());
+}
+
+
+auto encode_metric_table(
+    xdr::xdr_ostream& out,
+    const std::vector<std::optional<metric_value>>& column,
+    strval_dictionary& dict,
+    std::uint16_t minor_version)
+-> void {
+  mt_enc enc;
+  std::for_each(
+      column.begin(), column.end(),
+      [&enc](const std::optional<metric_value>& v) { enc.push_back(v); });
+  enc.write(out, dict, minor_version);
 }
 
 
@@ -2,6 +2,7 @@
 #define V2_METRIC_TABLE_H
 
 #include <cassert>
+#include <cstdint>
 #include <optional>
 #include <vector>
 #include <memory>
@@ -11,6 +12,7 @@
 #include <monsoon/history/dir/dirhistory_export_.h>
 #include "fwd.h"
 #include "cache.h"
+#include "dictionary.h"
 #include "../dynamics.h"
 
 namespace monsoon::history::v2 {
@@ -107,6 +109,17 @@ class monsoon_dirhistory_local_ metric_table
 };
 
 
+///\brief Encode a column of metric values, in the format read by metric_table.
+///\param minor_version The minor version of the file format to write.
+monsoon_dirhistory_local_
+auto encode_metric_table(
+    xdr::xdr_ostream& out,
+    const std::vector<std::optional<metric_value>>& column,
+    strval_dictionary& dict,
+    std::uint16_t minor_version = 0u)
+-> void;
+
+
 } /* namespace monsoon::history::v2 */
 
 #endif /* V2_METRIC_TABLE_H */
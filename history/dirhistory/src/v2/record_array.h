@@ -133,18 +133,14 @@ class monsoon_dirhistory_local_ record_array
 
   class filter_fn_ {
    public:
-    explicit filter_fn_(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict) noexcept
-    : g_(&g),
-      t_(&t),
-      dict_(std::move(dict))
+    explicit filter_fn_(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict)
+    : filter_(g, t, std::move(dict))
     {}
 
     auto operator()(data_type::const_reference v) const -> bool;
 
    private:
-    const path_matcher* g_;
-    const tag_matcher* t_;
-    std::shared_ptr<const dictionary> dict_;
+    group_ref_filter filter_;
   };
 
  public:
@@ -224,8 +220,7 @@ inline auto record_array::proxy_tf_fn_::operator()(data_type::const_reference v)
 
 inline auto record_array::filter_fn_::operator()(data_type::const_reference v) const
 -> bool {
-  return (*g_)(simple_group(dict_->pdd()[v.grp_ref]))
-      && (*t_)(monsoon::tags(dict_->tdd()[v.tag_ref]));
+  return filter_(v.grp_ref, v.tag_ref);
 }
 
 inline auto record_array::begin() const
@@ -21,6 +21,28 @@
 namespace monsoon::history::v2 {
 
 
+/**
+ * \brief Memoizes metric filter matches by dictionary path reference.
+ * \details Path references are stable for the lifetime of a dictionary,
+ * so a single cache can be shared by all records using that dictionary.
+ */
+class monsoon_dirhistory_local_ metric_filter_cache {
+ private:
+  enum class state : std::uint8_t { unknown, match, no_match };
+
+ public:
+  explicit metric_filter_cache(const path_matcher& m) noexcept
+  : m_(&m)
+  {}
+
+  auto operator()(const dictionary& dict, std::uint32_t ref) -> bool;
+
+ private:
+  const path_matcher* m_;
+  std::vector<state> matches_;
+};
+
+
 class monsoon_dirhistory_local_ record_metrics
 : public typed_dynamics<record_array>,
   public std::enable_shared_from_this<record_metrics>
@@ -66,7 +88,7 @@ class monsoon_dirhistory_local_ record_metrics
 
   class filter_fn_ {
    public:
-    filter_fn_(const path_matcher& m, std::shared_ptr<const dictionary> dict)
+    filter_fn_(metric_filter_cache& m, std::shared_ptr<const dictionary> dict)
     : m_(&m),
       dict_(std::move(dict))
     {}
@@ -74,7 +96,7 @@ class monsoon_dirhistory_local_ record_metrics
     auto operator()(data_type::const_reference v) const -> bool;
 
    private:
-    const path_matcher* m_;
+    metric_filter_cache* m_;
     std::shared_ptr<const dictionary> dict_;
   };
 
@@ -96,7 +118,7 @@ class monsoon_dirhistory_local_ record_metrics
    public:
     filter_view() noexcept {}
 
-    filter_view(const record_metrics* self, const path_matcher* m) noexcept
+    filter_view(const record_metrics* self, metric_filter_cache* m) noexcept
     : self_(self),
       m_(m)
     {}
@@ -111,7 +133,7 @@ class monsoon_dirhistory_local_ record_metrics
 
    private:
     const record_metrics* self_ = nullptr;
-    const path_matcher* m_ = nullptr;
+    metric_filter_cache* m_ = nullptr;
   };
 
   static constexpr bool is_compressed = true;
@@ -131,14 +153,29 @@ class monsoon_dirhistory_local_ record_metrics
 
   auto begin() const -> const_iterator;
   auto end() const -> const_iterator;
-  auto begin(const path_matcher& m) const -> const_filtered_iterator;
-  auto end(const path_matcher& m) const -> const_filtered_iterator;
+  auto begin(metric_filter_cache& m) const -> const_filtered_iterator;
+  auto end(metric_filter_cache& m) const -> const_filtered_iterator;
+  ///\brief View containing only the metrics accepted by \p m.
+  ///\note The view references \p m, which must outlive it.
+  auto filter(metric_filter_cache& m) const -> filter_view {
+    return filter_view(this, &m);
+  }
 
  private:
   data_type data_;
 };
 
 
+inline auto metric_filter_cache::operator()(const dictionary& dict, std::uint32_t ref)
+-> bool {
+  if (ref >= matches_.size()) matches_.resize(ref + 1u, state::unknown);
+
+  state& s = matches_[ref];
+  if (s == state::unknown)
+    s = ((*m_)(metric_name(dict.pdd()[ref])) ? state::match : state::no_match);
+  return s == state::match;
+}
+
 inline auto record_metrics::proxy_tf_fn_::operator()(data_type::const_reference v) const
 -> proxy {
   return proxy(dict_, &v);
@@ -146,7 +183,7 @@ inline auto record_metrics::proxy_tf_fn_::operator()(data_type::const_reference
 
 inline auto record_metrics::filter_fn_::operator()(data_type::const_reference v) const
 -> bool {
-  return (*m_)(metric_name(dict_->pdd()[v.first]));
+  return (*m_)(*dict_, v.first);
 }
 
 inline auto record_metrics::begin() const
@@ -163,7 +200,7 @@ inline auto record_metrics::end() const
       proxy_tf_fn_(get_dictionary()));
 }
 
-inline auto record_metrics::begin(const path_matcher& m) const
+inline auto record_metrics::begin(metric_filter_cache& m) const
 -> const_filtered_iterator {
   std::shared_ptr<const dictionary> dict = get_dictionary();
   return boost::make_transform_iterator(
@@ -173,7 +210,7 @@ inline auto record_metrics::begin(const path_matcher& m) const
       proxy_tf_fn_(dict));
 }
 
-inline auto record_metrics::end(const path_matcher& m) const
+inline auto record_metrics::end(metric_filter_cache& m) const
 -> const_filtered_iterator {
   std::shared_ptr<const dictionary> dict = get_dictionary();
   return boost::make_transform_iterator(
@@ -0,0 +1,124 @@
+#include "segment_readahead.h"
+#include <algorithm>
+#include <cassert>
+
+namespace monsoon::history::v2 {
+
+
+segment_readahead::segment_read::segment_read(
+    const io::fd& fd, const file_segment_ptr& ptr)
+: data(storage_size(ptr))
+{
+  // Platforms without aio read synchronously, and may fail here.
+  // If start() fails, the read was cancelled, so the buffer can be released.
+  aio_.on(fd).read_at(ptr.offset(), data.data(), data.size());
+  aio_.start();
+}
+
+segment_readahead::segment_read::~segment_read() noexcept {
+  // The read must complete before its buffer is released.
+  wait();
+}
+
+auto segment_readahead::segment_read::wait() noexcept -> bool {
+  if (!joined_) {
+    try {
+      aio_.join();
+    } catch (...) {
+      failed_ = true;
+    }
+    joined_ = true;
+  }
+  return !failed_;
+}
+
+
+segment_readahead::~segment_readahead() noexcept {
+  assert(reads_.empty()); // Cursors may not outlive the file.
+}
+
+auto segment_readahead::take(const file_segment_ptr& ptr)
+-> std::optional<std::vector<std::uint8_t>> {
+  std::shared_ptr<segment_read> r;
+  {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    const auto iter = reads_.find(ptr);
+    if (iter == reads_.end()) return {};
+    r = iter->second.lock();
+    reads_.erase(iter);
+  }
+
+  // Wait outside the lock, so reads of other segments can be taken meanwhile.
+  if (r == nullptr || !r->wait()) return {};
+  return std::move(r->data);
+}
+
+auto segment_readahead::start_(const file_segment_ptr& ptr)
+-> std::shared_ptr<segment_read> {
+  auto r = std::make_shared<segment_read>(fd_, ptr);
+
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  reads_.emplace(ptr, r);
+  return r;
+}
+
+void segment_readahead::forget_(const file_segment_ptr& ptr,
+    const std::shared_ptr<segment_read>& r) noexcept {
+  std::lock_guard<std::mutex> lck{ mtx_ };
+
+  const auto range = reads_.equal_range(ptr);
+  const auto iter = std::find_if(range.first, range.second,
+      [&r](const auto& entry) {
+        return !entry.second.owner_before(r) && !r.owner_before(entry.second);
+      });
+  if (iter != range.second) reads_.erase(iter);
+}
+
+
+void readahead_cursor::advance(std::size_t i) noexcept {
+  if (readahead_ == nullptr) return;
+
+  // Released reads wait for completion when destroyed,
+  // which happens after the lock is released.
+  std::vector<std::shared_ptr<segment_read>> released;
+
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  if (i > released_) {
+    while (!window_.empty() && std::get<0>(window_.front()) < i) {
+      auto& [idx, r] = window_.front();
+      readahead_->forget_(segments_[idx], r);
+      bytes_ -= segment_readahead::storage_size(segments_[idx]);
+      try {
+        released.push_back(std::move(r));
+      } catch (...) {
+        // Waits under the lock instead.
+      }
+      window_.pop_front();
+    }
+    released_ = i;
+  }
+
+  if (prefetched_ < i) prefetched_ = i;
+  while (prefetched_ < segments_.size()) {
+    const file_segment_ptr& ptr = segments_[prefetched_];
+    const auto len = segment_readahead::storage_size(ptr);
+    if (len <= window_bytes_) { // Else it never fits, decoder will read it.
+      if (bytes_ + len > window_bytes_ || window_.size() >= window_segments_)
+        break;
+
+      try {
+        window_.emplace_back(prefetched_, nullptr);
+        std::get<1>(window_.back()) = readahead_->start_(ptr);
+      } catch (...) {
+        if (!window_.empty() && std::get<1>(window_.back()) == nullptr)
+          window_.pop_back();
+        break; // Read-ahead is best effort.
+      }
+      bytes_ += len;
+    }
+    ++prefetched_;
+  }
+}
+
+
+} /* namespace monsoon::history::v2 */
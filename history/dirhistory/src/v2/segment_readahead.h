@@ -0,0 +1,159 @@
+#ifndef V2_SEGMENT_READAHEAD_H
+#define V2_SEGMENT_READAHEAD_H
+
+#include <monsoon/history/dir/dirhistory_export_.h>
+#include <monsoon/io/aio.h>
+#include <monsoon/io/fd.h>
+#include "file_segment_ptr.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace monsoon::history::v2 {
+
+
+class readahead_cursor;
+
+/**
+ * \brief Asynchronous read-ahead of file segments.
+ *
+ * \details
+ * Segments that a query is about to decode are read using io::aio,
+ * so the reads overlap with decoding of earlier segments.
+ * Queries read ahead through a readahead_cursor, which holds a bounded
+ * number of bytes and segments.
+ * The segment_readahead tracks the reads of all cursors on the file,
+ * so the decoder can take their data.
+ *
+ * Read-ahead is best effort: segments that fail to read, or that
+ * did not fit in the window, are read synchronously by the decoder,
+ * which reports any errors.
+ */
+class monsoon_dirhistory_local_ segment_readahead {
+  friend readahead_cursor;
+
+ public:
+  explicit segment_readahead(const io::fd& fd) noexcept
+  : fd_(fd)
+  {}
+
+  segment_readahead(const segment_readahead&) = delete;
+  segment_readahead& operator=(const segment_readahead&) = delete;
+  ~segment_readahead() noexcept;
+
+  /**
+   * \brief Take the data of a segment, if it was read ahead.
+   * \details Waits for the read of this segment to complete.
+   * \returns The segment data, followed by its padding and CRC.
+   * An empty optional if the segment is not available.
+   */
+  auto take(const file_segment_ptr& ptr)
+  -> std::optional<std::vector<std::uint8_t>>;
+
+  ///\brief Number of bytes a segment occupies in the file.
+  static auto storage_size(const file_segment_ptr& ptr) noexcept
+  -> file_segment_ptr::size_type {
+    return (ptr.size() + 3u) / 4u * 4u + 4u; // Padding and CRC.
+  }
+
+ private:
+  ///\brief Read of a single segment.
+  ///\details Destruction waits for the read to complete.
+  class segment_read {
+   public:
+    ///\brief Start reading the segment.
+    segment_read(const io::fd& fd, const file_segment_ptr& ptr);
+    segment_read(const segment_read&) = delete;
+    segment_read& operator=(const segment_read&) = delete;
+    ~segment_read() noexcept;
+
+    ///\brief Wait for the read to complete.
+    ///\returns True if the read succeeded.
+    ///\note Not thread safe.
+    auto wait() noexcept -> bool;
+
+    std::vector<std::uint8_t> data;
+
+   private:
+    io::aio aio_;
+    bool joined_ = false, failed_ = false;
+  };
+
+  ///\brief Start reading a segment and offer it to take().
+  auto start_(const file_segment_ptr& ptr) -> std::shared_ptr<segment_read>;
+  ///\brief Withdraw a read from take(), if it was not taken.
+  void forget_(const file_segment_ptr& ptr,
+      const std::shared_ptr<segment_read>& r) noexcept;
+
+  const io::fd& fd_;
+  std::mutex mtx_; // Protects reads_.
+  ///\brief Reads that were not yet taken.
+  ///\details Owned by the cursors that started them.
+  std::unordered_multimap<file_segment_ptr, std::weak_ptr<segment_read>> reads_;
+};
+
+
+/**
+ * \brief Reads a sequence of segments ahead of their use.
+ *
+ * \details
+ * The cursor keeps its read-ahead window filled with the segments
+ * following the one in use, and releases the data of segments
+ * that were passed without being taken (for instance, because
+ * the decoded segment was found in the cache).
+ *
+ * Each cursor has its own window, so concurrent queries on a file
+ * don't evict each other's reads.
+ */
+class monsoon_dirhistory_local_ readahead_cursor {
+ public:
+  ///\brief Default maximum number of bytes held by a cursor.
+  static constexpr std::size_t DEFAULT_WINDOW_BYTES = 4u << 20;
+  ///\brief Default maximum number of segments held by a cursor.
+  static constexpr std::size_t DEFAULT_WINDOW_SEGMENTS = 256u;
+
+  ///\param readahead If null, the cursor does nothing.
+  readahead_cursor(segment_readahead* readahead, std::vector<file_segment_ptr> segments,
+      std::size_t window_bytes = DEFAULT_WINDOW_BYTES,
+      std::size_t window_segments = DEFAULT_WINDOW_SEGMENTS)
+  : readahead_(readahead),
+    segments_(std::move(segments)),
+    window_bytes_(window_bytes),
+    window_segments_(window_segments)
+  {
+    advance(0);
+  }
+
+  readahead_cursor(const readahead_cursor&) = delete;
+  readahead_cursor& operator=(const readahead_cursor&) = delete;
+
+  ~readahead_cursor() noexcept {
+    advance(segments_.size());
+  }
+
+  ///\brief Indicate segments before index \p i are no longer needed.
+  ///\note May be called concurrently.
+  void advance(std::size_t i) noexcept;
+
+ private:
+  using segment_read = segment_readahead::segment_read;
+
+  segment_readahead* readahead_;
+  std::vector<file_segment_ptr> segments_;
+  const std::size_t window_bytes_, window_segments_;
+  std::mutex mtx_; // Protects everything below.
+  ///\brief Reads started by this cursor, with their segment index, oldest first.
+  std::deque<std::tuple<std::size_t, std::shared_ptr<segment_read>>> window_;
+  std::size_t bytes_ = 0, released_ = 0, prefetched_ = 0;
+};
+
+
+} /* namespace monsoon::history::v2 */
+
+#endif /* V2_SEGMENT_READAHEAD_H */
@@ -97,6 +97,11 @@ class monsoon_dirhistory_local_ tables
       return group_name(path(), tags());
     }
 
+    ///\brief Location of the group table.
+    auto fptr() const noexcept -> const file_segment_ptr& {
+      return item_->second;
+    }
+
     auto operator*() const
     -> const group_table& {
       return *get();
@@ -141,18 +146,14 @@ class monsoon_dirhistory_local_ tables
 
   class filter_fn_ {
    public:
-    explicit filter_fn_(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict) noexcept
-    : g_(&g),
-      t_(&t),
-      dict_(std::move(dict))
+    explicit filter_fn_(const path_matcher& g, const tag_matcher& t, std::shared_ptr<const dictionary> dict)
+    : filter_(g, t, std::move(dict))
     {}
 
     auto operator()(data_type::const_reference v) const -> bool;
 
    private:
-    const path_matcher* g_;
-    const tag_matcher* t_;
-    std::shared_ptr<const dictionary> dict_;
+    group_ref_filter filter_;
   };
 
  public:
@@ -242,8 +243,7 @@ inline auto tables::proxy_tf_fn_::operator()(data_type::const_reference v) const
 
 inline auto tables::filter_fn_::operator()(data_type::const_reference v) const
 -> bool {
-  return (*g_)(simple_group(dict_->pdd()[v.first.grp_ref]))
-      && (*t_)(monsoon::tags(dict_->tdd()[v.first.tag_ref]));
+  return filter_(v.first.grp_ref, v.first.tag_ref);
 }
 
 inline auto tables::begin() const
@@ -1,6 +1,6 @@
 #include "timestamp_delta.h"
-#include <algorithm>
 #include <iterator>
+#include <limits>
 
 namespace monsoon::history::v2 {
 
@@ -13,20 +13,16 @@ auto timestamp_delta::from_xdr(xdr::xdr_istream& in)
 }
 
 auto timestamp_delta::decode(xdr::xdr_istream& in) -> void {
-  clear();
-  push_back(time_point(in.get_int64()));
-
-  in.get_collection(
-      [](xdr::xdr_istream& in) {
-        return time_point(in.get_int32());
-      },
-      *this);
-
-  for (iterator i = std::next(begin()), i_end = end();
-      i != i_end;
-      ++i) {
-    *i += time_point::duration(std::prev(i)->millis_since_posix_epoch());
-  }
+  std::int64_t millis = in.get_int64();
+  std::vector<std::int32_t> deltas;
+  in.get_array_collection(deltas);
+
+  // Single pass running sum over the deltas, in milliseconds.
+  resize(deltas.size() + 1u);
+  auto out = begin();
+  *out = time_point(millis);
+  for (const std::int32_t delta : deltas)
+    *++out = time_point(millis += delta);
 }
 
 auto timestamp_delta::encode(xdr::xdr_ostream& out) const -> void {
@@ -42,7 +38,8 @@ auto timestamp_delta::encode(xdr::xdr_ostream& out) const -> void {
         const std::int64_t delta = tp_millis - pred;
         pred = tp_millis;
 
-        if (delta > 0x7fffffff || delta < -0x80000000) {
+        if (delta > std::numeric_limits<std::int32_t>::max()
+            || delta < std::numeric_limits<std::int32_t>::min()) {
           throw std::invalid_argument("time between successive timestamps "
               "is too large");
         }
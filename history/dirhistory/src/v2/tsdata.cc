@@ -2,6 +2,7 @@
 #include "encdec.h"
 #include <functional>
 #include <algorithm>
+#include <stdexcept>
 #include <monsoon/time_series.h>
 #include <monsoon/time_series_value.h>
 #include <monsoon/time_point.h>
@@ -27,6 +28,8 @@ std::shared_ptr<tsdata_v2> tsdata_v2::open(io::fd&& fd) {
   tsfile_header hdr;
   hdr.decode(xdr);
   xdr.close();
+  if (mime.minor_version > MAX_MINOR)
+    throw xdr::xdr_exception("file minor version not supported");
 
   switch (hdr.kind()) {
     default:
@@ -39,21 +42,21 @@ std::shared_ptr<tsdata_v2> tsdata_v2::open(io::fd&& fd) {
 }
 
 std::shared_ptr<tsdata_v2> tsdata_v2::new_list_file(io::fd&& fd,
-    time_point tp) {
+    time_point tp, compression_type compression) {
   constexpr auto HDR_LEN =
       tsfile_mimeheader::XDR_ENCODED_LEN + tsfile_header::XDR_SIZE;
   constexpr auto CHECKSUMMED_HDR_LEN =
       HDR_LEN + 4u;
 
   const std::uint32_t fl = (header_flags::KIND_LIST
-      | header_flags::GZIP
+      | compression_flags(compression)
       | header_flags::SORTED // Empty files are always sorted.
       | header_flags::DISTINCT); // Empty files are always distinct.
 
   io::fd::size_type data_len, storage_len;
   auto xdr = xdr::xdr_stream_writer<raw_file_segment_writer>(
       raw_file_segment_writer(fd, 0, &data_len, &storage_len));
-  tsfile_mimeheader(MAJOR, MAX_MINOR).write(xdr);
+  tsfile_mimeheader(MAJOR, 0u).write(xdr); // List files use no minor version features.
   encode_timestamp(xdr, tp); // first
   encode_timestamp(xdr, tp); // last
   xdr.put_uint32(fl); // flags
@@ -68,6 +71,31 @@ std::shared_ptr<tsdata_v2> tsdata_v2::new_list_file(io::fd&& fd,
   return open(std::move(fd));
 }
 
+std::shared_ptr<tsdata_v2> tsdata_v2::new_tables_file(io::fd&& fd,
+    objpipe::reader<emit_type> data, compression_type compression) {
+  return tsdata_v2_tables::new_file(std::move(fd), std::move(data),
+      compression);
+}
+
+std::shared_ptr<tsdata_v2> tsdata_v2::new_tables_file(io::fd&& fd,
+    const std::vector<time_series>& data, compression_type compression) {
+  return tsdata_v2_tables::new_file(std::move(fd), data, compression);
+}
+
+auto tsdata_v2::compression_flags(compression_type compression)
+-> std::uint32_t {
+  switch (compression) {
+    default:
+      throw std::invalid_argument("compression");
+    case compression_type::NONE:
+      return 0u;
+    case compression_type::GZIP:
+      return header_flags::GZIP;
+    case compression_type::SNAPPY:
+      return header_flags::SNAPPY;
+  }
+}
+
 tsdata_v2::~tsdata_v2() noexcept {}
 
 std::vector<time_series> tsdata_v2::read_all() const {
@@ -143,16 +171,28 @@ auto tsdata_v2::get_path() const -> std::optional<std::string> {
   return fd_.get_path();
 }
 
+auto tsdata_v2::file_size() const -> std::optional<std::uintmax_t> {
+  return hdr_file_size();
+}
+
 auto tsdata_v2::get_ctx() const -> encdec_ctx {
-  return encdec_ctx(fd(), hdr_.flags);
+  if (!map_.empty())
+    return encdec_ctx(fd(), hdr_.flags, mime_.minor_version, &map_);
+  return encdec_ctx(fd(), hdr_.flags, mime_.minor_version, nullptr, &readahead_);
+}
+
+auto tsdata_v2::map_read_only_(const io::fd& fd) noexcept -> io::mmap_view {
+  if (fd.can_write()) return io::mmap_view(); // File may still grow.
+
+  try {
+    return io::mmap_view(fd);
+  } catch (...) {
+    return io::mmap_view(); // Fall back to reading with fd.
+  }
 }
 
 void tsdata_v2::update_hdr(time_point lo, time_point hi,
     const file_segment_ptr& fsp, io::fd::size_type new_file_len) {
-  constexpr auto HDR_LEN =
-      tsfile_mimeheader::XDR_ENCODED_LEN + tsfile_header::XDR_SIZE;
-  constexpr auto CHECKSUMMED_HDR_LEN =
-      HDR_LEN + 4u;
   assert(lo <= hi);
 
   if (lo < hdr_.last)
@@ -161,11 +201,17 @@ void tsdata_v2::update_hdr(time_point lo, time_point hi,
     hdr_.flags &= ~header_flags::DISTINCT;
 
   mime_.major_version = MAJOR;
-  mime_.minor_version = MAX_MINOR;
   if (lo < hdr_.first) hdr_.first = lo;
   if (hi > hdr_.last) hdr_.last = hi;
   hdr_.file_size = new_file_len;
   hdr_.fdt = fsp;
+}
+
+void tsdata_v2::write_hdr(bool durable) {
+  constexpr auto HDR_LEN =
+      tsfile_mimeheader::XDR_ENCODED_LEN + tsfile_header::XDR_SIZE;
+  constexpr auto CHECKSUMMED_HDR_LEN =
+      HDR_LEN + 4u;
 
   io::fd::size_type data_len, storage_len;
   auto xdr = xdr::xdr_stream_writer<raw_file_segment_writer>(
@@ -173,7 +219,7 @@ void tsdata_v2::update_hdr(time_point lo, time_point hi,
   mime_.write(xdr);
   hdr_.encode(xdr);
   xdr.close();
-  fd_.flush();
+  if (durable) fd_.flush();
 
   assert(data_len == HDR_LEN);
   assert(storage_len == CHECKSUMMED_HDR_LEN);
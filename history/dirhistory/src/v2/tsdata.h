@@ -4,6 +4,7 @@
 #include <monsoon/history/dir/dirhistory_export_.h>
 #include <monsoon/history/dir/tsdata.h>
 #include <monsoon/io/fd.h>
+#include <monsoon/io/mmap_view.h>
 #include <monsoon/time_point.h>
 #include <memory>
 #include "file_segment_ptr.h"
@@ -11,6 +12,7 @@
 #include "../dynamics.h"
 #include "tsfile_header.h"
 #include "encdec_ctx.h"
+#include "segment_readahead.h"
 
 namespace monsoon {
 namespace history {
@@ -23,15 +25,29 @@ class monsoon_dirhistory_local_ tsdata_v2
 {
  public:
   static constexpr std::uint16_t MAJOR = 2u;
-  static constexpr std::uint16_t MAX_MINOR = 0u;
+  static constexpr std::uint16_t MAX_MINOR = 1u;
+  ///\brief Minor version adding encoded integer and floating point columns
+  ///to metric tables.
+  static constexpr std::uint16_t MINOR_COLUMN_ENCODINGS = 1u;
 
   static std::shared_ptr<tsdata_v2> open(io::fd&& fd);
-  static std::shared_ptr<tsdata_v2> new_list_file(io::fd&& fd, time_point tp);
+  static std::shared_ptr<tsdata_v2> new_list_file(io::fd&& fd, time_point tp,
+      compression_type compression = compression_type::GZIP);
+  static std::shared_ptr<tsdata_v2> new_tables_file(io::fd&& fd,
+      objpipe::reader<emit_type> data,
+      compression_type compression = compression_type::GZIP);
+  static std::shared_ptr<tsdata_v2> new_tables_file(io::fd&& fd,
+      const std::vector<time_series>& data,
+      compression_type compression = compression_type::GZIP);
+  ///\brief Header flags selecting the given compression.
+  static auto compression_flags(compression_type compression) -> std::uint32_t;
 
   tsdata_v2(io::fd&& fd, const tsfile_mimeheader& mime, const tsfile_header& hdr)
   : fd_(std::move(fd)),
     mime_(mime),
-    hdr_(hdr)
+    hdr_(hdr),
+    map_(map_read_only_(fd_)),
+    readahead_(fd_)
   {}
 
   ~tsdata_v2() noexcept override;
@@ -42,21 +58,32 @@ class monsoon_dirhistory_local_ tsdata_v2
   std::tuple<std::uint16_t, std::uint16_t> version() const noexcept override;
   auto time() const -> std::tuple<time_point, time_point> override;
   std::optional<std::string> get_path() const override;
+  auto file_size() const -> std::optional<std::uintmax_t> override;
   auto get_ctx() const -> encdec_ctx;
 
  protected:
   inline auto hdr_file_size() const noexcept { return hdr_.file_size; }
+  ///\brief Update the header in memory.
+  ///\note The header is written to the file by write_hdr().
   void update_hdr(time_point, time_point, const file_segment_ptr&,
       io::fd::size_type);
+  ///\brief Write the header to the file.
+  ///\param durable If set, wait for the header to reach the disk.
+  void write_hdr(bool durable);
   bool is_distinct() const noexcept;
   bool is_sorted() const noexcept;
 
  private:
   virtual std::vector<time_series> read_all_raw_() const = 0;
+  ///\brief Map the file, if it is opened read-only.
+  ///\returns An empty mapping if the file is writable or can not be mapped.
+  static auto map_read_only_(const io::fd& fd) noexcept -> io::mmap_view;
 
   mutable io::fd fd_;
   tsfile_mimeheader mime_;
   tsfile_header hdr_;
+  io::mmap_view map_; // Empty if segments are to be read using fd_.
+  mutable segment_readahead readahead_; // Only used if map_ is empty.
 };
 
 
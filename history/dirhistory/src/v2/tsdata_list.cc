@@ -7,13 +7,22 @@
 #include <objpipe/of.h>
 #include <objpipe/array.h>
 #include <algorithm>
+#include <iterator>
+#include <stack>
+#include <tuple>
 
 namespace monsoon {
 namespace history {
 namespace v2 {
 
 
-tsdata_v2_list::~tsdata_v2_list() noexcept {}
+tsdata_v2_list::~tsdata_v2_list() noexcept {
+  try {
+    sync_(true);
+  } catch (...) {
+    // Appends since the last sync are lost.
+  }
+}
 
 bool tsdata_v2_list::is_writable() const noexcept {
   return fd().can_write();
@@ -24,22 +33,134 @@ auto tsdata_v2_list::read_() const
   return get_dynamics_cache<tsdata_xdr>(shared_from_this(), fdt());
 }
 
-std::vector<time_series> tsdata_v2_list::read_all_raw_() const {
-  std::vector<std::shared_ptr<const tsdata_xdr>> records;
-  for (auto ptr = read_();
-      ptr != nullptr;
-      ptr = ptr->get_predecessor())
-    records.push_back(ptr);
-
-  if (!is_sorted()) {
-    std::stable_sort(
-        records.begin(), records.end(),
-        [](const auto& x_ptr, const auto& y_ptr) {
-          return x_ptr->ts() > y_ptr->ts();
+auto tsdata_v2_list::read_(const file_segment_ptr& ptr) const
+-> std::shared_ptr<const tsdata_xdr> {
+  return get_dynamics_cache<tsdata_xdr>(shared_from_this(), ptr);
+}
+
+auto tsdata_v2_list::time_index_lookup_(
+    std::optional<time_point> tr_begin,
+    std::optional<time_point> tr_end) const
+-> time_index {
+  std::unique_lock<std::mutex> lck{ time_index_mtx_ };
+
+  // Walk back over all records added since the last update of the index.
+  // Records are read without holding the lock.
+  for (file_segment_ptr head_ptr = fdt();
+      head_ptr != time_index_head_;
+      head_ptr = fdt()) {
+    const file_segment_ptr stop = time_index_head_;
+    lck.unlock();
+
+    time_index added;
+    for (file_segment_ptr ptr = head_ptr;
+        ptr != stop && ptr != file_segment_ptr();) {
+      const std::shared_ptr<const tsdata_xdr> xdr = read_(ptr);
+      added.push_back({ xdr->ts(), ptr });
+      ptr = xdr->predecessor_ptr();
+    }
+
+    lck.lock();
+    // If another lookup updated the index in the mean time, start over.
+    if (time_index_head_ != stop) continue;
+
+    // Added records are in reverse file order.
+    std::for_each(
+        added.rbegin(), added.rend(),
+        [this](const time_index_entry& e) {
+          if (time_index_.empty() || time_index_.back().ts <= e.ts) {
+            time_index_.push_back(e);
+          } else {
+            time_index_.insert(
+                std::upper_bound(
+                    time_index_.begin(), time_index_.end(),
+                    e.ts,
+                    [](const time_point& x, const time_index_entry& y) {
+                      return x < y.ts;
+                    }),
+                e);
+          }
+        });
+    time_index_head_ = head_ptr;
+  }
+
+  auto b = time_index_.begin();
+  auto e = time_index_.end();
+  if (tr_begin.has_value()) {
+    b = std::lower_bound(
+        b, e,
+        *tr_begin,
+        [](const time_index_entry& x, const time_point& y) {
+          return x.ts < y;
+        });
+  }
+  if (tr_end.has_value()) {
+    e = std::upper_bound(
+        b, e,
+        *tr_end,
+        [](const time_point& x, const time_index_entry& y) {
+          return x < y.ts;
         });
   }
+  return time_index(b, e);
+}
+
+auto tsdata_v2_list::dictionary_() const
+-> std::shared_ptr<const dictionary> {
+  std::unique_lock<std::mutex> lck{ dict_mtx_ };
+
+  // Apply the updates of all records added since the dictionary was built.
+  // Records are read and decoded without holding the lock.
+  for (file_segment_ptr head_ptr = fdt();
+      head_ptr != dict_head_;
+      head_ptr = fdt()) {
+    const file_segment_ptr stop = dict_head_;
+    const std::shared_ptr<const dictionary> base = dict_;
+    lck.unlock();
+
+    std::stack<file_segment_ptr> updates;
+    for (file_segment_ptr ptr = head_ptr;
+        ptr != stop && ptr != file_segment_ptr();) {
+      const std::shared_ptr<const tsdata_xdr> xdr = read_(ptr);
+      if (xdr->dictionary_ptr() != file_segment_ptr())
+        updates.push(xdr->dictionary_ptr());
+      ptr = xdr->predecessor_ptr();
+    }
+
+    // Readers may still be using the previous dictionary, so update a copy.
+    auto result = std::make_shared<dictionary>();
+    if (base != nullptr) *result = *base;
+    while (!updates.empty()) {
+      auto xdr = get_ctx().new_reader(updates.top(), dictionary::is_compressed);
+      updates.pop();
+      result->decode_update(xdr);
+      if (!xdr.at_end()) throw dirhistory_exception("xdr data remaining");
+      xdr.close();
+    }
+
+    lck.lock();
+    // If another lookup updated the dictionary in the mean time, start over.
+    if (dict_head_ != stop) continue;
+    dict_ = std::move(result);
+    dict_head_ = head_ptr;
+  }
+
+  return dict_;
+}
+
+std::vector<time_series> tsdata_v2_list::read_all_raw_() const {
+  const time_index idx = time_index_lookup_(std::nullopt, std::nullopt);
+
+  std::vector<std::shared_ptr<const tsdata_xdr>> records;
+  records.reserve(idx.size());
+  std::transform(
+      idx.begin(), idx.end(),
+      std::back_inserter(records),
+      [this](const time_index_entry& e) {
+        return read_(e.ptr);
+      });
 
-  auto pipe = objpipe::new_array(records.rbegin(), records.rend())
+  auto pipe = objpipe::new_array(records.begin(), records.end())
       .transform(
           [](std::shared_ptr<const tsdata_xdr> tsd) -> time_series {
             time_series::tsv_set data;
@@ -102,27 +223,57 @@ std::vector<time_series> tsdata_v2_list::read_all_raw_() const {
 }
 
 void tsdata_v2_list::push_back(const time_series& ts) {
+  std::lock_guard<std::mutex> lck{ writer_mtx_ };
   encdec_writer out = encdec_writer(get_ctx(), hdr_file_size());
 
-  dictionary_delta dict;
   std::optional<file_segment_ptr> tsdata_pred;
-  if (fdt() != file_segment_ptr()) {
-    dict = *read_()->get_dictionary();
-    tsdata_pred = fdt();
-  }
-  assert(!dict.update_pending());
-
-  const file_segment_ptr tsfile_ptr =
-      encode_tsdata(out, ts, std::move(dict), std::move(tsdata_pred));
+  if (fdt() != file_segment_ptr()) tsdata_pred = fdt();
 
-  out.ctx().fd().flush();
-  update_hdr(ts.get_time(), ts.get_time(), tsfile_ptr, out.offset());
+  // Load the dictionary once; afterwards it is maintained in memory.
+  if (!writer_dict_.has_value()) {
+    writer_dict_.emplace();
+    if (tsdata_pred.has_value()) *writer_dict_ = *read_()->get_dictionary();
+  }
+  assert(!writer_dict_->update_pending());
+
+  try {
+    const file_segment_ptr tsfile_ptr =
+        encode_tsdata(out, ts, *writer_dict_, std::move(tsdata_pred));
+
+    update_hdr(ts.get_time(), ts.get_time(), tsfile_ptr, out.offset());
+    hdr_pending_ = true;
+    if (sync_on_push_back_) sync_(true);
+  } catch (...) {
+    // The in-memory dictionary may no longer match the file.
+    writer_dict_.reset();
+    throw;
+  }
 }
 
 void tsdata_v2_list::push_back(const emit_type& c) {
   push_back(make_time_series(c));
 }
 
+void tsdata_v2_list::set_sync_on_push_back(bool enable) {
+  std::lock_guard<std::mutex> lck{ writer_mtx_ };
+  sync_on_push_back_ = enable;
+  if (enable) sync_(true);
+}
+
+void tsdata_v2_list::sync(bool durable) {
+  std::lock_guard<std::mutex> lck{ writer_mtx_ };
+  sync_(durable);
+}
+
+void tsdata_v2_list::sync_(bool durable) {
+  if (!hdr_pending_) return;
+
+  // Data must be on disk before the header refers to it.
+  if (durable) fd().flush();
+  write_hdr(durable);
+  hdr_pending_ = false;
+}
+
 auto tsdata_v2_list::emit(
     std::optional<time_point> tr_begin, std::optional<time_point> tr_end,
     const path_matcher& group_filter,
@@ -133,34 +284,48 @@ auto tsdata_v2_list::emit(
 
   return objpipe::new_callback<emit_type>(
       [self, tr_begin, tr_end, group_filter, tag_filter, metric_filter](auto& cb) {
-        std::vector<std::shared_ptr<const tsdata_xdr>> xdr_list;
+        const time_index idx = self->time_index_lookup_(tr_begin, tr_end);
+        // All records share the dictionary of the most recent record, so matches can be shared.
+        metric_filter_cache metric_matches{ metric_filter };
 
-        std::shared_ptr<const tsdata_xdr> ptr = self->read_();
-        while (ptr != nullptr) {
-          if ((!tr_begin.has_value() || ptr->ts() >= *tr_begin)
-              && (!tr_end.has_value() || ptr->ts() <= *tr_end))
-            xdr_list.push_back(ptr);
-          ptr = ptr->get_predecessor();
-        }
+        const encdec_ctx ctx = self->get_ctx();
 
-        std::reverse(xdr_list.begin(), xdr_list.end());
-        if (!self->is_sorted()) {
-          std::stable_sort(
-              xdr_list.begin(), xdr_list.end(),
-              [](const auto& x_ptr, const auto& y_ptr) {
-                return x_ptr->ts() > y_ptr->ts();
-              });
+        std::vector<file_segment_ptr> segments;
+        segments.reserve(idx.size());
+        std::transform(
+            idx.begin(), idx.end(),
+            std::back_inserter(segments),
+            [](const time_index_entry& e) { return e.ptr; });
+
+        std::vector<std::shared_ptr<const tsdata_xdr>> xdr_list;
+        xdr_list.reserve(idx.size());
+        {
+          readahead_cursor ahead = ctx.readahead(std::move(segments));
+          for (std::size_t i = 0; i < idx.size(); ++i) {
+            ahead.advance(i);
+            xdr_list.push_back(self->read_(idx[i].ptr));
+          }
         }
 
+        // Read the record arrays ahead of emitting them.
+        segments.clear();
+        std::transform(
+            xdr_list.begin(), xdr_list.end(),
+            std::back_inserter(segments),
+            [](const std::shared_ptr<const tsdata_xdr>& xdr) { return xdr->records_ptr(); });
+        readahead_cursor records_ahead = ctx.readahead(std::move(segments));
+
         emit_type emit;
         if (self->is_distinct()) {
-          for (const std::shared_ptr<const tsdata_xdr>& ptr : xdr_list) {
+          for (std::size_t i = 0; i < xdr_list.size(); ++i) {
+            const std::shared_ptr<const tsdata_xdr>& ptr = xdr_list[i];
+            records_ahead.advance(i);
             std::get<0>(emit) = ptr->ts();
             auto& emit_map = std::get<1>(emit);
 
             std::shared_ptr<const record_array> ra_ptr = ptr->get();
             for (const record_array::value_type& ra_proxy : ra_ptr->filter(group_filter, tag_filter)) {
-              for (const record_metrics::value_type& rm_proxy : *ra_proxy) {
+              for (const record_metrics::value_type& rm_proxy : (*ra_proxy).filter(metric_matches)) {
                 emit_map.emplace(
                     std::piecewise_construct,
                     std::forward_as_tuple(ra_proxy.name(), rm_proxy.name()),
@@ -174,12 +339,13 @@ auto tsdata_v2_list::emit(
           // Local scope to fill first element in emit.
           {
             const std::shared_ptr<const tsdata_xdr>& ptr = xdr_list.front();
+            records_ahead.advance(0);
             std::get<0>(emit) = ptr->ts();
             auto& emit_map = std::get<1>(emit);
 
             std::shared_ptr<const record_array> ra_ptr = ptr->get();
             for (const record_array::value_type& ra_proxy : ra_ptr->filter(group_filter, tag_filter)) {
-              for (const record_metrics::value_type& rm_proxy : *ra_proxy) {
+              for (const record_metrics::value_type& rm_proxy : (*ra_proxy).filter(metric_matches)) {
                 emit_map.emplace(
                     std::piecewise_construct,
                     std::forward_as_tuple(ra_proxy.name(), rm_proxy.name()),
@@ -193,6 +359,7 @@ auto tsdata_v2_list::emit(
               xdr_iter != xdr_end;
               ++xdr_iter) {
             const std::shared_ptr<const tsdata_xdr>& ptr = *xdr_iter;
+            records_ahead.advance(xdr_iter - xdr_list.begin());
             if (std::get<0>(emit) != ptr->ts()) {
               cb(std::move(emit));
               std::get<0>(emit) = ptr->ts();
@@ -202,7 +369,7 @@ auto tsdata_v2_list::emit(
 
             std::shared_ptr<const record_array> ra_ptr = ptr->get();
             for (const record_array::value_type& ra_proxy : ra_ptr->filter(group_filter, tag_filter)) {
-              for (const record_metrics::value_type& rm_proxy : *ra_proxy) {
+              for (const record_metrics::value_type& rm_proxy : (*ra_proxy).filter(metric_matches)) {
 #if __cplusplus >= 201703
                 emit_map.insert_or_assign(
                     std::forward_as_tuple(ra_proxy.name(), rm_proxy.name()),
@@ -233,23 +400,19 @@ auto tsdata_v2_list::emit_time(
   return objpipe::of(shared_from_this())
       .transform(
           [tr_begin, tr_end](std::shared_ptr<const tsdata_v2_list> list) {
-            std::vector<time_point> xdr_list;
+            const time_index idx = list->time_index_lookup_(tr_begin, tr_end);
 
-            std::shared_ptr<const tsdata_xdr> ptr = list->read_();
-            while (ptr != nullptr) {
-              if ((!tr_begin.has_value() || ptr->ts() >= *tr_begin)
-                  && (!tr_end.has_value() || ptr->ts() <= *tr_end))
-                xdr_list.push_back(ptr->ts());
-              ptr = ptr->get_predecessor();
-            }
-
-            std::reverse(xdr_list.begin(), xdr_list.end());
-            if (!list->is_sorted()) {
-              std::sort(xdr_list.begin(), xdr_list.end());
-            }
+            std::vector<time_point> xdr_list;
+            xdr_list.reserve(idx.size());
+            std::transform(
+                idx.begin(), idx.end(),
+                std::back_inserter(xdr_list),
+                [](const time_index_entry& e) { return e.ts; });
 
             if (!list->is_distinct()) {
-              std::unique(xdr_list.begin(), xdr_list.end());
+              xdr_list.erase(
+                  std::unique(xdr_list.begin(), xdr_list.end()),
+                  xdr_list.end());
             }
 
             return xdr_list;
@@ -257,5 +420,4 @@ auto tsdata_v2_list::emit_time(
       .iterate();
 }
 
-
 }}} /* namespace monsoon::history::v2 */
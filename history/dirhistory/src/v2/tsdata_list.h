@@ -4,6 +4,11 @@
 #include <monsoon/history/dir/dirhistory_export_.h>
 #include <monsoon/xdr/xdr.h>
 #include <monsoon/time_point.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
 #include "encdec.h"
 #include "tsdata.h"
 
@@ -16,6 +21,8 @@ class monsoon_dirhistory_local_ tsdata_v2_list
 : public tsdata_v2,
   public std::enable_shared_from_this<tsdata_v2_list>
 {
+  friend tsdata_xdr;
+
  public:
   tsdata_v2_list(io::fd&& fd, const tsfile_mimeheader& mime, const tsfile_header& hdr)
   : tsdata_v2(std::move(fd), mime, hdr)
@@ -26,6 +33,8 @@ class monsoon_dirhistory_local_ tsdata_v2_list
   bool is_writable() const noexcept override;
   void push_back(const time_series&);
   void push_back(const emit_type&) override;
+  void set_sync_on_push_back(bool) override;
+  void sync(bool) override;
 
   auto emit(
       std::optional<time_point>,
@@ -41,7 +50,30 @@ class monsoon_dirhistory_local_ tsdata_v2_list
   -> objpipe::reader<time_point> override;
 
  private:
+  ///\brief Entry in the time index.
+  struct time_index_entry {
+    time_point ts;
+    file_segment_ptr ptr;
+  };
+  using time_index = std::vector<time_index_entry>;
+
   auto read_() const -> std::shared_ptr<tsdata_xdr>;
+  ///\brief Read the record at \p ptr.
+  ///\details Records are cached on the file, so appends don't invalidate them.
+  auto read_(const file_segment_ptr& ptr) const -> std::shared_ptr<const tsdata_xdr>;
+  ///\brief Look up all records in the given time range.
+  ///\details Updates the time index if records were added since the last lookup.
+  ///\returns The selected index entries,
+  ///ordered by time (records with equal time are kept in file order).
+  auto time_index_lookup_(
+      std::optional<time_point> tr_begin,
+      std::optional<time_point> tr_end) const
+  -> time_index;
+  ///\brief Dictionary of the most recent record.
+  ///\details Dictionaries only grow, so this dictionary covers all records.
+  ///If records were added since the last lookup,
+  ///their updates are applied to a copy of the previous dictionary.
+  auto dictionary_() const -> std::shared_ptr<const dictionary>;
   std::vector<time_series> read_all_raw_() const override;
 
   template<typename Callback>
@@ -76,6 +108,34 @@ class monsoon_dirhistory_local_ tsdata_v2_list
 
   template<typename Fn>
   void visit(Fn) const;
+
+  ///\brief Protects time_index_ and time_index_head_.
+  mutable std::mutex time_index_mtx_;
+  ///\brief Timestamp and location of each record, ordered by time.
+  mutable time_index time_index_;
+  ///\brief Most recent record included in time_index_.
+  mutable file_segment_ptr time_index_head_;
+
+  ///\brief Protects dict_ and dict_head_.
+  mutable std::mutex dict_mtx_;
+  ///\brief Dictionary of dict_head_, shared with readers, so never modified.
+  mutable std::shared_ptr<const dictionary> dict_;
+  ///\brief Most recent record included in dict_.
+  mutable file_segment_ptr dict_head_;
+
+  ///\brief Write the header, if it has pending updates.
+  ///\note Must be called with writer_mtx_ held.
+  void sync_(bool durable);
+
+  ///\brief Protects writer_dict_, the sync state and serializes push_back.
+  std::mutex writer_mtx_;
+  ///\brief If set, push_back makes the appended data durable.
+  bool sync_on_push_back_ = true;
+  ///\brief Set if the header in the file is older than the header in memory.
+  bool hdr_pending_ = false;
+  ///\brief Dictionary as written to the file, loaded on first push_back.
+  ///\details Only entries added since the last push_back are encoded.
+  std::optional<dictionary_delta> writer_dict_;
 };
 
 
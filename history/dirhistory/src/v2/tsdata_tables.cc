@@ -1,6 +1,12 @@
 #include "tsdata_tables.h"
 #include "encdec.h"
+#include "../raw_file_segment_writer.h"
+#include <cassert>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include <monsoon/group_name.h>
 #include <monsoon/metric_name.h>
@@ -20,12 +26,16 @@
 #include <instrumentation/time_track.h>
 #include <instrumentation/counter.h>
 #include <string_view>
+#include <monsoon/xdr/xdr_stream.h>
+#include "bitset.h"
+#include "dictionary.h"
 #include "timestamp_delta.h"
 #include "group_table.h"
 #include "metric_table.h"
 #include "tables.h"
 #include "file_data_tables_block.h"
 #include "file_data_tables.h"
+#include "decode_pool.h"
 
 namespace monsoon {
 namespace history {
@@ -118,6 +128,244 @@ void tsdata_v2_tables::push_back(const emit_type&) {
 namespace {
 
 
+/**
+ * \brief Accumulates the data for a single file_data_tables_block.
+ *
+ * Timestamps in a block are strictly ascending,
+ * and close enough together to be delta encoded.
+ */
+class tables_block_builder {
+ public:
+  using column = std::vector<std::optional<metric_value>>;
+
+  struct group_data {
+    bitset presence;
+    std::unordered_map<metric_name, column> metrics;
+  };
+
+  ///\brief Maximum number of timestamps in a block.
+  static constexpr std::size_t max_size = 256;
+
+  auto empty() const noexcept -> bool { return timestamps_.empty(); }
+  auto size() const noexcept -> std::size_t { return timestamps_.size(); }
+
+  ///\brief Test if the given time point can be appended to this block.
+  auto accepts(time_point tp) const noexcept -> bool {
+    if (empty()) return true;
+    if (size() >= max_size) return false;
+
+    const std::int64_t delta = tp.millis_since_posix_epoch()
+        - timestamps_.back().millis_since_posix_epoch();
+    return delta > 0 && delta <= 0x7fffffff;
+  }
+
+  auto push_back(const time_series& ts) -> void {
+    assert(accepts(ts.get_time()));
+
+    const std::size_t idx = timestamps_.size();
+    timestamps_.push_back(ts.get_time());
+    for (const time_series_value& tsv : ts.get_data()) {
+      // Groups are recorded as present, even if they have no metrics.
+      group_data& grp = groups_[tsv.get_name()];
+      grp.presence.resize(idx + 1u, false);
+      grp.presence.back() = true;
+
+      for (const auto& metric_entry : tsv.get_metrics()) {
+        column& c = grp.metrics[metric_entry.first];
+        c.resize(idx + 1u);
+        c.back().emplace(metric_entry.second);
+      }
+    }
+  }
+
+  auto push_back(const tsdata_v2_tables::emit_type& e) -> void {
+    assert(accepts(std::get<0>(e)));
+
+    const std::size_t idx = timestamps_.size();
+    timestamps_.push_back(std::get<0>(e));
+    for (const auto& entry : std::get<1>(e)) {
+      group_data& grp = groups_[std::get<0>(entry.first)];
+      grp.presence.resize(idx + 1u, false);
+      grp.presence.back() = true;
+
+      column& c = grp.metrics[std::get<1>(entry.first)];
+      c.resize(idx + 1u);
+      c.back().emplace(entry.second);
+    }
+  }
+
+  /**
+   * \brief Write the block data to the file.
+   * \returns The encoded block header, for inclusion in the file_data_tables.
+   */
+  auto write(encdec_writer& out) const
+  -> std::tuple<timestamp_delta, file_segment_ptr, file_segment_ptr> {
+    dictionary dict;
+
+    std::unordered_map<
+        std::uint32_t,
+        std::vector<std::tuple<std::uint32_t, file_segment_ptr>>> tbl;
+    for (const auto& grp_entry : groups_) {
+      const group_name& gname = grp_entry.first;
+      const group_data& grp = grp_entry.second;
+
+      std::vector<std::tuple<std::uint32_t, file_segment_ptr>> metrics;
+      metrics.reserve(grp.metrics.size());
+      for (const auto& metric_entry : grp.metrics) {
+        auto xdr = out.begin(metric_table::is_compressed);
+        encode_metric_table(xdr, metric_entry.second, dict.sdd(), out.ctx().minor_version());
+        xdr.close();
+        metrics.emplace_back(dict.pdd()[metric_entry.first], xdr.ptr());
+      }
+
+      bitset presence = grp.presence;
+      presence.resize(size(), false);
+
+      auto xdr = out.begin(group_table::is_compressed);
+      presence.encode(xdr);
+      xdr.put_collection(
+          [](xdr::xdr_ostream& out, const auto& m) {
+            out.put_uint32(std::get<0>(m));
+            std::get<1>(m).encode(out);
+          },
+          metrics.begin(), metrics.end());
+      xdr.close();
+      tbl[dict.pdd()[gname.get_path()]].emplace_back(
+          dict.tdd()[gname.get_tags()],
+          xdr.ptr());
+    }
+
+    auto tables_xdr = out.begin(tables::is_compressed);
+    tables_xdr.put_collection(
+        [](xdr::xdr_ostream& out, const auto& grp_entry) {
+          out.put_uint32(grp_entry.first);
+          out.put_collection(
+              [](xdr::xdr_ostream& out, const auto& tag_entry) {
+                out.put_uint32(std::get<0>(tag_entry));
+                std::get<1>(tag_entry).encode(out);
+              },
+              grp_entry.second.begin(), grp_entry.second.end());
+        },
+        tbl.begin(), tbl.end());
+    tables_xdr.close();
+
+    // Dictionary is written last, since encoding the tables populates it.
+    auto dict_xdr = out.begin(dictionary::is_compressed);
+    dict.encode_update(dict_xdr);
+    dict_xdr.close();
+
+    return std::make_tuple(timestamps_, dict_xdr.ptr(), tables_xdr.ptr());
+  }
+
+ private:
+  timestamp_delta timestamps_;
+  std::unordered_map<group_name, group_data> groups_;
+};
+
+
+auto entry_time_(const tsdata_v2_tables::emit_type& e) -> time_point {
+  return std::get<0>(e);
+}
+
+auto entry_time_(const time_series& ts) -> time_point {
+  return ts.get_time();
+}
+
+
+} /* namespace <monsoon::history::v2::<unnamed> */
+
+auto tsdata_v2_tables::new_file(io::fd&& fd, objpipe::reader<emit_type> data,
+    compression_type compression)
+-> std::shared_ptr<tsdata_v2_tables> {
+  return new_file_(
+      std::move(fd),
+      [&data](auto&& fn) { std::move(data).for_each(std::forward<decltype(fn)>(fn)); },
+      compression);
+}
+
+auto tsdata_v2_tables::new_file(io::fd&& fd, const std::vector<time_series>& data,
+    compression_type compression)
+-> std::shared_ptr<tsdata_v2_tables> {
+  return new_file_(
+      std::move(fd),
+      [&data](auto&& fn) { std::for_each(data.begin(), data.end(), std::forward<decltype(fn)>(fn)); },
+      compression);
+}
+
+template<typename ForEach>
+auto tsdata_v2_tables::new_file_(io::fd&& fd, ForEach&& for_each,
+    compression_type compression)
+-> std::shared_ptr<tsdata_v2_tables> {
+  constexpr auto HDR_LEN =
+      tsfile_mimeheader::XDR_ENCODED_LEN + tsfile_header::XDR_SIZE;
+  constexpr auto CHECKSUMMED_HDR_LEN =
+      HDR_LEN + 4u;
+
+  tsfile_header hdr;
+  hdr.flags = (header_flags::KIND_TABLES
+      | compression_flags(compression)
+      | header_flags::SORTED
+      | header_flags::DISTINCT);
+  encdec_writer out = encdec_writer(encdec_ctx(fd, hdr.flags, MAX_MINOR), CHECKSUMMED_HDR_LEN);
+
+  std::vector<std::tuple<timestamp_delta, file_segment_ptr, file_segment_ptr>> blocks;
+  tables_block_builder block;
+  std::optional<time_point> last;
+  for_each(
+      [&](const auto& e) {
+        const time_point tp = entry_time_(e);
+        if (!last.has_value()) {
+          hdr.first = hdr.last = tp;
+        } else {
+          if (tp < *last) hdr.flags &= ~header_flags::SORTED;
+          if (tp <= *last) hdr.flags &= ~header_flags::DISTINCT;
+          if (tp < hdr.first) hdr.first = tp;
+          if (tp > hdr.last) hdr.last = tp;
+        }
+        last = tp;
+
+        if (!block.accepts(tp)) {
+          blocks.push_back(block.write(out));
+          block = tables_block_builder();
+        }
+        block.push_back(e);
+      });
+  if (!block.empty()) blocks.push_back(block.write(out));
+  if (!last.has_value()) hdr.first = hdr.last = time_point::now();
+
+  auto fdt_xdr = out.begin(file_data_tables::is_compressed);
+  fdt_xdr.put_collection(
+      [](xdr::xdr_ostream& out, const auto& b) {
+        std::get<0>(b).encode(out);
+        std::get<1>(b).encode(out);
+        std::get<2>(b).encode(out);
+      },
+      blocks.begin(), blocks.end());
+  fdt_xdr.close();
+  hdr.fdt = fdt_xdr.ptr();
+  hdr.file_size = out.offset();
+
+  // Ensure all data is on disk, before making the file valid.
+  fd.flush();
+
+  const tsfile_mimeheader mime = tsfile_mimeheader(MAJOR, MAX_MINOR);
+  io::fd::size_type data_len, storage_len;
+  auto xdr = xdr::xdr_stream_writer<raw_file_segment_writer>(
+      raw_file_segment_writer(fd, 0, &data_len, &storage_len));
+  mime.write(xdr);
+  hdr.encode(xdr);
+  xdr.close();
+  fd.flush();
+
+  assert(data_len == HDR_LEN);
+  assert(storage_len == CHECKSUMMED_HDR_LEN);
+
+  return std::make_shared<tsdata_v2_tables>(std::move(fd), mime, hdr);
+}
+
+namespace {
+
+
 instrumentation::timing tsdata_v2_tables_decode_timing(
     instrumentation::timing::cumulative(
         "monsoon.dirhistory.decode",
@@ -161,51 +409,104 @@ auto emit_type_merge = [](tsdata_v2_tables::emit_type&& x, tsdata_v2_tables::emi
   return std::move(x);
 };
 
-auto emit_fdtblock_pipe(
+///\brief Test if any timestamp in the block falls within the time range.
+///\details Only uses the block timestamps, so no tables are decoded.
+auto block_intersects(
+    const file_data_tables_block& block,
+    std::optional<time_point> tr_begin, std::optional<time_point> tr_end)
+noexcept
+-> bool {
+  const auto block_time = block.time();
+  if (!block_time.has_value()) return false;
+
+  return (!tr_begin.has_value() || std::get<1>(*block_time) >= *tr_begin)
+      && (!tr_end.has_value() || std::get<0>(*block_time) <= *tr_end);
+}
+
+/**
+ * \brief Advances a readahead_cursor as concurrent decodes complete.
+ *
+ * \details
+ * decode_pool::for_each_index starts indices in order, but they complete
+ * out of order. Segments are released up to the lowest index that has
+ * not completed, so no worker loses a segment it has yet to take.
+ */
+class readahead_completion {
+ public:
+  readahead_completion(readahead_cursor& ahead, std::size_t n)
+  : ahead_(ahead),
+    completed_(n, false)
+  {}
+
+  ///\brief Mark index \p i as completed.
+  void complete(std::size_t i) noexcept {
+    std::size_t low;
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      completed_[i] = true;
+      while (low_ < completed_.size() && completed_[low_]) ++low_;
+      low = low_;
+    }
+    ahead_.advance(low);
+  }
+
+ private:
+  readahead_cursor& ahead_;
+  std::mutex mtx_; // Protects everything below.
+  std::vector<bool> completed_;
+  std::size_t low_ = 0;
+};
+
+///\brief A selected metric column of a block.
+struct fdtblock_column {
+  group_name group;
+  metric_name metric;
+  std::shared_ptr<const metric_table> values;
+};
+
+///\brief Transpose the metric columns of a block into one emit per timestamp.
+///\details All columns are walked in lockstep,
+///so each emitted map is built exactly once.
+auto emit_fdtblock_transpose(
     std::optional<time_point> tr_begin,
     std::optional<time_point> tr_end,
-    std::shared_ptr<const std::vector<time_point>> time_points_ptr,
-    group_name group_name_ptr,
-    metric_name metric_name_ptr,
-    std::shared_ptr<const metric_table> mv_column_ptr)
+    std::shared_ptr<const timestamp_delta> time_points_ptr,
+    std::shared_ptr<const std::vector<fdtblock_column>> columns_ptr)
 -> decltype(auto) {
   using emit_type = tsdata_v2_tables::emit_type;
 
   return objpipe::new_callback<emit_type>(
       [=](auto cb) {
         instrumentation::time_track<instrumentation::timing> tt{ tsdata_v2_tables_decode_timing };
-        auto tp_iter = time_points_ptr->begin();
-        auto mv_iter = mv_column_ptr->begin();
+        const timestamp_delta& time_points = *time_points_ptr;
+        const std::vector<fdtblock_column>& columns = *columns_ptr;
 
-        for (;
-            tp_iter != time_points_ptr->end() && mv_iter != mv_column_ptr->end();
-            ++tp_iter, ++mv_iter) {
-          if (tr_begin.has_value() && *tp_iter < *tr_begin)
+        for (timestamp_delta::size_type i = 0; i < time_points.size(); ++i) {
+          if (tr_begin.has_value() && time_points[i] < *tr_begin)
             continue;
-          if (tr_end.has_value() && *tp_iter > *tr_end)
+          if (tr_end.has_value() && time_points[i] > *tr_end)
             continue;
 
-          if (mv_iter->has_value()) {
-            std::tuple_element_t<1, emit_type> map;
-            map.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(group_name_ptr, metric_name_ptr),
-                std::forward_as_tuple(**mv_iter));
-            tt.do_untracked(cb, emit_type(*tp_iter, std::move(map)));
+          std::tuple_element_t<1, emit_type> map;
+          map.reserve(columns.size());
+          for (const fdtblock_column& column : columns) {
+            if (i >= column.values->size()) continue;
+
+            const metric_table::value_type& mv = column.values->begin()[i];
+            if (mv.has_value()) {
+              map.emplace(
+                  std::piecewise_construct,
+                  std::forward_as_tuple(column.group, column.metric),
+                  std::forward_as_tuple(*mv));
+            }
           }
+
+          if (!map.empty())
+            tt.do_untracked(cb, emit_type(time_points[i], std::move(map)));
         }
       });
 }
 
-using emit_fdtblock_pipe_t = decltype(
-    emit_fdtblock_pipe(
-        std::declval<std::optional<time_point>>(),
-        std::declval<std::optional<time_point>>(),
-        std::declval<std::shared_ptr<const std::vector<time_point>>>(),
-        std::declval<group_name>(),
-        std::declval<metric_name>(),
-        std::declval<std::shared_ptr<const metric_table>>()));
-
 auto emit_fdtblock(
     std::shared_ptr<const file_data_tables_block> block,
     std::optional<time_point> tr_begin, std::optional<time_point> tr_end,
@@ -213,35 +514,76 @@ auto emit_fdtblock(
     const tag_matcher& tag_filter,
     const path_matcher& metric_filter)
 -> decltype(auto) {
-  using emit_type = tsdata_v2_tables::emit_type;
+  // Drop range bounds that the entire block satisfies.
+  if (const auto block_time = block->time(); block_time.has_value()) {
+    if (tr_begin.has_value() && std::get<0>(*block_time) >= *tr_begin)
+      tr_begin.reset();
+    if (tr_end.has_value() && std::get<1>(*block_time) <= *tr_end)
+      tr_end.reset();
+  }
 
   auto time_points_ptr = std::shared_ptr<const timestamp_delta>(block, &block->timestamps());
   const std::shared_ptr<const tables> tbl_ptr = block->get();
+  const encdec_ctx ctx = block->get_ctx();
 
-  std::vector<emit_fdtblock_pipe_t> columns;
+  // Select group tables, and read them ahead of decoding.
+  std::vector<tables::proxy> groups;
+  std::vector<file_segment_ptr> segments;
   for (const auto& tbl_entry : tbl_ptr->filter(group_filter, tag_filter)) {
-    auto group_name_ptr = tbl_entry.name();
-    auto group_table_ptr = tbl_entry.get();
+    groups.push_back(tbl_entry);
+    segments.push_back(tbl_entry.fptr());
+  }
 
-    for (const auto& mv_map_entry : group_table_ptr->filter(metric_filter)) {
-      const auto& metric_name_ptr = mv_map_entry.name();
+  // Decode the selected group tables concurrently.
+  decode_pool& pool = decode_pool::instance();
+  std::vector<std::shared_ptr<const group_table>> group_tables(groups.size());
+  {
+    readahead_cursor ahead = ctx.readahead(std::move(segments));
+    readahead_completion completion{ ahead, groups.size() };
+    pool.for_each_index(
+        groups.size(),
+        [&](std::size_t i) {
+          group_tables[i] = groups[i].get();
+          completion.complete(i);
+        });
+  }
 
-      std::shared_ptr<const metric_table> mv_column_ptr = mv_map_entry.get();
+  std::vector<std::tuple<group_name, group_table::proxy>> metrics;
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    const group_name group_name_ptr = groups[i].name();
+    for (const auto& mv_map_entry : group_tables[i]->filter(metric_filter))
+      metrics.emplace_back(group_name_ptr, mv_map_entry);
+  }
 
-      columns.emplace_back(
-          emit_fdtblock_pipe(
-              tr_begin, tr_end,
-              time_points_ptr,
-              group_name_ptr,
-              metric_name_ptr,
-              mv_column_ptr));
-    }
+  // Read the selected metric tables ahead of decoding.
+  segments.clear();
+  std::transform(
+      metrics.begin(), metrics.end(),
+      std::back_inserter(segments),
+      [](const auto& m) { return std::get<1>(m).fptr(); });
+  readahead_cursor ahead = ctx.readahead(std::move(segments));
+  readahead_completion completion{ ahead, metrics.size() };
+
+  // Decode the metric tables concurrently, keeping columns in selection order.
+  std::vector<std::shared_ptr<const metric_table>> metric_tables(metrics.size());
+  pool.for_each_index(
+      metrics.size(),
+      [&](std::size_t i) {
+        metric_tables[i] = std::get<1>(metrics[i]).get();
+        completion.complete(i);
+      });
+
+  auto columns = std::make_shared<std::vector<fdtblock_column>>();
+  columns->reserve(metrics.size());
+  for (std::size_t i = 0; i < metrics.size(); ++i) {
+    const auto& [group_name_ptr, mv_map_entry] = metrics[i];
+    columns->push_back({ group_name_ptr, mv_map_entry.name(), std::move(metric_tables[i]) });
   }
 
-  return objpipe::merge_combine(
-      std::make_move_iterator(columns.begin()), std::make_move_iterator(columns.end()),
-      emit_type_less,
-      emit_type_merge);
+  return emit_fdtblock_transpose(
+      tr_begin, tr_end,
+      std::move(time_points_ptr),
+      std::move(columns));
 }
 
 using emit_fdtblock_t = decltype(
@@ -268,9 +610,20 @@ auto tsdata_v2_tables::emit(
 
   auto block_chain = objpipe::new_callback<emit_fdtblock_t>(
       [file_data_tables, tr_begin, tr_end, group_filter, tag_filter, metric_filter](auto cb) {
+        std::vector<std::shared_ptr<const file_data_tables_block>> blocks;
+        std::vector<file_segment_ptr> segments; // Dictionary and tables of each block.
         for (const auto& block : *file_data_tables) {
+          if (!block_intersects(*block, tr_begin, tr_end)) continue;
+          blocks.push_back(block);
+          segments.push_back(block->dictionary_ptr());
+          segments.push_back(block->tables_ptr());
+        }
+
+        readahead_cursor ahead = file_data_tables->get_ctx().readahead(std::move(segments));
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+          ahead.advance(2u * i);
           cb(emit_fdtblock(
-                  block,
+                  blocks[i],
                   tr_begin, tr_end, group_filter, tag_filter, metric_filter));
         }
       });
@@ -311,6 +664,7 @@ auto tsdata_v2_tables::emit_time(
     return objpipe::new_callback<time_point>(
         [file_data_tables, tr_begin, tr_end](auto cb) {
           for (const auto& block : *file_data_tables) {
+            if (!block_intersects(*block, tr_begin, tr_end)) continue;
             iterator b = block->timestamps().begin();
             iterator e = block->timestamps().end();
             if (tr_begin.has_value())
@@ -339,8 +693,10 @@ auto tsdata_v2_tables::emit_time(
     using callback_factory_type = std::decay_t<decltype(callback_factory(std::declval<std::shared_ptr<const file_data_tables_block>>()))>;
 
     std::vector<callback_factory_type> parallel;
-    for (const auto& block : *file_data_tables)
-      parallel.emplace_back(callback_factory(block));
+    for (const auto& block : *file_data_tables) {
+      if (block_intersects(*block, tr_begin, tr_end))
+        parallel.emplace_back(callback_factory(block));
+    }
 
     if (is_distinct()) { // Merge only.
       return objpipe::merge(
@@ -25,6 +25,25 @@ class monsoon_dirhistory_local_ tsdata_v2_tables
 
   ~tsdata_v2_tables() noexcept override;
 
+  /**
+   * \brief Write a new tables file containing \p data.
+   * \details
+   * Data is written in blocks, each holding a run of ascending timestamps.
+   * The header is written last, so a partially written file is not
+   * recognized as a tsdata file.
+   */
+  static auto new_file(io::fd&& fd, objpipe::reader<emit_type> data,
+      compression_type compression = compression_type::GZIP)
+  -> std::shared_ptr<tsdata_v2_tables>;
+  /**
+   * \brief Write a new tables file containing \p data.
+   * \details
+   * Unlike emitted data, time series can hold groups without metrics.
+   */
+  static auto new_file(io::fd&& fd, const std::vector<time_series>& data,
+      compression_type compression = compression_type::GZIP)
+  -> std::shared_ptr<tsdata_v2_tables>;
+
   bool is_writable() const noexcept override;
   void push_back(const emit_type&) override;
 
@@ -42,6 +61,12 @@ class monsoon_dirhistory_local_ tsdata_v2_tables
 
  private:
   auto read_() const -> std::shared_ptr<file_data_tables>;
+  ///\brief Write a new tables file, with the data supplied by \p for_each.
+  ///\details \p for_each is invoked with a functor accepting each element.
+  template<typename ForEach>
+  static auto new_file_(io::fd&& fd, ForEach&& for_each,
+      compression_type compression)
+  -> std::shared_ptr<tsdata_v2_tables>;
 
   std::vector<time_series> read_all_raw_() const override;
 };
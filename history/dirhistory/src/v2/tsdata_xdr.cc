@@ -2,8 +2,10 @@
 #include "xdr_primitives.h"
 #include "record_array.h"
 #include "tsdata.h"
+#include "tsdata_list.h"
 #include <stack>
 #include <tuple>
+#include <utility>
 
 namespace monsoon::history::v2 {
 
@@ -49,18 +51,20 @@ tsdata_xdr::~tsdata_xdr() noexcept {}
 
 auto tsdata_xdr::get_dictionary() const
 -> std::shared_ptr<const dictionary> {
-  tsdata_xdr*const parent = dynamic_cast<tsdata_xdr*>(&this->parent());
+  const tsdata_xdr*const parent = dynamic_cast<const tsdata_xdr*>(&this->parent());
   if (parent != nullptr) return parent->get_dictionary();
 
+  // Dictionaries only grow, so the dictionary of the most recent record
+  // covers all records in the file.
+  const tsdata_v2_list*const list = dynamic_cast<const tsdata_v2_list*>(&this->parent());
+  if (list != nullptr) return list->dictionary_();
+
   return get_dynamics_cache<dictionary>(shared_from_this(), dict_);
 }
 
 auto tsdata_xdr::get_dictionary()
 -> std::shared_ptr<dictionary> {
-  tsdata_xdr*const parent = dynamic_cast<tsdata_xdr*>(&this->parent());
-  if (parent != nullptr) return parent->get_dictionary();
-
-  return get_dynamics_cache<dictionary>(shared_from_this(), dict_);
+  return std::const_pointer_cast<dictionary>(std::as_const(*this).get_dictionary());
 }
 
 auto tsdata_xdr::get_predecessor() const
@@ -46,7 +46,13 @@ class monsoon_dirhistory_local_ tsdata_xdr
 
   auto get_predecessor() const -> std::shared_ptr<const tsdata_xdr>;
   auto get_predecessor() -> std::shared_ptr<tsdata_xdr>;
+  ///\brief Pointer to the predecessor record, nil if this is the first record.
+  auto predecessor_ptr() const noexcept -> const file_segment_ptr& { return pred_; }
+  ///\brief Pointer to the dictionary update of this record, nil if there is none.
+  auto dictionary_ptr() const noexcept -> const file_segment_ptr& { return dict_; }
   auto get() const -> std::shared_ptr<const record_array>;
+  ///\brief Location of the record array.
+  auto records_ptr() const noexcept -> const file_segment_ptr& { return records_; }
   auto ts() const noexcept -> time_point { return ts_; }
 
   auto decode(xdr::xdr_istream& in) -> void;
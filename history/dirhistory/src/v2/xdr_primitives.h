@@ -7,6 +7,8 @@
 #include <monsoon/time_point.h>
 #include <monsoon/xdr/xdr.h>
 #include "dictionary.h"
+#include <cstdint>
+#include <vector>
 
 namespace monsoon::history::v2 {
 
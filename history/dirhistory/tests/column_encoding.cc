@@ -0,0 +1,244 @@
+#include "UnitTest++/UnitTest++.h"
+#include "column_encoding.h"
+#include <monsoon/io/stream.h>
+#include <monsoon/xdr/xdr.h>
+#include <monsoon/xdr/xdr_stream.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+using monsoon::history::v2::column_encoding;
+using monsoon::history::v2::decode_column;
+using monsoon::history::v2::encode_column;
+using monsoon::history::v2::encode_column_as;
+
+namespace std {
+template<typename T>
+inline auto operator<<(std::ostream& out, const std::vector<T>& vec)
+-> std::ostream& {
+  auto i = vec.cbegin();
+  out << "[";
+  if (i != vec.cend()) out << " " << +*i++;
+  while (i != vec.cend()) out << ", " << +*i++;
+  out << (vec.empty() ? "]" : " ]");
+  return out;
+}
+} /* namespace std */
+
+namespace {
+
+
+class byte_reader
+: public monsoon::io::stream_reader
+{
+ public:
+  byte_reader(std::vector<std::uint8_t> data) : data_(std::move(data)) {}
+
+  std::size_t read(void* buf, std::size_t len) override {
+    auto rlen = std::min(data_.size(), len);
+    std::copy_n(data_.begin(), rlen, reinterpret_cast<std::uint8_t*>(buf));
+    data_.erase(data_.begin(), data_.begin() + rlen);
+    return rlen;
+  }
+
+  bool at_end() const override { return data_.empty(); }
+
+  void close() override {}
+
+ private:
+  std::vector<std::uint8_t> data_;
+};
+
+auto make_reader(const monsoon::xdr::xdr_bytevector_ostream<>& out)
+-> monsoon::xdr::xdr_stream_reader<byte_reader> {
+  return monsoon::xdr::xdr_stream_reader<byte_reader>(byte_reader(out.as_vector()));
+}
+
+///\brief Encode with the given encoding and decode the result.
+template<typename T>
+auto round_trip(column_encoding enc, const std::vector<T>& values)
+-> std::vector<T> {
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  out.put_uint32(static_cast<std::uint32_t>(enc));
+  encode_column_as(out, enc, values);
+
+  auto in = make_reader(out);
+  std::vector<T> result;
+  decode_column(in, result);
+  CHECK(in.at_end());
+  return result;
+}
+
+///\brief Encoding selected by encode_column for the values.
+template<typename T>
+auto selected_encoding(const std::vector<T>& values)
+-> column_encoding {
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  encode_column(out, values);
+  return column_encoding(make_reader(out).get_uint32());
+}
+
+///\brief Bit patterns of doubles, so NaN and -0.0 compare exactly.
+auto bits(const std::vector<double>& values)
+-> std::vector<std::uint64_t> {
+  std::vector<std::uint64_t> result;
+  std::transform(values.begin(), values.end(), std::back_inserter(result),
+      [](double v) {
+        std::uint64_t b;
+        std::memcpy(&b, &v, sizeof(b));
+        return b;
+      });
+  return result;
+}
+
+auto negative_nan() -> double {
+  const std::uint64_t b = 0xfff8000000000001ull; // Sign bit and payload set.
+  double v;
+  std::memcpy(&v, &b, sizeof(v));
+  return v;
+}
+
+constexpr std::int64_t int64_min = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t int64_max = std::numeric_limits<std::int64_t>::max();
+constexpr double inf = std::numeric_limits<double>::infinity();
+constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+const std::vector<double> special_doubles = {
+  0.0, -0.0, 0.0, nan, nan, negative_nan(), inf, -inf, inf,
+  std::numeric_limits<double>::denorm_min(),
+  std::numeric_limits<double>::max(),
+  std::numeric_limits<double>::lowest(),
+  1.0, 1.0
+};
+
+
+} /* namespace <unnamed> */
+
+TEST(rle_round_trip) {
+  const std::vector<std::int64_t> ints = {
+    7, 7, 7, -1, -1, int64_min, int64_min, int64_max, 7
+  };
+  CHECK_EQUAL(ints, round_trip(column_encoding::RLE, ints));
+
+  const std::vector<std::int16_t> shorts = { -32768, -32768, 32767, 0, 0 };
+  CHECK_EQUAL(shorts, round_trip(column_encoding::RLE, shorts));
+}
+
+TEST(rle_special_doubles) {
+  // Runs compare bitwise: 0.0 and -0.0 are distinct, equal NaNs form a run.
+  CHECK_EQUAL(
+      bits(special_doubles),
+      bits(round_trip(column_encoding::RLE, special_doubles)));
+}
+
+TEST(rle_runs_end_at_column_boundary) {
+  const std::vector<std::int32_t> first = { 3, 3, 3 }, second = { 3, 3 };
+
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  for (const auto* values : { &first, &second }) {
+    out.put_uint32(static_cast<std::uint32_t>(column_encoding::RLE));
+    encode_column_as(out, column_encoding::RLE, *values);
+  }
+
+  auto in = make_reader(out);
+  std::vector<std::int32_t> decoded_first, decoded_second;
+  decode_column(in, decoded_first);
+  decode_column(in, decoded_second);
+  CHECK(in.at_end());
+
+  CHECK_EQUAL(first, decoded_first);
+  CHECK_EQUAL(second, decoded_second);
+}
+
+TEST(delta_delta_round_trip) {
+  const std::vector<std::int64_t> ramp = { 1000, 1010, 1020, 1030, 1041, 1040, 0, -5 };
+  CHECK_EQUAL(ramp, round_trip(column_encoding::DELTA_DELTA, ramp));
+
+  const std::vector<std::int16_t> shorts = { -32768, 32767, -32768, 0, 1, 2 };
+  CHECK_EQUAL(shorts, round_trip(column_encoding::DELTA_DELTA, shorts));
+
+  const std::vector<std::int32_t> ints = {
+    std::numeric_limits<std::int32_t>::min(),
+    std::numeric_limits<std::int32_t>::max(),
+    std::numeric_limits<std::int32_t>::min()
+  };
+  CHECK_EQUAL(ints, round_trip(column_encoding::DELTA_DELTA, ints));
+}
+
+TEST(delta_delta_overflowing_deltas) {
+  // Deltas and delta-of-deltas here don't fit in int64_t and wrap around.
+  const std::vector<std::int64_t> values = {
+    int64_min, int64_max, int64_min, 0, int64_max, int64_max, -1, int64_min
+  };
+  CHECK_EQUAL(values, round_trip(column_encoding::DELTA_DELTA, values));
+
+  const std::vector<std::int64_t> single_max = { int64_max };
+  CHECK_EQUAL(single_max, round_trip(column_encoding::DELTA_DELTA, single_max));
+  const std::vector<std::int64_t> single_min = { int64_min };
+  CHECK_EQUAL(single_min, round_trip(column_encoding::DELTA_DELTA, single_min));
+}
+
+TEST(xor_special_doubles) {
+  CHECK_EQUAL(
+      bits(special_doubles),
+      bits(round_trip(column_encoding::XOR, special_doubles)));
+}
+
+TEST(xor_runs_end_at_column_boundary) {
+  // Each column XORs against zero at its start.
+  const std::vector<double> first = { 2.5, 2.5 }, second = { 2.5 };
+
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  for (const auto* values : { &first, &second }) {
+    out.put_uint32(static_cast<std::uint32_t>(column_encoding::XOR));
+    encode_column_as(out, column_encoding::XOR, *values);
+  }
+
+  auto in = make_reader(out);
+  std::vector<double> decoded_first, decoded_second;
+  decode_column(in, decoded_first);
+  decode_column(in, decoded_second);
+  CHECK(in.at_end());
+
+  CHECK_EQUAL(bits(first), bits(decoded_first));
+  CHECK_EQUAL(bits(second), bits(decoded_second));
+}
+
+TEST(empty_columns) {
+  const std::vector<std::int64_t> no_ints;
+  const std::vector<double> no_doubles;
+
+  for (const column_encoding enc : { column_encoding::RAW, column_encoding::RLE, column_encoding::DELTA_DELTA })
+    CHECK_EQUAL(no_ints, round_trip(enc, no_ints));
+  for (const column_encoding enc : { column_encoding::RAW, column_encoding::RLE, column_encoding::XOR })
+    CHECK_EQUAL(bits(no_doubles), bits(round_trip(enc, no_doubles)));
+}
+
+TEST(encoding_not_applicable) {
+  const std::vector<std::int64_t> ints = { 1 };
+  const std::vector<double> doubles = { 1.0 };
+
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  CHECK_THROW(encode_column_as(out, column_encoding::XOR, ints), monsoon::xdr::xdr_exception);
+  CHECK_THROW(encode_column_as(out, column_encoding::DELTA_DELTA, doubles), monsoon::xdr::xdr_exception);
+}
+
+TEST(encode_column_selects_smallest) {
+  const std::vector<std::int64_t> constant(100, 42);
+  CHECK(column_encoding::RLE == selected_encoding(constant));
+
+  std::vector<std::int64_t> ramp;
+  for (std::int64_t i = 0; i < 100; ++i) ramp.push_back(1000000 + 17 * i);
+  CHECK(column_encoding::DELTA_DELTA == selected_encoding(ramp));
+
+  std::vector<double> slow;
+  for (int i = 0; i < 100; ++i) slow.push_back(1.0 + i);
+  CHECK(column_encoding::XOR == selected_encoding(slow));
+}
+
+int main() {
+  return UnitTest::RunAllTests();
+}
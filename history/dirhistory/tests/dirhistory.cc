@@ -0,0 +1,204 @@
+#include "UnitTest++/UnitTest++.h"
+#include <monsoon/history/dir/dirhistory.h>
+#include <monsoon/metric_source.h>
+#include <monsoon/metric_value.h>
+#include <monsoon/time_point.h>
+#include <monsoon/time_range.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+
+using monsoon::history::dirhistory;
+using monsoon::time_point;
+namespace filesystem = monsoon::history::filesystem;
+
+namespace {
+
+
+///\brief Temporary directory, removed with its contents on destruction.
+class tmpdir {
+ public:
+  tmpdir() {
+    std::random_device rnd;
+    path_ = filesystem::temp_directory_path()
+        / ("monsoon_dirhistory_test-" + std::to_string(rnd()));
+    filesystem::create_directory(path_);
+  }
+
+  ~tmpdir() noexcept {
+    std::error_code ec;
+    filesystem::remove_all(path_, ec);
+  }
+
+  tmpdir(const tmpdir&) = delete;
+  tmpdir& operator=(const tmpdir&) = delete;
+
+  auto path() const -> const filesystem::path& { return path_; }
+
+ private:
+  filesystem::path path_;
+};
+
+///\brief Count files in \p dir, skipping in-progress compactions.
+auto file_count(const filesystem::path& dir) -> std::size_t {
+  return std::count_if(
+      filesystem::directory_iterator(dir),
+      filesystem::directory_iterator(),
+      [](const filesystem::path& fname) {
+        return fname.extension() != ".compact-tmp";
+      });
+}
+
+auto record_at(time_point tp) -> monsoon::metric_source::metric_emit {
+  monsoon::metric_source::metric_emit result{ tp, {} };
+  std::get<1>(result)[
+      std::make_tuple(
+          monsoon::group_name(monsoon::simple_group({ "test" })),
+          monsoon::metric_name({ "x" }))] = monsoon::metric_value(17);
+  return result;
+}
+
+auto record_count(const dirhistory& hist) -> std::size_t {
+  return hist.emit_time(monsoon::time_range()).to_vector().size();
+}
+
+const time_point base_time = time_point("2000-01-01T00:00:00.000Z");
+auto minutes(std::int64_t n) -> time_point::duration {
+  return time_point::duration(n * 60 * 1000);
+}
+
+
+} /* namespace <unnamed> */
+
+TEST(rotate_on_max_file_records) {
+  tmpdir dir;
+  dirhistory::options opts;
+  opts.max_file_records = 2u;
+  dirhistory hist(dir.path(), opts);
+
+  for (int i = 0; i < 5; ++i)
+    hist.push_back(record_at(base_time + time_point::duration(i * 1000)));
+
+  CHECK_EQUAL(3u, file_count(dir.path()));
+  CHECK_EQUAL(5u, record_count(hist));
+}
+
+TEST(rotate_on_max_file_records_after_reopen) {
+  tmpdir dir;
+  dirhistory::options opts;
+  opts.max_file_records = 2u;
+
+  {
+    dirhistory hist(dir.path(), opts);
+    hist.push_back(record_at(base_time));
+  }
+
+  dirhistory hist(dir.path(), opts);
+  hist.push_back(record_at(base_time + time_point::duration(1000)));
+  CHECK_EQUAL(1u, file_count(dir.path()));
+  hist.push_back(record_at(base_time + time_point::duration(2000)));
+  CHECK_EQUAL(2u, file_count(dir.path()));
+  CHECK_EQUAL(3u, record_count(hist));
+}
+
+TEST(rotate_on_max_file_size) {
+  tmpdir dir;
+  dirhistory::options opts;
+  opts.max_file_size = 1u; // Any record fills the file.
+  dirhistory hist(dir.path(), opts);
+
+  for (int i = 0; i < 3; ++i)
+    hist.push_back(record_at(base_time + time_point::duration(i * 1000)));
+
+  CHECK_EQUAL(3u, file_count(dir.path()));
+  CHECK_EQUAL(3u, record_count(hist));
+}
+
+TEST(rotate_on_interval) {
+  tmpdir dir;
+  dirhistory::options opts;
+  opts.rotate_interval = minutes(60);
+  dirhistory hist(dir.path(), opts);
+
+  hist.push_back(record_at(base_time));
+  hist.push_back(record_at(base_time + minutes(30)));
+  CHECK_EQUAL(1u, file_count(dir.path()));
+  hist.push_back(record_at(base_time + minutes(60)));
+  CHECK_EQUAL(2u, file_count(dir.path()));
+  hist.push_back(record_at(base_time + minutes(130)));
+  CHECK_EQUAL(3u, file_count(dir.path()));
+  CHECK_EQUAL(4u, record_count(hist));
+}
+
+TEST(retention_expires_old_files) {
+  tmpdir dir, archive;
+  dirhistory::options opts;
+  opts.max_file_records = 1u;
+  opts.retention = minutes(60);
+  opts.archive_dir = archive.path();
+  dirhistory hist(dir.path(), opts);
+
+  hist.push_back(record_at(base_time)); // Far outside retention.
+  hist.push_back(record_at(time_point::now())); // Rotates, waking the compactor.
+
+  // Expiry happens in the background.
+  for (int i = 0; i < 300 && file_count(archive.path()) == 0u; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  CHECK_EQUAL(1u, file_count(archive.path()));
+  CHECK_EQUAL(1u, file_count(dir.path()));
+  CHECK_EQUAL(1u, record_count(hist));
+}
+
+TEST(retention_retries_failed_expiry) {
+  tmpdir dir, archive;
+  dirhistory::options opts;
+  opts.max_file_records = 1u;
+  opts.retention = minutes(60);
+  opts.archive_dir = archive.path();
+  dirhistory hist(dir.path(), opts);
+
+  // Archiving fails while the archive directory is missing.
+  filesystem::remove(archive.path());
+  hist.push_back(record_at(base_time)); // Far outside retention.
+  hist.push_back(record_at(time_point::now())); // Rotates, waking the compactor.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  CHECK_EQUAL(2u, record_count(hist));
+
+  // The next pass retries the file.
+  filesystem::create_directory(archive.path());
+  hist.push_back(record_at(time_point::now())); // Rotates, waking the compactor.
+  for (int i = 0; i < 300 && file_count(archive.path()) == 0u; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  CHECK_EQUAL(1u, file_count(archive.path()));
+  CHECK_EQUAL(2u, record_count(hist));
+}
+
+TEST(batched_sync_within_interval) {
+  tmpdir dir;
+  dirhistory::options opts;
+  opts.durability = dirhistory::durability_mode::BATCHED;
+  opts.sync_interval = time_point::duration(100);
+  dirhistory hist(dir.path(), opts);
+
+  // Each append is the only pending one, so only the interval triggers its sync.
+  for (std::uint64_t i = 0; i < 5u; ++i) {
+    hist.push_back(record_at(base_time + time_point::duration(i * 1000)));
+
+    // Allow for scheduling delays beyond the interval.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (hist.background_syncs() <= i && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    CHECK_EQUAL(i + 1u, hist.background_syncs());
+  }
+}
+
+int main() {
+  return UnitTest::RunAllTests();
+}
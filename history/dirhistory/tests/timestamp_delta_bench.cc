@@ -0,0 +1,111 @@
+#include "timestamp_delta.h"
+#include <monsoon/io/ptr_stream.h>
+#include <monsoon/io/stream.h>
+#include <monsoon/time_point.h>
+#include <monsoon/xdr/xdr.h>
+#include <monsoon/xdr/xdr_stream.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using monsoon::history::v2::timestamp_delta;
+using monsoon::time_point;
+
+namespace {
+
+
+class byte_reader
+: public monsoon::io::stream_reader
+{
+ public:
+  byte_reader(const std::vector<std::uint8_t>& data) : data_(&data) {}
+
+  std::size_t read(void* buf, std::size_t len) override {
+    const auto rlen = std::min(data_->size() - off_, len);
+    std::copy_n(data_->begin() + off_, rlen, reinterpret_cast<std::uint8_t*>(buf));
+    off_ += rlen;
+    return rlen;
+  }
+
+  bool at_end() const override { return off_ == data_->size(); }
+
+  void close() override {}
+
+ private:
+  const std::vector<std::uint8_t>* data_;
+  std::size_t off_ = 0;
+};
+
+///\brief Decoder as it was before bulk decoding: one get_int32 per delta.
+void decode_per_element(monsoon::xdr::xdr_istream& in, std::vector<time_point>& out) {
+  out.clear();
+  std::int64_t millis = in.get_int64();
+  out.push_back(time_point(millis));
+  in.get_collection(
+      [&millis](monsoon::xdr::xdr_istream& in) {
+        millis += in.get_int32();
+        return time_point(millis);
+      },
+      out);
+}
+
+template<typename Fn>
+void bench(const char* name, const std::vector<std::uint8_t>& data, std::size_t count, Fn fn) {
+  constexpr int iterations = 2000;
+  std::int64_t sink = 0;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    // Same reader stack as file decoding, see encdec_ctx::new_reader.
+    monsoon::xdr::xdr_stream_reader<monsoon::io::ptr_stream_reader> in{
+      monsoon::io::ptr_stream_reader(std::make_unique<byte_reader>(data))
+    };
+    sink += fn(in).back().millis_since_posix_epoch();
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  std::cout << name << ": " << double(count) * iterations / seconds / 1e6
+      << " M timestamps/s (checksum " << sink << ")" << std::endl;
+}
+
+
+} /* namespace <unnamed> */
+
+// Decode throughput of a timestamp block, as found in tables files:
+// one day of 10 second collection intervals, with some jitter.
+int main() {
+  timestamp_delta block;
+  std::int64_t millis = 1500000000000;
+  std::uint32_t noise = 1;
+  for (int i = 0; i < 8640; ++i) {
+    noise = noise * 1103515245u + 12345u;
+    millis += 10000 + static_cast<std::int64_t>(noise >> 16) % 200 - 100;
+    block.push_back(time_point(millis));
+  }
+
+  monsoon::xdr::xdr_bytevector_ostream<> out;
+  block.encode(out);
+  const std::vector<std::uint8_t>& data = out.as_vector();
+
+  std::vector<time_point> per_element;
+  bench("per element", data, block.size(),
+      [&per_element](monsoon::xdr::xdr_istream& in) -> const std::vector<time_point>& {
+        decode_per_element(in, per_element);
+        return per_element;
+      });
+  timestamp_delta bulk;
+  bench("timestamp_delta::decode", data, block.size(),
+      [&bulk](monsoon::xdr::xdr_istream& in) -> const std::vector<time_point>& {
+        bulk.decode(in);
+        return bulk;
+      });
+
+  if (per_element != static_cast<const std::vector<time_point>&>(bulk)) {
+    std::cerr << "decoders disagree" << std::endl;
+    return 1;
+  }
+}
@@ -1,8 +1,13 @@
 #include "UnitTest++/UnitTest++.h"
 #include <monsoon/history/dir/tsdata.h>
 #include <monsoon/metric_source.h>
+#include <monsoon/path_matcher.h>
+#include <monsoon/tag_matcher.h>
 #include <monsoon/time_series.h>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <vector>
 #include "tsdata_cpp.h"
 #include "tsdata_print.h"
 
@@ -79,6 +84,33 @@ TEST(read_tsdata_v2_tables) {
   CHECK_EQUAL(tsdata_expected_time, tsd->time());
 }
 
+TEST(emit_time_range_tsdata_v2_tables) {
+  auto tsd = tsdata::open(SAMPLE_DATA_DIR + "/tsdata_v2_tables.tsd");
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  const auto expected = tsdata_expected();
+  const auto t0 = expected.front().get_time();
+  const auto t1 = expected.back().get_time();
+
+  CHECK_EQUAL(
+      std::vector<monsoon::time_point>({ t1 }),
+      tsd->emit_time(t1, std::nullopt).to_vector());
+  CHECK_EQUAL(
+      std::vector<monsoon::time_point>({ t0 }),
+      tsd->emit_time(std::nullopt, t0).to_vector());
+  CHECK_EQUAL(
+      0u,
+      tsd->emit_time(t1 + monsoon::time_point::duration(1), std::nullopt).to_vector().size());
+
+  monsoon::path_matcher all_paths;
+  all_paths.push_back_double_wildcard();
+  const auto emitted = tsd->emit(t1, t1, all_paths, monsoon::tag_matcher(), all_paths)
+      .to_vector();
+  REQUIRE CHECK_EQUAL(1u, emitted.size());
+  CHECK_EQUAL(t1, std::get<0>(emitted.front()));
+  CHECK(std::get<1>(tsdata_to_metric_emit(expected.back())) == std::get<1>(emitted.front()));
+}
+
 TEST(read_tsdata_v2_list) {
   auto tsd = tsdata::open(SAMPLE_DATA_DIR + "/tsdata_v2_list.tsd");
   REQUIRE CHECK_EQUAL(true, tsd != nullptr);
@@ -98,6 +130,104 @@ TEST(push_back_tsdata_v2) {
   CHECK_EQUAL(tsdata_expected(), tsd->read_all());
 }
 
+TEST(push_back_deferred_sync_tsdata_v2) {
+  auto tsd = tsdata::new_file(monsoon::io::fd::tmpfile("monsoon_tsdata_test"), 2u);
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  tsd->set_sync_on_push_back(false);
+  for (const auto& x : tsdata_expected()) tsd->push_back(tsdata_to_metric_emit(x));
+  CHECK_EQUAL(tsdata_expected(), tsd->read_all());
+
+  tsd->sync(true);
+  CHECK_EQUAL(tsdata_expected(), tsd->read_all());
+  CHECK_EQUAL(tsdata_expected_time, tsd->time());
+}
+
+TEST(emit_time_range_tsdata_v2) {
+  auto tsd = tsdata::new_file(monsoon::io::fd::tmpfile("monsoon_tsdata_test"), 2u);
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  const auto expected = tsdata_expected();
+  const auto t0 = expected.front().get_time();
+  const auto t1 = expected.back().get_time();
+
+  tsd->push_back(tsdata_to_metric_emit(expected.front()));
+  CHECK_EQUAL(1u, tsd->emit_time(std::nullopt, std::nullopt).to_vector().size());
+
+  // Pushing after a lookup must be picked up by the next lookup.
+  for (auto i = std::next(expected.begin()); i != expected.end(); ++i)
+    tsd->push_back(tsdata_to_metric_emit(*i));
+
+  CHECK_EQUAL(
+      std::vector<monsoon::time_point>({ t0, t1 }),
+      tsd->emit_time(std::nullopt, std::nullopt).to_vector());
+  CHECK_EQUAL(
+      std::vector<monsoon::time_point>({ t1 }),
+      tsd->emit_time(t1, std::nullopt).to_vector());
+  CHECK_EQUAL(
+      std::vector<monsoon::time_point>({ t0 }),
+      tsd->emit_time(std::nullopt, t0).to_vector());
+
+  monsoon::path_matcher all_paths;
+  all_paths.push_back_double_wildcard();
+  const auto emitted = tsd->emit(t1, t1, all_paths, monsoon::tag_matcher(), all_paths)
+      .to_vector();
+  REQUIRE CHECK_EQUAL(1u, emitted.size());
+  CHECK_EQUAL(t1, std::get<0>(emitted.front()));
+}
+
+TEST(new_tables_file_tsdata_v2) {
+  auto src = tsdata::open(SAMPLE_DATA_DIR + "/tsdata_v2_list.tsd");
+  REQUIRE CHECK_EQUAL(true, src != nullptr);
+
+  monsoon::path_matcher all_paths;
+  all_paths.push_back_double_wildcard();
+  auto tsd = tsdata::new_tables_file(
+      monsoon::io::fd::tmpfile("monsoon_tsdata_test"),
+      src->emit(std::nullopt, std::nullopt, all_paths, monsoon::tag_matcher(), all_paths));
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  CHECK_EQUAL(expect_version(2u, 1u), tsd->version());
+  CHECK_EQUAL(false, tsd->is_writable());
+  CHECK_EQUAL(tsdata_expected(), tsd->read_all());
+  CHECK_EQUAL(tsdata_expected_time, tsd->time());
+}
+
+TEST(new_tables_file_snappy_tsdata_v2) {
+  auto src = tsdata::open(SAMPLE_DATA_DIR + "/tsdata_v2_list.tsd");
+  REQUIRE CHECK_EQUAL(true, src != nullptr);
+
+  monsoon::path_matcher all_paths;
+  all_paths.push_back_double_wildcard();
+  auto tsd = tsdata::new_tables_file(
+      monsoon::io::fd::tmpfile("monsoon_tsdata_test"),
+      src->emit(std::nullopt, std::nullopt, all_paths, monsoon::tag_matcher(), all_paths),
+      tsdata::compression_type::SNAPPY);
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  CHECK_EQUAL(tsdata_expected(), tsd->read_all());
+  CHECK_EQUAL(tsdata_expected_time, tsd->time());
+}
+
+TEST(new_tables_file_keeps_empty_groups_tsdata_v2) {
+  std::vector<monsoon::time_series> data = tsdata_expected();
+  data.emplace_back(
+      monsoon::time_point("2000-01-01T00:00:00.000Z"),
+      std::initializer_list<monsoon::time_series_value>{
+        monsoon::time_series_value(
+            monsoon::group_name(monsoon::simple_group({ "test", "no", "metrics" })),
+            monsoon::time_series_value::metric_map())
+      });
+
+  auto tsd = tsdata::new_tables_file(
+      monsoon::io::fd::tmpfile("monsoon_tsdata_test"),
+      data,
+      tsdata::compression_type::GZIP);
+  REQUIRE CHECK_EQUAL(true, tsd != nullptr);
+
+  CHECK_EQUAL(data, tsd->read_all());
+}
+
 int main(int argc, char** argv) {
   if (argc != 2) {
     std::cerr << "Require argument: path to sample data directory.\n";
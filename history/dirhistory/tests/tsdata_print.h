@@ -16,7 +16,8 @@ auto operator<< (ostream& out, const C& c)
 -> std::enable_if_t<std::is_same<monsoon::time_series, typename C::value_type>::value
                  || std::is_same<monsoon::time_series_value, typename C::value_type>::value
                  || std::is_same<monsoon::group_name, typename C::value_type>::value
-                 || std::is_same<monsoon::simple_group, typename C::value_type>::value,
+                 || std::is_same<monsoon::simple_group, typename C::value_type>::value
+                 || std::is_same<monsoon::time_point, typename C::value_type>::value,
                     ostream&>
 {
   auto i = c.begin();
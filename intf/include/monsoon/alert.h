@@ -28,6 +28,9 @@ class monsoon_intf_export_ alert {
                          std::variant<metric_value, std::vector<metric_value>>>;
 
   alert();
+  alert(group_name name, std::optional<bool> value, std::string message,
+      alert_state state, time_point since, time_point::duration trigger_duration,
+      attributes_map attributes = attributes_map());
   alert(const alert&);
   alert(alert&&) noexcept;
   alert& operator=(const alert&);
@@ -7,6 +7,18 @@ alert::alert()
 : state_(alert_state::UNKNOWN)
 {}
 
+alert::alert(group_name name, std::optional<bool> value, std::string message,
+    alert_state state, time_point since, time_point::duration trigger_duration,
+    attributes_map attributes)
+: name_(std::move(name)),
+  value_(std::move(value)),
+  message_(std::move(message)),
+  state_(std::move(state)),
+  since_(std::move(since)),
+  trigger_duration_(std::move(trigger_duration)),
+  attributes_(std::move(attributes))
+{}
+
 alert::alert(const alert& a)
 : name_(a.name_),
   value_(a.value_),
@@ -0,0 +1,59 @@
+#ifndef MONSOON_IO_CRC32_H
+#define MONSOON_IO_CRC32_H
+
+#include <monsoon/misc_export_.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace monsoon {
+namespace io {
+
+
+/**
+ * \brief CRC-32 (IEEE 802.3) checksum.
+ *
+ * \details
+ * Computes the same checksum as boost::crc_32_type and zlib's crc32,
+ * and exposes the subset of the boost::crc_32_type interface in use.
+ *
+ * The implementation is selected at runtime:
+ * carry-less multiplication folding where the CPU supports it,
+ * slice-by-8 table lookup otherwise.
+ */
+class monsoon_misc_export_ crc32 {
+ public:
+  ///\brief Update the checksum with \p len bytes at \p data.
+  void process_bytes(const void* data, std::size_t len) noexcept {
+    state_ = update(state_, data, len);
+  }
+
+  ///\brief Checksum of all bytes processed so far.
+  auto checksum() const noexcept -> std::uint32_t {
+    return ~state_;
+  }
+
+  ///\brief Start a new checksum.
+  void reset() noexcept {
+    state_ = 0xffffffffu;
+  }
+
+  ///\brief Update the CRC register \p crc with \p len bytes at \p data.
+  ///\details The register is the bitwise complement of the checksum.
+  static auto update(std::uint32_t crc, const void* data, std::size_t len)
+  noexcept
+  -> std::uint32_t;
+  ///\brief Portable slice-by-8 implementation of update().
+  static auto update_sliced(std::uint32_t crc, const void* data,
+      std::size_t len) noexcept
+  -> std::uint32_t;
+  ///\brief Name of the implementation selected by update().
+  static auto implementation() noexcept -> const char*;
+
+ private:
+  std::uint32_t state_ = 0xffffffffu;
+};
+
+
+}} /* namespace monsoon::io */
+
+#endif /* MONSOON_IO_CRC32_H */
@@ -0,0 +1,51 @@
+#ifndef MONSOON_IO_MMAP_VIEW_H
+#define MONSOON_IO_MMAP_VIEW_H
+
+#include <monsoon/misc_export_.h>
+#include <monsoon/io/fd.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace monsoon {
+namespace io {
+
+
+/**
+ * \brief Read-only memory mapping of a file.
+ *
+ * \details
+ * The mapping covers the file as it was at construction time.
+ * The file must not be truncated while the mapping exists.
+ */
+class monsoon_misc_export_ mmap_view {
+ public:
+  using size_type = fd::size_type;
+
+  mmap_view() noexcept = default;
+  ///\brief Map the entire file.
+  ///\throws std::system_error if the file can not be mapped.
+  explicit mmap_view(const fd&);
+  mmap_view(const mmap_view&) = delete;
+  mmap_view(mmap_view&&) noexcept;
+  mmap_view& operator=(const mmap_view&) = delete;
+  mmap_view& operator=(mmap_view&&) noexcept;
+  ~mmap_view() noexcept;
+
+  auto data() const noexcept -> const std::uint8_t* { return data_; }
+  auto size() const noexcept -> size_type { return size_; }
+  auto empty() const noexcept -> bool { return size_ == 0u; }
+
+ private:
+  void unmap_() noexcept;
+
+  const std::uint8_t* data_ = nullptr;
+  size_type size_ = 0;
+#if defined(WIN32)
+  fd::implementation_type mapping_ = nullptr;
+#endif
+};
+
+
+}} /* namespace monsoon::io */
+
+#endif /* MONSOON_IO_MMAP_VIEW_H */
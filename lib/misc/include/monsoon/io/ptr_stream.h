@@ -22,6 +22,7 @@ class monsoon_misc_export_ ptr_stream_reader
   std::size_t read(void*, std::size_t) override;
   void close() override;
   bool at_end() const override;
+  auto read_span(std::size_t) -> std::tuple<const void*, std::size_t> override;
 
   const std::unique_ptr<stream_reader>& get() const &;
   std::unique_ptr<stream_reader>& get() &;
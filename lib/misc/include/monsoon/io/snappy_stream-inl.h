@@ -0,0 +1,121 @@
+#ifndef MONSOON_SNAPPY_STREAM_INL_H
+#define MONSOON_SNAPPY_STREAM_INL_H
+
+#include <memory>
+#include <utility>
+
+namespace monsoon {
+namespace io {
+
+
+template<typename Reader>
+snappy_decompress_reader<Reader>::snappy_decompress_reader(Reader&& r)
+: r_(std::move(r))
+{}
+
+template<typename Reader>
+snappy_decompress_reader<Reader>::snappy_decompress_reader(Reader&& r,
+    bool validate)
+: basic_snappy_decompress_reader(validate),
+  r_(std::move(r))
+{}
+
+template<typename Reader>
+snappy_decompress_reader<Reader>::snappy_decompress_reader(
+    snappy_decompress_reader&& o)
+    noexcept(std::is_nothrow_move_constructible<Reader>())
+: basic_snappy_decompress_reader(std::move(o)),
+  r_(std::move(o.r_))
+{}
+
+template<typename Reader>
+auto snappy_decompress_reader<Reader>::operator=(
+    snappy_decompress_reader&& o)
+    noexcept(std::is_nothrow_move_assignable<Reader>())
+-> snappy_decompress_reader& {
+  basic_snappy_decompress_reader::operator=(std::move(o));
+  r_ = std::move(o.r_);
+  return *this;
+}
+
+template<typename Reader>
+stream_reader& snappy_decompress_reader<Reader>::reader_() {
+  return r_;
+}
+
+
+template<typename Writer>
+snappy_compress_writer<Writer>::snappy_compress_writer(Writer&& w)
+: w_(std::move(w))
+{}
+
+template<typename Writer>
+snappy_compress_writer<Writer>::snappy_compress_writer(
+    snappy_compress_writer&& o)
+    noexcept(std::is_nothrow_move_constructible<Writer>())
+: basic_snappy_compress_writer(std::move(o)),
+  w_(std::move(o.w_))
+{}
+
+template<typename Writer>
+auto snappy_compress_writer<Writer>::operator=(snappy_compress_writer&& o)
+    noexcept(std::is_nothrow_move_assignable<Writer>())
+-> snappy_compress_writer& {
+  basic_snappy_compress_writer::operator=(std::move(o));
+  w_ = std::move(o.w_);
+  return *this;
+}
+
+template<typename Writer>
+stream_writer& snappy_compress_writer<Writer>::writer_() {
+  return w_;
+}
+
+
+template<typename W>
+auto snappy_compression(W&& writer)
+-> std::enable_if_t<std::is_base_of_v<stream_writer, W> && !std::is_const_v<W>,
+    snappy_compress_writer<W>> {
+  return snappy_compress_writer<W>(std::forward<W>(writer));
+}
+
+template<typename R>
+auto snappy_decompression(R&& reader, bool validate)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    snappy_decompress_reader<R>> {
+  return snappy_decompress_reader<R>(std::forward<R>(reader), validate);
+}
+
+template<typename R>
+auto snappy_decompression(R&& reader)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    snappy_decompress_reader<R>> {
+  return snappy_decompress_reader<R>(std::forward<R>(reader));
+}
+
+
+template<typename W>
+auto new_snappy_compression(W&& writer)
+-> std::enable_if_t<std::is_base_of_v<stream_writer, W> && !std::is_const_v<W>,
+    std::unique_ptr<snappy_compress_writer<W>>> {
+  return std::make_unique<snappy_compress_writer<W>>(std::forward<W>(writer));
+}
+
+template<typename R>
+auto new_snappy_decompression(R&& reader, bool validate)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    std::unique_ptr<snappy_decompress_reader<R>>> {
+  return std::make_unique<snappy_decompress_reader<R>>(std::forward<R>(reader), validate);
+}
+
+template<typename R>
+auto new_snappy_decompression(R&& reader)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    std::unique_ptr<snappy_decompress_reader<R>>> {
+  return std::make_unique<snappy_decompress_reader<R>>(std::forward<R>(reader));
+}
+
+
+}} /* namespace monsoon::io */
+
+#endif /* MONSOON_SNAPPY_STREAM_INL_H */
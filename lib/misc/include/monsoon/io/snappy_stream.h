@@ -0,0 +1,170 @@
+#ifndef MONSOON_SNAPPY_STREAM_H
+#define MONSOON_SNAPPY_STREAM_H
+
+#include <monsoon/misc_export_.h>
+#include <monsoon/io/stream.h>
+#include <monsoon/io/ptr_stream.h>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace monsoon {
+namespace io {
+
+
+/**
+ * \brief Decompress a stream in the snappy framing format.
+ *
+ * \details
+ * The codec is implemented in-tree, trading compression ratio
+ * for much faster decompression than gzip.
+ * Chunk checksums are always verified.
+ */
+class monsoon_misc_export_ basic_snappy_decompress_reader
+: public stream_reader
+{
+ protected:
+  basic_snappy_decompress_reader(bool verify_stream = false);
+  basic_snappy_decompress_reader(const basic_snappy_decompress_reader&) = delete;
+  basic_snappy_decompress_reader(basic_snappy_decompress_reader&&) noexcept;
+  basic_snappy_decompress_reader& operator=(
+      const basic_snappy_decompress_reader&) = delete;
+  basic_snappy_decompress_reader& operator=(
+      basic_snappy_decompress_reader&&) noexcept;
+
+ public:
+  ~basic_snappy_decompress_reader() noexcept override;
+
+  std::size_t read(void*, std::size_t) override;
+  bool at_end() const override;
+  void close() override;
+
+ private:
+  monsoon_misc_local_ void fill_pending_() const;
+  monsoon_misc_local_ std::size_t read_source_(void*, std::size_t) const;
+  virtual stream_reader& reader_() = 0;
+
+  mutable std::vector<std::uint8_t> in_;
+  mutable std::vector<std::uint8_t> pending_;
+  mutable std::vector<std::uint8_t>::size_type pending_off_ = 0u;
+  mutable bool stream_id_seen_ = false;
+  mutable bool stream_end_seen_ = false;
+  bool verify_stream_ = false;
+  bool closed_ = false;
+};
+
+
+/**
+ * \brief Compress a stream using the snappy framing format.
+ */
+class monsoon_misc_export_ basic_snappy_compress_writer
+: public stream_writer
+{
+ protected:
+  basic_snappy_compress_writer();
+  basic_snappy_compress_writer(const basic_snappy_compress_writer&) = delete;
+  basic_snappy_compress_writer(basic_snappy_compress_writer&&) noexcept;
+  basic_snappy_compress_writer& operator=(
+      const basic_snappy_compress_writer&) = delete;
+  basic_snappy_compress_writer& operator=(
+      basic_snappy_compress_writer&&) noexcept;
+
+ public:
+  ~basic_snappy_compress_writer() noexcept override;
+
+  std::size_t write(const void*, std::size_t) override;
+  void close() override;
+
+ private:
+  monsoon_misc_local_ void to_sink_();
+  monsoon_misc_local_ void write_fully_(const void*, std::size_t);
+  virtual stream_writer& writer_() = 0;
+
+  std::vector<std::uint8_t> in_;
+  std::vector<std::uint8_t> out_;
+  std::vector<std::uint16_t> hash_table_;
+  bool stream_id_written_ = false;
+  bool closed_ = false;
+};
+
+
+template<typename Reader>
+class snappy_decompress_reader
+: public basic_snappy_decompress_reader
+{
+ public:
+  snappy_decompress_reader() = default;
+  snappy_decompress_reader(Reader&&);
+  snappy_decompress_reader(Reader&&, bool);
+  snappy_decompress_reader(snappy_decompress_reader&&)
+      noexcept(std::is_nothrow_move_constructible<Reader>());
+  snappy_decompress_reader& operator=(snappy_decompress_reader&&)
+      noexcept(std::is_nothrow_move_assignable<Reader>());
+
+ private:
+  stream_reader& reader_() override;
+
+  Reader r_;
+};
+
+
+template<typename Writer>
+class snappy_compress_writer
+: public basic_snappy_compress_writer
+{
+ public:
+  snappy_compress_writer() = default;
+  snappy_compress_writer(Writer&&);
+  snappy_compress_writer(snappy_compress_writer&&)
+      noexcept(std::is_nothrow_move_constructible<Writer>());
+  snappy_compress_writer& operator=(snappy_compress_writer&&)
+      noexcept(std::is_nothrow_move_assignable<Writer>());
+
+ private:
+  stream_writer& writer_() override;
+
+  Writer w_;
+};
+
+
+template<typename W>
+auto snappy_compression(W&&)
+-> std::enable_if_t<std::is_base_of_v<stream_writer, W> && !std::is_const_v<W>,
+    snappy_compress_writer<W>>;
+
+template<typename R>
+auto snappy_decompression(R&&, bool)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    snappy_decompress_reader<R>>;
+
+template<typename R>
+auto snappy_decompression(R&&)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    snappy_decompress_reader<R>>;
+
+
+template<typename W>
+auto new_snappy_compression(W&&)
+-> std::enable_if_t<std::is_base_of_v<stream_writer, W> && !std::is_const_v<W>,
+    std::unique_ptr<snappy_compress_writer<W>>>;
+
+template<typename R>
+auto new_snappy_decompression(R&&, bool)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    std::unique_ptr<snappy_decompress_reader<R>>>;
+
+template<typename R>
+auto new_snappy_decompression(R&&)
+-> std::enable_if_t<std::is_base_of_v<stream_reader, R> && !std::is_const_v<R>,
+    std::unique_ptr<snappy_decompress_reader<R>>>;
+
+
+extern template class monsoon_misc_export_ snappy_decompress_reader<ptr_stream_reader>;
+extern template class monsoon_misc_export_ snappy_compress_writer<ptr_stream_writer>;
+
+
+}} /* namespace monsoon::io */
+
+#include "snappy_stream-inl.h"
+
+#endif /* MONSOON_SNAPPY_STREAM_H */
@@ -3,6 +3,7 @@
 
 #include <monsoon/misc_export_.h>
 #include <cstdlib>
+#include <tuple>
 
 namespace monsoon {
 namespace io {
@@ -14,6 +15,17 @@ class monsoon_misc_export_ stream_reader {
   virtual std::size_t read(void*, std::size_t) = 0;
   virtual void close() = 0;
   virtual bool at_end() const = 0;
+
+  /**
+   * \brief Read up to the given number of bytes, without copying them.
+   *
+   * \details
+   * The returned bytes remain valid until the reader is closed or destroyed.
+   * The default implementation returns no bytes,
+   * in which case the caller must fall back to read().
+   * \returns Pointer to and length of the bytes read.
+   */
+  virtual auto read_span(std::size_t) -> std::tuple<const void*, std::size_t>;
 };
 
 class monsoon_misc_export_ stream_writer {
@@ -67,9 +67,9 @@ inline std::int32_t xdr_istream::get_int32() {
 inline std::uint32_t xdr_istream::get_uint32() {
   std::uint32_t i;
 
-  if (buffer_.size() - buffer_off_ >= sizeof(std::uint32_t)
-      && reinterpret_cast<std::uintptr_t>(buffer_.data() + buffer_off_) % alignof(std::uint32_t) == 0) {
-    i = *reinterpret_cast<const std::uint32_t*>(buffer_.data() + buffer_off_);
+  if (window_len_ - buffer_off_ >= sizeof(std::uint32_t)
+      && reinterpret_cast<std::uintptr_t>(window_ + buffer_off_) % alignof(std::uint32_t) == 0) {
+    i = *reinterpret_cast<const std::uint32_t*>(window_ + buffer_off_);
     buffer_off_ += sizeof(std::uint32_t);
   } else {
     get_raw_bytes_(&i, sizeof(i));
@@ -91,9 +91,9 @@ inline std::int64_t xdr_istream::get_int64() {
 inline std::uint64_t xdr_istream::get_uint64() {
   std::uint64_t i;
 
-  if (buffer_.size() - buffer_off_ >= sizeof(std::uint64_t)
-      && reinterpret_cast<std::uintptr_t>(buffer_.data() + buffer_off_) % alignof(std::uint64_t) == 0) {
-    i = *reinterpret_cast<const std::uint64_t*>(buffer_.data() + buffer_off_);
+  if (window_len_ - buffer_off_ >= sizeof(std::uint64_t)
+      && reinterpret_cast<std::uintptr_t>(window_ + buffer_off_) % alignof(std::uint64_t) == 0) {
+    i = *reinterpret_cast<const std::uint64_t*>(window_ + buffer_off_);
     buffer_off_ += sizeof(std::uint64_t);
   } else {
     get_raw_bytes_(&i, sizeof(i));
@@ -122,6 +122,35 @@ inline double xdr_istream::get_flt64() {
   return reinterpret_cast<double&>(tmp);
 }
 
+template<typename T, typename Alloc>
+inline auto xdr_istream::get_array_collection(std::vector<T, Alloc>& c)
+-> std::vector<T, Alloc>& {
+  const std::uint32_t len = get_uint32();
+  const auto off = c.size();
+  c.resize(off + len);
+
+  T*const dst = c.data() + off;
+  if constexpr(std::is_same_v<T, std::int16_t>)
+    get_int16_array(dst, len);
+  else if constexpr(std::is_same_v<T, std::uint16_t>)
+    get_uint16_array(dst, len);
+  else if constexpr(std::is_same_v<T, std::int32_t>)
+    get_int32_array(dst, len);
+  else if constexpr(std::is_same_v<T, std::uint32_t>)
+    get_uint32_array(dst, len);
+  else if constexpr(std::is_same_v<T, std::int64_t>)
+    get_int64_array(dst, len);
+  else if constexpr(std::is_same_v<T, std::uint64_t>)
+    get_uint64_array(dst, len);
+  else if constexpr(std::is_same_v<T, float>)
+    get_flt32_array(dst, len);
+  else if constexpr(std::is_same_v<T, double>)
+    get_flt64_array(dst, len);
+  else
+    static_assert(std::is_same_v<T, void>, "no array getter for this type");
+  return c;
+}
+
 template<typename Alloc>
 inline auto xdr_istream::get_string(const Alloc& alloc)
 -> std::basic_string<char, std::char_traits<char>, Alloc> {
@@ -334,7 +363,7 @@ inline void xdr_ostream::put_flt32(float f) {
   static_assert(sizeof(float) == sizeof(std::uint32_t),
       "expecting uint32 and float to have same size");
 
-  put_uint32(reinterpret_cast<const std::uint64_t&>(f));
+  put_uint32(reinterpret_cast<const std::uint32_t&>(f));
 }
 
 inline void xdr_ostream::put_flt64(double f) {
@@ -8,6 +8,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <vector>
 #include <optional>
@@ -45,6 +46,23 @@ class monsoon_misc_export_ xdr_istream {
   float get_flt32();
   double get_flt64();
 
+  ///\brief Read \p n values into \p dst.
+  ///\details Equivalent to repeated calls to the single value getter,
+  ///but decodes the values in bulk.
+  void get_int16_array(std::int16_t* dst, std::size_t n);
+  void get_uint16_array(std::uint16_t* dst, std::size_t n);
+  void get_int32_array(std::int32_t* dst, std::size_t n);
+  void get_uint32_array(std::uint32_t* dst, std::size_t n);
+  void get_int64_array(std::int64_t* dst, std::size_t n);
+  void get_uint64_array(std::uint64_t* dst, std::size_t n);
+  void get_flt32_array(float* dst, std::size_t n);
+  void get_flt64_array(double* dst, std::size_t n);
+  ///\brief Read a collection of integer or floating point values,
+  ///appending them to \p c.
+  template<typename T, typename Alloc>
+      auto get_array_collection(std::vector<T, Alloc>& c)
+      -> std::vector<T, Alloc>&;
+
   template<typename Alloc = std::allocator<char>>
       auto get_string(const Alloc& = Alloc())
       -> std::basic_string<char, std::char_traits<char>, Alloc>;
@@ -92,10 +110,20 @@ class monsoon_misc_export_ xdr_istream {
  private:
   virtual std::size_t get_raw_bytes(void*, std::size_t) = 0;
   virtual bool at_end_() const = 0;
+  ///\brief Read up to the given number of bytes, without copying.
+  ///\details
+  ///The returned bytes must remain valid until the stream is closed.
+  ///The default implementation returns no bytes,
+  ///in which case get_raw_bytes is used instead.
+  virtual auto get_raw_span(std::size_t)
+      -> std::tuple<const std::uint8_t*, std::size_t>;
   void get_raw_bytes_(void*, std::size_t);
 
   std::vector<std::uint8_t> buffer_;
-  std::vector<std::uint8_t>::size_type buffer_off_ = 0u;
+  // Unread data: either buffer_, or memory handed out by get_raw_span.
+  const std::uint8_t* window_ = nullptr;
+  std::size_t window_len_ = 0u;
+  std::size_t buffer_off_ = 0u;
 };
 
 class monsoon_misc_export_ xdr_ostream {
@@ -45,6 +45,17 @@ std::size_t xdr_stream_reader<Reader>::get_raw_bytes(
   return r_.read(buf, len);
 }
 
+template<typename Reader>
+auto xdr_stream_reader<Reader>::get_raw_span(std::size_t len)
+-> std::tuple<const std::uint8_t*, std::size_t> {
+  if constexpr(std::is_base_of_v<io::stream_reader, Reader>) {
+    const auto [span, span_len] = r_.read_span(len);
+    return { reinterpret_cast<const std::uint8_t*>(span), span_len };
+  } else {
+    return { nullptr, 0u };
+  }
+}
+
 
 template<typename Writer>
 xdr_stream_writer<Writer>::xdr_stream_writer(Writer&& w)
@@ -3,6 +3,7 @@
 
 #include <type_traits>
 #include <monsoon/xdr/xdr.h>
+#include <monsoon/io/stream.h>
 
 namespace monsoon {
 namespace xdr {
@@ -37,6 +38,8 @@ class xdr_stream_reader
  private:
   bool at_end_() const override;
   std::size_t get_raw_bytes(void*, std::size_t) override;
+  auto get_raw_span(std::size_t)
+      -> std::tuple<const std::uint8_t*, std::size_t> override;
 
   Reader r_;
 };
@@ -51,7 +51,7 @@ void aio::start() {
 
 void aio::join() {
   try {
-    if (std::any_of(
+    while (std::any_of(
         aiocb_vector_.begin(), aiocb_vector_.end(),
         [](const auto ptr) {
           return ptr != nullptr;
@@ -0,0 +1,190 @@
+#include <monsoon/io/crc32.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+# define MONSOON_CRC32_CLMUL
+# include <immintrin.h>
+#endif
+
+namespace monsoon {
+namespace io {
+namespace {
+
+
+///\brief Reflected CRC-32 polynomial.
+constexpr std::uint32_t crc32_poly = 0xedb88320u;
+
+///\brief Lookup tables for slice-by-8.
+///\details
+///table[0] is the classic byte-at-a-time table.
+///table[k][b] is the CRC of byte b followed by k zero bytes.
+struct crc32_tables {
+  std::uint32_t table[8][256];
+};
+
+constexpr auto make_crc32_tables_() -> crc32_tables {
+  crc32_tables t{};
+  for (std::uint32_t i = 0; i < 256u; ++i) {
+    std::uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 1u ? crc32_poly : 0u) ^ (crc >> 1);
+    t.table[0][i] = crc;
+  }
+  for (std::uint32_t i = 0; i < 256u; ++i) {
+    for (int k = 1; k < 8; ++k) {
+      const std::uint32_t prev = t.table[k - 1][i];
+      t.table[k][i] = t.table[0][prev & 0xffu] ^ (prev >> 8);
+    }
+  }
+  return t;
+}
+
+constexpr crc32_tables tables = make_crc32_tables_();
+
+///\brief Load 4 bytes as a little-endian integer.
+inline auto load_le32_(const std::uint8_t* p) noexcept -> std::uint32_t {
+  return std::uint32_t(p[0])
+      | std::uint32_t(p[1]) <<  8
+      | std::uint32_t(p[2]) << 16
+      | std::uint32_t(p[3]) << 24;
+}
+
+#ifdef MONSOON_CRC32_CLMUL
+///\brief Fold 128 bits of CRC state over \p data.
+__attribute__((target("pclmul,sse4.1")))
+inline auto fold_(__m128i x, __m128i k, __m128i data) noexcept -> __m128i {
+  return _mm_xor_si128(
+      _mm_xor_si128(
+          _mm_clmulepi64_si128(x, k, 0x00),
+          _mm_clmulepi64_si128(x, k, 0x11)),
+      data);
+}
+
+///\brief CRC update using carry-less multiplication.
+///\details
+///Folds the input 64 bytes at a time, then reduces the 128-bit state
+///using Barrett reduction.
+///Constants are from Intel's "Fast CRC Computation for Generic Polynomials
+///Using PCLMULQDQ Instruction", for the bit-reflected IEEE polynomial.
+__attribute__((target("pclmul,sse4.1")))
+auto update_clmul_(std::uint32_t crc, const void* data, std::size_t len)
+noexcept
+-> std::uint32_t {
+  auto p = reinterpret_cast<const std::uint8_t*>(data);
+  if (len < 64u) return crc32::update_sliced(crc, p, len);
+
+  const auto load = [](const std::uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  };
+  const __m128i k1k2 = _mm_set_epi64x(0x1c6e41596ll, 0x154442bd4ll);
+  const __m128i k3k4 = _mm_set_epi64x(0x0ccaa009ell, 0x1751997d0ll);
+  const __m128i k5 = _mm_set_epi64x(0, 0x163cd6124ll);
+  const __m128i poly = _mm_set_epi64x(0x1f7011641ll, 0x1db710641ll);
+  const __m128i mask32 = _mm_set_epi64x(0xffffffffll, 0xffffffffll);
+
+  __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i x2 = load(p + 16);
+  __m128i x3 = load(p + 32);
+  __m128i x4 = load(p + 48);
+  p += 64;
+  len -= 64u;
+
+  while (len >= 64u) {
+    x1 = fold_(x1, k1k2, load(p));
+    x2 = fold_(x2, k1k2, load(p + 16));
+    x3 = fold_(x3, k1k2, load(p + 32));
+    x4 = fold_(x4, k1k2, load(p + 48));
+    p += 64;
+    len -= 64u;
+  }
+
+  x1 = fold_(x1, k3k4, x2);
+  x1 = fold_(x1, k3k4, x3);
+  x1 = fold_(x1, k3k4, x4);
+  while (len >= 16u) {
+    x1 = fold_(x1, k3k4, load(p));
+    p += 16;
+    len -= 16u;
+  }
+
+  // Fold 128 bits to 64 bits.
+  x1 = _mm_xor_si128(
+      _mm_srli_si128(x1, 8),
+      _mm_clmulepi64_si128(x1, k3k4, 0x10));
+  // Fold 64 bits to 32 bits.
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(
+      _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00),
+      x2);
+  // Barrett reduction.
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+  crc = static_cast<std::uint32_t>(_mm_extract_epi32(_mm_xor_si128(x1, x2), 1));
+
+  return crc32::update_sliced(crc, p, len);
+}
+#endif
+
+using update_fn = auto (*)(std::uint32_t, const void*, std::size_t) noexcept
+    -> std::uint32_t;
+
+auto select_update_() noexcept -> update_fn {
+#ifdef MONSOON_CRC32_CLMUL
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    return &update_clmul_;
+#endif
+  return &crc32::update_sliced;
+}
+
+///\brief Implementation selected for this CPU.
+auto selected_update_() noexcept -> update_fn {
+  static const update_fn impl = select_update_();
+  return impl;
+}
+
+
+} /* namespace monsoon::io::<unnamed> */
+
+
+auto crc32::update(std::uint32_t crc, const void* data, std::size_t len)
+noexcept
+-> std::uint32_t {
+  return (*selected_update_())(crc, data, len);
+}
+
+auto crc32::update_sliced(std::uint32_t crc, const void* data,
+    std::size_t len) noexcept
+-> std::uint32_t {
+  const auto& t = tables.table;
+  auto p = reinterpret_cast<const std::uint8_t*>(data);
+
+  while (len >= 8u) {
+    const std::uint32_t lo = load_le32_(p) ^ crc;
+    const std::uint32_t hi = load_le32_(p + 4);
+    crc = t[7][lo & 0xffu]
+        ^ t[6][(lo >> 8) & 0xffu]
+        ^ t[5][(lo >> 16) & 0xffu]
+        ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xffu]
+        ^ t[2][(hi >> 8) & 0xffu]
+        ^ t[1][(hi >> 16) & 0xffu]
+        ^ t[0][hi >> 24];
+    p += 8;
+    len -= 8u;
+  }
+
+  while (len-- > 0u)
+    crc = t[0][(crc ^ *p++) & 0xffu] ^ (crc >> 8);
+  return crc;
+}
+
+auto crc32::implementation() noexcept -> const char* {
+#ifdef MONSOON_CRC32_CLMUL
+  if (selected_update_() == &update_clmul_) return "pclmul";
+#endif
+  return "slice-by-8";
+}
+
+
+}} /* namespace monsoon::io */
@@ -0,0 +1,106 @@
+#include <monsoon/io/mmap_view.h>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+#if defined(WIN32)
+# include <Windows.h>
+#else
+# include <cerrno>
+# include <sys/mman.h>
+#endif
+
+namespace monsoon {
+namespace io {
+
+
+#if defined(WIN32)
+
+mmap_view::mmap_view(const fd& file)
+: size_(file.size())
+{
+  if (size_ == 0u) return; // Empty files can not be mapped.
+  if (size_ > std::numeric_limits<SIZE_T>::max())
+    throw std::system_error(std::make_error_code(std::errc::value_too_large));
+
+  mapping_ = CreateFileMapping(file.underlying(), nullptr, PAGE_READONLY,
+      0, 0, nullptr);
+  if (mapping_ == nullptr)
+    throw std::system_error(GetLastError(), std::system_category());
+
+  data_ = reinterpret_cast<const std::uint8_t*>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, size_));
+  if (data_ == nullptr) {
+    const auto err = GetLastError();
+    CloseHandle(mapping_);
+    throw std::system_error(err, std::system_category());
+  }
+}
+
+void mmap_view::unmap_() noexcept {
+  if (data_ != nullptr) UnmapViewOfFile(data_);
+  if (mapping_ != nullptr) CloseHandle(mapping_);
+  data_ = nullptr;
+  mapping_ = nullptr;
+  size_ = 0;
+}
+
+mmap_view::mmap_view(mmap_view&& o) noexcept
+: data_(std::exchange(o.data_, nullptr)),
+  size_(std::exchange(o.size_, 0u)),
+  mapping_(std::exchange(o.mapping_, nullptr))
+{}
+
+mmap_view& mmap_view::operator=(mmap_view&& o) noexcept {
+  unmap_();
+  data_ = std::exchange(o.data_, nullptr);
+  size_ = std::exchange(o.size_, 0u);
+  mapping_ = std::exchange(o.mapping_, nullptr);
+  return *this;
+}
+
+#else
+
+mmap_view::mmap_view(const fd& file)
+: size_(file.size())
+{
+  if (size_ == 0u) return; // Empty files can not be mapped.
+  if (size_ > std::numeric_limits<std::size_t>::max())
+    throw std::system_error(std::make_error_code(std::errc::value_too_large));
+
+  void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED,
+      file.underlying(), 0);
+  if (addr == MAP_FAILED) {
+    size_ = 0;
+    throw std::system_error(errno, std::system_category());
+  }
+  data_ = reinterpret_cast<const std::uint8_t*>(addr);
+}
+
+void mmap_view::unmap_() noexcept {
+  if (data_ != nullptr)
+    ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+mmap_view::mmap_view(mmap_view&& o) noexcept
+: data_(std::exchange(o.data_, nullptr)),
+  size_(std::exchange(o.size_, 0u))
+{}
+
+mmap_view& mmap_view::operator=(mmap_view&& o) noexcept {
+  unmap_();
+  data_ = std::exchange(o.data_, nullptr);
+  size_ = std::exchange(o.size_, 0u);
+  return *this;
+}
+
+#endif
+
+mmap_view::~mmap_view() noexcept {
+  unmap_();
+}
+
+
+}} /* namespace monsoon::io */
@@ -38,6 +38,12 @@ bool ptr_stream_reader::at_end() const {
   return nested_->at_end();
 }
 
+auto ptr_stream_reader::read_span(std::size_t len)
+-> std::tuple<const void*, std::size_t> {
+  if (nested_ == nullptr) throw std::logic_error("nullptr reader");
+  return nested_->read_span(len);
+}
+
 
 ptr_stream_writer::ptr_stream_writer(ptr_stream_writer&& o) noexcept
 : nested_(std::move(o.nested_))
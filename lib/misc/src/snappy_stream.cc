@@ -0,0 +1,492 @@
+#include <monsoon/io/snappy_stream.h>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+/*
+ * Implements the snappy framing format:
+ * https://github.com/google/snappy/blob/master/framing_format.txt
+ * with the snappy block format for compressed chunks:
+ * https://github.com/google/snappy/blob/master/format_description.txt
+ */
+
+namespace monsoon {
+namespace io {
+
+
+enum snappy_chunk_type_ : std::uint8_t {
+  COMPRESSED_DATA = 0x00,
+  UNCOMPRESSED_DATA = 0x01,
+  PADDING = 0xfe,
+  STREAM_IDENTIFIER = 0xff
+};
+
+constexpr std::string_view stream_identifier_payload = "sNaPpY";
+constexpr std::size_t chunk_header_size = 4;
+constexpr std::size_t chunk_crc_size = 4;
+constexpr std::size_t max_chunk_data = 65536; // Uncompressed bytes per chunk.
+constexpr std::size_t min_match = 4;
+constexpr unsigned int hash_bits = 14;
+
+constexpr auto make_crc32c_table_() -> std::array<std::uint32_t, 256> {
+  std::array<std::uint32_t, 256> table{};
+  for (std::uint32_t i = 0; i < 256u; ++i) {
+    std::uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+      c = (c & 1u ? 0x82f63b78u ^ (c >> 1) : c >> 1);
+    table[i] = c;
+  }
+  return table;
+}
+
+constexpr std::array<std::uint32_t, 256> crc32c_table = make_crc32c_table_();
+
+/** Masked CRC-32C, as used by the framing format. */
+static auto masked_crc32c_(const std::uint8_t* data, std::size_t len) noexcept
+-> std::uint32_t {
+  std::uint32_t crc = 0xffffffffu;
+  while (len-- > 0)
+    crc = crc32c_table[(crc ^ *data++) & 0xffu] ^ (crc >> 8);
+  crc = ~crc;
+  return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
+
+static auto load_le_(const std::uint8_t* p, std::size_t n) noexcept
+-> std::uint32_t {
+  std::uint32_t v = 0;
+  for (std::size_t i = 0; i < n; ++i) v |= std::uint32_t(p[i]) << (8u * i);
+  return v;
+}
+
+static void store_le_(std::uint8_t* p, std::uint32_t v, std::size_t n) noexcept {
+  for (std::size_t i = 0; i < n; ++i) p[i] = std::uint8_t(v >> (8u * i));
+}
+
+static auto load32_(const std::uint8_t* p) noexcept -> std::uint32_t {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static auto hash_(std::uint32_t v) noexcept -> std::uint32_t {
+  return (v * 0x1e35a7bdu) >> (32u - hash_bits);
+}
+
+static auto emit_literal_(std::uint8_t* op, const std::uint8_t* lit,
+    std::size_t len) noexcept
+-> std::uint8_t* {
+  assert(len > 0);
+  const std::uint32_t n = len - 1u;
+  if (n < 60u) {
+    *op++ = std::uint8_t(n << 2);
+  } else if (n < 0x100u) {
+    *op++ = std::uint8_t(60u << 2);
+    *op++ = std::uint8_t(n);
+  } else {
+    assert(n < 0x10000u);
+    *op++ = std::uint8_t(61u << 2);
+    store_le_(op, n, 2);
+    op += 2;
+  }
+  std::memcpy(op, lit, len);
+  return op + len;
+}
+
+static auto emit_copy_upto_64_(std::uint8_t* op, std::size_t offset,
+    std::size_t len) noexcept
+-> std::uint8_t* {
+  assert(len >= min_match && len <= 64u);
+  assert(offset > 0u && offset < 0x10000u);
+
+  if (len < 12u && offset < 2048u) {
+    *op++ = std::uint8_t(0x01u | ((len - 4u) << 2) | ((offset >> 8) << 5));
+    *op++ = std::uint8_t(offset & 0xffu);
+  } else {
+    *op++ = std::uint8_t(0x02u | ((len - 1u) << 2));
+    store_le_(op, offset, 2);
+    op += 2;
+  }
+  return op;
+}
+
+static auto emit_copy_(std::uint8_t* op, std::size_t offset, std::size_t len)
+    noexcept
+-> std::uint8_t* {
+  // Keep the remainder at least min_match bytes long.
+  while (len >= 68u) {
+    op = emit_copy_upto_64_(op, offset, 64u);
+    len -= 64u;
+  }
+  if (len > 64u) {
+    op = emit_copy_upto_64_(op, offset, 60u);
+    len -= 60u;
+  }
+  return emit_copy_upto_64_(op, offset, len);
+}
+
+/**
+ * Compress a single block of at most max_chunk_data bytes.
+ * \returns End of the compressed data.
+ */
+static auto compress_block_(const std::uint8_t* data, std::size_t len,
+    std::uint8_t* op, std::uint16_t* table) noexcept
+-> std::uint8_t* {
+  assert(len <= max_chunk_data);
+
+  // Uncompressed length, as a varint.
+  for (std::uint32_t v = len; ; v >>= 7) {
+    if (v < 0x80u) {
+      *op++ = std::uint8_t(v);
+      break;
+    }
+    *op++ = std::uint8_t(v | 0x80u);
+  }
+
+  std::size_t next_emit = 0;
+  if (len >= min_match) {
+    std::fill_n(table, std::size_t(1) << hash_bits, std::uint16_t(0));
+
+    std::size_t ip = 1;
+    while (ip + min_match <= len) {
+      const std::uint32_t cur = load32_(data + ip);
+      std::uint16_t& slot = table[hash_(cur)];
+      const std::size_t candidate = slot;
+      slot = std::uint16_t(ip);
+
+      if (candidate >= ip || load32_(data + candidate) != cur) {
+        // Skip faster over data that does not compress.
+        ip += 1u + ((ip - next_emit) >> 5);
+        continue;
+      }
+
+      if (ip != next_emit)
+        op = emit_literal_(op, data + next_emit, ip - next_emit);
+
+      std::size_t match_len = min_match;
+      while (ip + match_len < len
+          && data[candidate + match_len] == data[ip + match_len])
+        ++match_len;
+      op = emit_copy_(op, ip - candidate, match_len);
+
+      ip += match_len;
+      next_emit = ip;
+    }
+  }
+
+  if (next_emit != len)
+    op = emit_literal_(op, data + next_emit, len - next_emit);
+  return op;
+}
+
+/**
+ * Decompress a single block, of at most max_chunk_data bytes.
+ */
+static void decompress_block_(const std::uint8_t* ip, const std::uint8_t* end,
+    std::vector<std::uint8_t>& out) {
+  const auto corrupt = []() {
+    throw std::runtime_error("snappy: corrupt compressed data");
+  };
+
+  std::uint32_t ulen = 0;
+  for (unsigned int shift = 0; ; shift += 7) {
+    if (ip == end || shift > 28) corrupt();
+    const std::uint8_t b = *ip++;
+    ulen |= std::uint32_t(b & 0x7fu) << shift;
+    if ((b & 0x80u) == 0u) break;
+  }
+  if (ulen > max_chunk_data) corrupt();
+
+  out.resize(ulen);
+  std::uint8_t*const out_begin = out.data();
+  std::uint8_t*const out_end = out_begin + ulen;
+  std::uint8_t* op = out_begin;
+
+  while (ip != end) {
+    const std::uint8_t tag = *ip++;
+    std::size_t len, offset;
+
+    switch (tag & 0x03u) {
+      case 0x00u: // Literal.
+        len = (tag >> 2) + 1u;
+        if (len > 60u) {
+          const std::size_t nbytes = len - 60u;
+          if (std::size_t(end - ip) < nbytes) corrupt();
+          len = std::size_t(load_le_(ip, nbytes)) + 1u;
+          ip += nbytes;
+        }
+        if (std::size_t(end - ip) < len || std::size_t(out_end - op) < len)
+          corrupt();
+        std::memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        continue;
+      case 0x01u: // Copy, 1 byte offset.
+        if (end - ip < 1) corrupt();
+        len = ((tag >> 2) & 0x07u) + 4u;
+        offset = (std::size_t(tag >> 5) << 8) | *ip++;
+        break;
+      case 0x02u: // Copy, 2 byte offset.
+        if (end - ip < 2) corrupt();
+        len = (tag >> 2) + 1u;
+        offset = load_le_(ip, 2);
+        ip += 2;
+        break;
+      default: // Copy, 4 byte offset.
+        if (end - ip < 4) corrupt();
+        len = (tag >> 2) + 1u;
+        offset = load_le_(ip, 4);
+        ip += 4;
+        break;
+    }
+
+    if (offset == 0u || offset > std::size_t(op - out_begin)
+        || std::size_t(out_end - op) < len)
+      corrupt();
+    const std::uint8_t* src = op - offset;
+    if (offset >= len) {
+      std::memcpy(op, src, len);
+      op += len;
+    } else {
+      while (len-- > 0) *op++ = *src++; // Overlapping copy.
+    }
+  }
+
+  if (op != out_end) corrupt();
+}
+
+
+basic_snappy_decompress_reader::basic_snappy_decompress_reader(
+    bool verify_stream)
+: verify_stream_(verify_stream)
+{}
+
+basic_snappy_decompress_reader::basic_snappy_decompress_reader(
+    basic_snappy_decompress_reader&& o) noexcept
+: in_(std::move(o.in_)),
+  pending_(std::move(o.pending_)),
+  pending_off_(std::exchange(o.pending_off_, 0u)),
+  stream_id_seen_(o.stream_id_seen_),
+  stream_end_seen_(o.stream_end_seen_),
+  verify_stream_(o.verify_stream_),
+  closed_(std::exchange(o.closed_, true))
+{}
+
+basic_snappy_decompress_reader& basic_snappy_decompress_reader::operator=(
+    basic_snappy_decompress_reader&& o) noexcept {
+  in_ = std::move(o.in_);
+  pending_ = std::move(o.pending_);
+  pending_off_ = std::exchange(o.pending_off_, 0u);
+  stream_id_seen_ = o.stream_id_seen_;
+  stream_end_seen_ = o.stream_end_seen_;
+  verify_stream_ = o.verify_stream_;
+  closed_ = std::exchange(o.closed_, true);
+  return *this;
+}
+
+basic_snappy_decompress_reader::~basic_snappy_decompress_reader() noexcept {}
+
+std::size_t basic_snappy_decompress_reader::read(void* data, std::size_t len) {
+  if (closed_) throw std::logic_error("stream closed");
+
+  if (len == 0) return 0;
+  if (pending_off_ == pending_.size()) {
+    fill_pending_();
+    if (pending_.empty()) return 0;
+  }
+
+  const std::size_t plen = std::min(pending_.size() - pending_off_, len);
+  std::memcpy(data, pending_.data() + pending_off_, plen);
+  pending_off_ += plen;
+  return plen;
+}
+
+bool basic_snappy_decompress_reader::at_end() const {
+  if (closed_) throw std::logic_error("stream closed");
+
+  if (pending_off_ == pending_.size()) fill_pending_();
+  return pending_.empty();
+}
+
+void basic_snappy_decompress_reader::close() {
+  if (closed_) throw std::logic_error("stream closed");
+
+  if (verify_stream_) {
+    while (!stream_end_seen_) fill_pending_(); // Discards data.
+  }
+
+  closed_ = true;
+  reader_().close();
+}
+
+void basic_snappy_decompress_reader::fill_pending_() const {
+  pending_.clear();
+  pending_off_ = 0;
+
+  while (pending_.empty() && !stream_end_seen_) {
+    std::array<std::uint8_t, chunk_header_size> hdr;
+    const std::size_t hdr_len = read_source_(hdr.data(), hdr.size());
+    if (hdr_len == 0u) {
+      stream_end_seen_ = true;
+      break;
+    }
+    if (hdr_len != hdr.size())
+      throw std::runtime_error("snappy: truncated chunk header");
+
+    const std::uint8_t type = hdr[0];
+    const std::size_t len = load_le_(hdr.data() + 1, 3);
+    if (!stream_id_seen_ && type != STREAM_IDENTIFIER)
+      throw std::runtime_error("snappy: missing stream identifier");
+    if (type >= 0x02u && type <= 0x7fu)
+      throw std::runtime_error("snappy: unsupported chunk type");
+
+    in_.resize(len);
+    if (read_source_(in_.data(), len) != len)
+      throw std::runtime_error("snappy: truncated chunk");
+
+    switch (type) {
+      default: // Skippable chunk.
+        break;
+      case STREAM_IDENTIFIER:
+        if (std::string_view(reinterpret_cast<const char*>(in_.data()), in_.size())
+            != stream_identifier_payload)
+          throw std::runtime_error("snappy: invalid stream identifier");
+        stream_id_seen_ = true;
+        break;
+      case COMPRESSED_DATA:
+      case UNCOMPRESSED_DATA:
+        {
+          if (len < chunk_crc_size)
+            throw std::runtime_error("snappy: truncated chunk");
+          const std::uint32_t expected_crc = load_le_(in_.data(), chunk_crc_size);
+          if (type == COMPRESSED_DATA) {
+            decompress_block_(in_.data() + chunk_crc_size, in_.data() + in_.size(),
+                pending_);
+          } else {
+            if (len - chunk_crc_size > max_chunk_data)
+              throw std::runtime_error("snappy: oversized chunk");
+            pending_.assign(in_.begin() + chunk_crc_size, in_.end());
+          }
+          if (masked_crc32c_(pending_.data(), pending_.size()) != expected_crc) {
+            pending_.clear();
+            throw std::runtime_error("snappy: checksum mismatch");
+          }
+        }
+        break;
+    }
+  }
+}
+
+std::size_t basic_snappy_decompress_reader::read_source_(
+    void* data, std::size_t len) const {
+  auto& r = const_cast<basic_snappy_decompress_reader&>(*this).reader_();
+  std::size_t off = 0;
+  while (off < len) {
+    const std::size_t rlen = r.read(
+        reinterpret_cast<std::uint8_t*>(data) + off,
+        len - off);
+    if (rlen == 0) break;
+    off += rlen;
+  }
+  return off;
+}
+
+
+basic_snappy_compress_writer::basic_snappy_compress_writer() {}
+
+basic_snappy_compress_writer::basic_snappy_compress_writer(
+    basic_snappy_compress_writer&& o) noexcept
+: in_(std::move(o.in_)),
+  out_(std::move(o.out_)),
+  hash_table_(std::move(o.hash_table_)),
+  stream_id_written_(o.stream_id_written_),
+  closed_(std::exchange(o.closed_, true))
+{}
+
+basic_snappy_compress_writer& basic_snappy_compress_writer::operator=(
+    basic_snappy_compress_writer&& o) noexcept {
+  in_ = std::move(o.in_);
+  out_ = std::move(o.out_);
+  hash_table_ = std::move(o.hash_table_);
+  stream_id_written_ = o.stream_id_written_;
+  closed_ = std::exchange(o.closed_, true);
+  return *this;
+}
+
+basic_snappy_compress_writer::~basic_snappy_compress_writer() noexcept {}
+
+std::size_t basic_snappy_compress_writer::write(const void* data, std::size_t len) {
+  if (closed_) throw std::logic_error("stream closed");
+
+  if (in_.capacity() < max_chunk_data) in_.reserve(max_chunk_data);
+  const std::size_t wlen = std::min(len, max_chunk_data - in_.size());
+  const auto* bytes = reinterpret_cast<const std::uint8_t*>(data);
+  in_.insert(in_.end(), bytes, bytes + wlen);
+
+  if (in_.size() == max_chunk_data) to_sink_();
+  return wlen;
+}
+
+void basic_snappy_compress_writer::close() {
+  if (closed_) throw std::logic_error("stream closed");
+
+  to_sink_();
+  closed_ = true;
+  writer_().close();
+}
+
+void basic_snappy_compress_writer::to_sink_() {
+  if (!stream_id_written_) {
+    std::array<std::uint8_t, chunk_header_size + stream_identifier_payload.size()> id;
+    id[0] = STREAM_IDENTIFIER;
+    store_le_(id.data() + 1, stream_identifier_payload.size(), 3);
+    std::copy(stream_identifier_payload.begin(), stream_identifier_payload.end(),
+        id.begin() + chunk_header_size);
+    write_fully_(id.data(), id.size());
+    stream_id_written_ = true;
+  }
+  if (in_.empty()) return;
+
+  if (hash_table_.empty()) hash_table_.resize(std::size_t(1) << hash_bits);
+  // Worst case block size, as per the snappy reference implementation.
+  out_.resize(chunk_header_size + chunk_crc_size + 32u + in_.size() + in_.size() / 6u);
+
+  std::uint8_t*const payload = out_.data() + chunk_header_size + chunk_crc_size;
+  const std::uint8_t* payload_end =
+      compress_block_(in_.data(), in_.size(), payload, hash_table_.data());
+
+  std::uint8_t type = COMPRESSED_DATA;
+  // Store incompressible data as is, saving the reader some work.
+  if (std::size_t(payload_end - payload) >= in_.size() - in_.size() / 8u) {
+    type = UNCOMPRESSED_DATA;
+    std::memcpy(payload, in_.data(), in_.size());
+    payload_end = payload + in_.size();
+  }
+
+  const std::size_t chunk_len = chunk_crc_size + (payload_end - payload);
+  out_[0] = type;
+  store_le_(out_.data() + 1, chunk_len, 3);
+  store_le_(out_.data() + chunk_header_size,
+      masked_crc32c_(in_.data(), in_.size()),
+      chunk_crc_size);
+  write_fully_(out_.data(), chunk_header_size + chunk_len);
+  in_.clear();
+}
+
+void basic_snappy_compress_writer::write_fully_(const void* data, std::size_t len) {
+  const auto* bytes = reinterpret_cast<const std::uint8_t*>(data);
+  while (len > 0) {
+    const std::size_t wlen = writer_().write(bytes, len);
+    bytes += wlen;
+    len -= wlen;
+  }
+}
+
+template class monsoon_misc_export_ snappy_decompress_reader<ptr_stream_reader>;
+template class monsoon_misc_export_ snappy_compress_writer<ptr_stream_writer>;
+
+
+}} /* namespace monsoon::io */
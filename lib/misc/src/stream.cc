@@ -5,6 +5,12 @@ namespace io {
 
 
 stream_reader::~stream_reader() noexcept {}
+
+auto stream_reader::read_span([[maybe_unused]] std::size_t len)
+-> std::tuple<const void*, std::size_t> {
+  return { nullptr, 0u };
+}
+
 stream_writer::~stream_writer() noexcept {}
 
 
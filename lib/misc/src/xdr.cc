@@ -1,5 +1,9 @@
 #include <monsoon/xdr/xdr.h>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <type_traits>
 
 namespace monsoon {
 namespace xdr {
@@ -9,31 +13,135 @@ const std::size_t xdr_istream::BUFFER_SIZE = 65536u;
 const std::size_t xdr_istream::MIN_PASSTHROUGH_SIZE = 256u;
 
 xdr_istream::xdr_istream(xdr_istream&& o) noexcept
-: buffer_(std::move(o.buffer_)),
+: buffer_(std::move(o.buffer_)), // Moving a vector keeps its data pointer.
+  window_(std::exchange(o.window_, nullptr)),
+  window_len_(std::exchange(o.window_len_, 0u)),
   buffer_off_(std::exchange(o.buffer_off_, 0u))
 {}
 
 xdr_istream& xdr_istream::operator=(xdr_istream&& o) noexcept {
   buffer_ = std::move(o.buffer_);
+  window_ = std::exchange(o.window_, nullptr);
+  window_len_ = std::exchange(o.window_len_, 0u);
   buffer_off_ = std::exchange(o.buffer_off_, 0u);
   return *this;
 }
 
 xdr_istream::~xdr_istream() noexcept {}
 
+namespace {
+
+
+///\brief Convert big-endian values in place.
+///\details Written as a plain loop, so the compiler can vectorize it.
+template<typename U, typename T>
+void big_to_native_array_(T* v, std::size_t n) noexcept {
+  static_assert(sizeof(U) == sizeof(T));
+
+  for (std::size_t i = 0; i < n; ++i) {
+    U tmp;
+    std::memcpy(&tmp, v + i, sizeof(tmp));
+    tmp = boost::endian::big_to_native(tmp);
+    std::memcpy(v + i, &tmp, sizeof(tmp));
+  }
+}
+
+///\brief Read 16-bit values, which are encoded as 32-bit values.
+template<typename T, typename Fn>
+void get_narrow_array_(std::size_t n, Fn&& read32, T* dst) {
+  std::array<std::uint32_t, 1024> tmp;
+  while (n > 0) {
+    const std::size_t chunk = std::min(n, tmp.size());
+    read32(tmp.data(), chunk);
+    for (std::size_t i = 0; i < chunk; ++i) {
+      const auto v = static_cast<std::int64_t>(
+          std::is_signed_v<T> ? std::int64_t(std::int32_t(tmp[i])) : std::int64_t(tmp[i]));
+      if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max())
+        throw xdr_exception();
+      dst[i] = static_cast<T>(v);
+    }
+    dst += chunk;
+    n -= chunk;
+  }
+}
+
+
+} /* namespace monsoon::xdr::<unnamed> */
+
+void xdr_istream::get_int16_array(std::int16_t* dst, std::size_t n) {
+  get_narrow_array_(n,
+      [this](std::uint32_t* tmp, std::size_t n) { get_uint32_array(tmp, n); },
+      dst);
+}
+
+void xdr_istream::get_uint16_array(std::uint16_t* dst, std::size_t n) {
+  get_narrow_array_(n,
+      [this](std::uint32_t* tmp, std::size_t n) { get_uint32_array(tmp, n); },
+      dst);
+}
+
+void xdr_istream::get_int32_array(std::int32_t* dst, std::size_t n) {
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint32_t>(dst, n);
+}
+
+void xdr_istream::get_uint32_array(std::uint32_t* dst, std::size_t n) {
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint32_t>(dst, n);
+}
+
+void xdr_istream::get_int64_array(std::int64_t* dst, std::size_t n) {
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint64_t>(dst, n);
+}
+
+void xdr_istream::get_uint64_array(std::uint64_t* dst, std::size_t n) {
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint64_t>(dst, n);
+}
+
+void xdr_istream::get_flt32_array(float* dst, std::size_t n) {
+  static_assert(std::numeric_limits<float>::is_iec559,
+      "require IEEE 754 layout.");
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint32_t>(dst, n);
+}
+
+void xdr_istream::get_flt64_array(double* dst, std::size_t n) {
+  static_assert(std::numeric_limits<double>::is_iec559,
+      "require IEEE 754 layout.");
+  get_raw_bytes_(dst, n * sizeof(*dst));
+  big_to_native_array_<std::uint64_t>(dst, n);
+}
+
+auto xdr_istream::get_raw_span([[maybe_unused]] std::size_t len)
+-> std::tuple<const std::uint8_t*, std::size_t> {
+  return { nullptr, 0u };
+}
+
 void xdr_istream::get_raw_bytes_(void* dst_ptr, std::size_t len) {
   std::uint8_t* dst = reinterpret_cast<std::uint8_t*>(dst_ptr);
 
   while (len > 0u) {
-    if (buffer_off_ < buffer_.size()) {
-      const std::size_t rlen = std::min(buffer_.size() - buffer_off_, len);
-      std::copy_n(buffer_.data() + buffer_off_, rlen, dst);
+    if (buffer_off_ < window_len_) {
+      const std::size_t rlen = std::min(window_len_ - buffer_off_, len);
+      std::copy_n(window_ + buffer_off_, rlen, dst);
       len -= rlen;
       dst += rlen;
       buffer_off_ += rlen;
     }
 
-    if (len > 0u && buffer_off_ == buffer_.size()) {
+    if (len > 0u && buffer_off_ == window_len_) {
+      // Zero-copy read.
+      const auto [span, span_len] =
+          get_raw_span(std::numeric_limits<std::size_t>::max());
+      if (span_len != 0u) {
+        window_ = span;
+        window_len_ = span_len;
+        buffer_off_ = 0u;
+        continue;
+      }
+
       if (len > MIN_PASSTHROUGH_SIZE) { // Pass-through read.
         const std::size_t rlen = get_raw_bytes(dst, len);
         assert(rlen <= len);
@@ -46,6 +154,8 @@ void xdr_istream::get_raw_bytes_(void* dst_ptr, std::size_t len) {
         const std::size_t rlen = get_raw_bytes(buffer_.data(), buffer_.size());
         assert(rlen <= buffer_.size());
         buffer_.resize(rlen);
+        window_ = buffer_.data();
+        window_len_ = buffer_.size();
         if (rlen == 0u && at_end_()) throw xdr_stream_end();
       }
     }
@@ -53,7 +163,7 @@ void xdr_istream::get_raw_bytes_(void* dst_ptr, std::size_t len) {
 }
 
 bool xdr_istream::at_end() const {
-  return buffer_off_ == buffer_.size() && at_end_();
+  return buffer_off_ == window_len_ && at_end_();
 }
 
 
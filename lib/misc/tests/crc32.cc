@@ -0,0 +1,55 @@
+#include <monsoon/io/crc32.h>
+#include <boost/crc.hpp>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compare against boost::crc_32_type, which the on-disk format was written with.
+bool check(const std::uint8_t* data, std::size_t len) {
+  boost::crc_32_type expected;
+  expected.process_bytes(data, len);
+
+  monsoon::io::crc32 whole;
+  whole.process_bytes(data, len);
+
+  // Feed the same data in uneven pieces.
+  monsoon::io::crc32 pieces;
+  for (std::size_t off = 0, step = 1; off < len; off += step, step = step * 3 + 1)
+    pieces.process_bytes(data + off, std::min(step, len - off));
+
+  const std::uint32_t sliced = ~monsoon::io::crc32::update_sliced(0xffffffffu, data, len);
+
+  if (whole.checksum() == expected.checksum()
+      && pieces.checksum() == expected.checksum()
+      && sliced == expected.checksum())
+    return true;
+
+  std::cerr << "CRC mismatch for length " << len << std::endl;
+  return false;
+}
+
+int main() {
+  const std::string check_string = "123456789";
+  monsoon::io::crc32 crc;
+  crc.process_bytes(check_string.data(), check_string.size());
+  if (crc.checksum() != 0xcbf43926u) {
+    std::cerr << "CRC check value mismatch" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::uint8_t> data(70000);
+  std::uint32_t noise = 1;
+  for (auto& byte : data) {
+    noise = noise * 1103515245u + 12345u;
+    byte = static_cast<std::uint8_t>(noise >> 16);
+  }
+
+  for (std::size_t offset = 0; offset < 16; ++offset) {
+    for (std::size_t len = 0; len < 300; ++len)
+      if (!check(data.data() + offset, len)) return 1;
+    if (!check(data.data() + offset, data.size() - offset)) return 1;
+  }
+
+  std::cout << "crc32 matches (" << monsoon::io::crc32::implementation() << ")" << std::endl;
+}
@@ -0,0 +1,48 @@
+#include <monsoon/io/crc32.h>
+#include <boost/crc.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Throughput of the CRC-32 implementations, over a 64 KiB segment.
+template<typename Fn>
+void bench(const char* name, const std::vector<std::uint8_t>& data, Fn fn) {
+  constexpr int iterations = 20000;
+  std::uint32_t sink = 0;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) sink += fn(data.data(), data.size());
+  const auto t1 = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  const double mib = double(data.size()) * iterations / (1024.0 * 1024.0);
+  std::cout << name << ": " << mib / seconds << " MiB/s"
+      << " (checksum " << std::hex << sink << std::dec << ")" << std::endl;
+}
+
+int main() {
+  std::vector<std::uint8_t> data(64 * 1024);
+  std::uint32_t noise = 1;
+  for (auto& byte : data) {
+    noise = noise * 1103515245u + 12345u;
+    byte = static_cast<std::uint8_t>(noise >> 16);
+  }
+
+  bench("boost::crc_32_type", data,
+      [](const std::uint8_t* p, std::size_t len) {
+        boost::crc_32_type crc;
+        crc.process_bytes(p, len);
+        return crc.checksum();
+      });
+  bench("slice-by-8", data,
+      [](const std::uint8_t* p, std::size_t len) {
+        return ~monsoon::io::crc32::update_sliced(0xffffffffu, p, len);
+      });
+  bench(monsoon::io::crc32::implementation(), data,
+      [](const std::uint8_t* p, std::size_t len) {
+        monsoon::io::crc32 crc;
+        crc.process_bytes(p, len);
+        return crc.checksum();
+      });
+}
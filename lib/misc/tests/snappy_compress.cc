@@ -0,0 +1,64 @@
+#include <monsoon/io/fd.h>
+#include <monsoon/io/positional_stream.h>
+#include <monsoon/io/snappy_stream.h>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+const std::string message = "No cats were harmed in the making of this test.";
+
+// Repetitive data spanning multiple chunks, with some noise mixed in.
+std::string make_contents() {
+  std::string contents;
+  std::uint32_t noise = 1;
+  for (int i = 0; i < 5000; ++i) {
+    noise = noise * 1103515245u + 12345u;
+    contents += message;
+    contents += std::to_string(noise);
+  }
+  return contents;
+}
+
+void compress(monsoon::io::fd& file, const std::string& contents) {
+  auto remaining = contents.length();
+  auto buf = contents.data();
+
+  auto w = monsoon::io::snappy_compress_writer<monsoon::io::positional_writer>(monsoon::io::positional_writer(file));
+  while (remaining != 0) {
+    auto wlen = w.write(buf, remaining);
+    buf += wlen;
+    remaining -= wlen;
+  }
+  w.close();
+}
+
+std::string decompress(monsoon::io::fd& file) {
+  std::string contents;
+
+  auto r = monsoon::io::snappy_decompress_reader<monsoon::io::positional_reader>(monsoon::io::positional_reader(file), true);
+  while (!r.at_end()) {
+    std::array<std::uint8_t, 1000> buf;
+    auto rlen = r.read(buf.data(), buf.size());
+    contents.append(buf.begin(), buf.begin() + rlen);
+  }
+  r.close();
+
+  return contents;
+}
+
+int main() {
+  auto file = monsoon::io::fd::tmpfile("snappy_compress_test");
+  const std::string contents = make_contents();
+
+  compress(file, contents);
+  if (file.size() >= contents.size()) {
+    std::cout << "data was not compressed\n";
+    return 1;
+  }
+  if (decompress(file) != contents) {
+    std::cout << "decompressed data differs\n";
+    return 1;
+  }
+  std::cout << message;
+}
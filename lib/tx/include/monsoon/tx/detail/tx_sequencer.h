@@ -68,6 +68,7 @@ class monsoon_tx_export_ tx_sequencer
       std::lock_guard<std::shared_mutex> lck{ seq->mtx_ };
 
       std::invoke(std::forward<CB>(cb));
+      commit_count_ = seq->commit_count_.load(std::memory_order_relaxed);
 
       boost::intrusive_ptr<tx_sequencer::record> tmp = record_;
       seq->c_.push_back(*tmp);
@@ -75,6 +76,10 @@ class monsoon_tx_export_ tx_sequencer
     }
 
     tx() = default;
+    tx(const tx&) = delete;
+    tx& operator=(const tx&) = delete;
+    tx(tx&& x) noexcept = default;
+    tx& operator=(tx&& x) noexcept;
     ~tx() noexcept;
 
     /**
@@ -86,6 +91,9 @@ class monsoon_tx_export_ tx_sequencer
      *
      * If there is not replacement at the \p off, the function will clamp
      * \p nbytes appropriately and return 0.
+     *
+     * If no transactions committed after this transaction started,
+     * the read completes without locking.
      * \param[in] off The offset at which to read.
      * \param[out] buf The buffer into which to read.
      * \param[in,out] nbytes The number of bytes that is to be read.
@@ -104,6 +112,8 @@ class monsoon_tx_export_ tx_sequencer
     private:
     std::weak_ptr<tx_sequencer> seq_;
     boost::intrusive_ptr<tx_sequencer::record> record_;
+    ///\brief Value of tx_sequencer::commit_count_ when this transaction started.
+    std::uint64_t commit_count_ = 0;
   };
 
   tx_sequencer() = default;
@@ -121,6 +131,9 @@ class monsoon_tx_export_ tx_sequencer
   ///\brief Collection holding the records of the transactions.
   record_list c_;
   mutable std::shared_mutex mtx_;
+  ///\brief Number of transactions committed.
+  ///\details Modified with mtx_ held.
+  std::atomic<std::uint64_t> commit_count_{ 0 };
 };
 
 
@@ -3,16 +3,18 @@
 
 #include <monsoon/tx/detail/export_.h>
 #include <algorithm>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
-#include <shared_mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <monsoon/io/fd.h>
 #include <monsoon/io/stream.h>
@@ -156,6 +158,7 @@ class monsoon_tx_export_ wal_region {
   ///\brief Constructor tag signaling a newly created file.
   struct create {};
   class tx;
+  class snapshot;
 
   private:
   ///\brief WAL segment sequence number type.
@@ -193,7 +196,7 @@ class monsoon_tx_export_ wal_region {
   wal_region(const wal_region&) = delete;
   wal_region& operator=(wal_region&&) noexcept = delete;
   wal_region& operator=(const wal_region&) = delete;
-  ~wal_region() = default;
+  ~wal_region() noexcept;
 
   ///\brief Retrieve the end of the WAL region.
   auto wal_end_offset() const noexcept -> monsoon::io::fd::offset_type {
@@ -250,30 +253,43 @@ class monsoon_tx_export_ wal_region {
     return fd_;
   }
 
-  auto fd() && -> monsoon::io::fd&& {
-    return std::move(fd_);
-  }
+  ///\brief Release the file descriptor.
+  ///\details Stops background compaction, as the WAL can no longer be used.
+  auto fd() && -> monsoon::io::fd&&;
 
   auto read_at(monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t;
   void compact();
   auto size() const noexcept -> monsoon::io::fd::size_type;
+  ///\brief Retrieve the committed state of the WAL.
+  ///\details The snapshot is not affected by commits that happen later.
+  auto current_snapshot() const noexcept -> std::shared_ptr<const snapshot>;
+
+  ///\brief Default fraction of a WAL segment that is filled before compaction starts.
+  static constexpr double default_compaction_threshold = 0.5;
+  ///\brief Set the fraction of a WAL segment that is filled before background compaction starts.
+  ///\param[in] threshold A fraction between 0 and 1 (inclusive).
+  ///A threshold of 1 disables background compaction.
+  void set_compaction_threshold(double threshold);
 
   private:
   ///\brief Read from the WAL log.
-  ///\details Must be called with mtx_ held for share.
+  ///\param[in] s The snapshot against which the read happens.
+  ///\param[in] off File offset at which the read happens.
+  ///\param[in] buf Buffer into which to read.
+  ///\param[in] len The length of the read.
+  ///\return The number of bytes read.
+  auto read_at_(const snapshot& s, monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t;
+  ///\brief Read from the file, skipping the pending writes.
+  ///\details Reads within the size of the snapshot, past the end of the file, yield zeroes.
+  ///\param[in] s The snapshot against which the read happens.
   ///\param[in] off File offset at which the read happens.
   ///\param[in] buf Buffer into which to read.
   ///\param[in] len The length of the read.
   ///\return The number of bytes read.
-  auto read_at_(monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t;
-  ///\brief Write a WAL record to the log.
-  ///\param[in] r The record to write.
-  ///This should only be set when copying into a new log, until the log is activated.
-  void log_write_(const wal_record& r);
-  ///\brief Write a WAL record to the log, that is encoded in the given byte sequence.
-  ///\param[in] xdr The raw bytes of zero or more WAL records, with a wal_record_end following it.
-  ///This should only be set when copying into a new log, until the log is activated.
-  void log_write_raw_(const monsoon::xdr::xdr_bytevector_ostream<>& xdr);
+  auto read_file_at_(const snapshot& s, monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t;
+  ///\brief Publish a new committed state.
+  ///\details Must be called with log_mtx_ held.
+  void publish_(std::shared_ptr<snapshot>&& s) noexcept;
   /**
    * \brief Compact the log.
    * \details
@@ -282,28 +298,63 @@ class monsoon_tx_export_ wal_region {
    * space available for writes.
    *
    * During compaction, all pending writes will be flushed out as well.
+   *
+   * Must be called with log_mtx_ held and no background compaction running.
    */
   void compact_();
-  ///\brief Write a WAL record for a write to the log.
-  ///\details This is equivalent to calling
-  ///`log_write(wal_record_write(...))`.
-  ///This method elides a copy operation of the buffer, making it a bit faster
-  ///to execute.
-  ///\param[in] tx_id The transaction ID of the write operation.
-  ///\param[in] off The offset at which the write takes place.
-  ///\param[in] buf The buffer holding the data that is to be written.
-  ///\param[in] len The length of the buffer.
-  void tx_write_(wal_record::tx_id_type tx_id, monsoon::io::fd::offset_type off, const void* buf, std::size_t len);
-  ///\brief Write a WAL record for a resize operation to the log.
-  ///\param[in] tx_id The transaction ID of the write operation.
-  ///\param[in] new_size The new file size.
-  void tx_resize_(wal_record::tx_id_type tx_id, monsoon::io::fd::size_type new_size);
+  /**
+   * \brief Ensure the log has space for \p len bytes, compacting if required.
+   * \details
+   * Waits for a running background compaction to complete.
+   * If the log still has insufficient space, compact_() is used as a last resort.
+   * \param[in,out] log_lck Lock on log_mtx_, which is temporarily released while waiting.
+   * \param[in] len The number of bytes that is to be appended to the log.
+   */
+  void make_space_(std::unique_lock<std::mutex>& log_lck, std::size_t len);
+  /**
+   * \brief Compact the log, while allowing records to be appended.
+   * \details
+   * Copies the records of in-progress transactions into the other slot
+   * and writes out the pending writes without holding log_mtx_.
+   * Records appended in the mean time are copied afterwards,
+   * after which the other slot is activated.
+   * \param[in,out] log_lck Lock on log_mtx_, which is released during the copy.
+   */
+  void compact_background_(std::unique_lock<std::mutex>& log_lck);
+  ///\brief Body of the compactor thread.
+  void compactor_run_() noexcept;
+  ///\brief Stop the compactor thread, waiting for a running compaction to complete.
+  void stop_compactor_() noexcept;
+  ///\brief Wake up the compactor thread, if the log passed the compaction threshold.
+  ///\details Must be called with log_mtx_ held.
+  void maybe_start_compaction_() noexcept;
+  ///\brief Compute the offset at which the next background compaction starts.
+  ///\details Must be called with log_mtx_ held.
+  void update_compaction_trigger_() noexcept;
+  ///\brief Recompute the available transaction IDs after a compaction.
+  ///\details Must be called with alloc_mtx_ held.
+  ///\param[in] copied_states The transaction states at the start of the compaction.
+  ///Transactions that were in progress then had their records copied into
+  ///the new segment, so their IDs can't be reused until the next compaction.
+  void reset_tx_ids_(const std::vector<bool>& copied_states) noexcept;
   ///\brief Write a commit message to the log.
   ///\param[in] tx_id The transaction ID of the commit operation.
   ///\param[in] writes The writes done as part of this transaction.
   ///\param[in] new_file_size If present, a file size modification operation.
   ///\return A replacement_map recording for all replaced data in the file, what the before-commit contents was.
   void tx_commit_(wal_record::tx_id_type tx_id, replacement_map&& writes, std::optional<monsoon::io::fd::size_type> new_file_size, std::function<void(replacement_map)> undo_op_fn);
+  ///\brief A commit waiting to be written to the log.
+  struct pending_commit_;
+  ///\brief Write a batch of commits to the log.
+  ///\details
+  ///The write and resize records of each transaction are written together
+  ///with its commit record, so the batch needs one flush for the records
+  ///and one for the marker activating them.
+  ///Commits are applied in the order of the batch.
+  ///Commits that fail have their exception recorded.
+  ///\return The number of commits that were processed.
+  ///Commits after those are to be retried in a later batch.
+  auto commit_batch_(const std::vector<pending_commit_*>& batch) noexcept -> std::size_t;
   ///\brief Mark a transaction as canceled.
   void tx_rollback_(wal_record::tx_id_type tx_id) noexcept;
 
@@ -317,6 +368,10 @@ class monsoon_tx_export_ wal_region {
   std::size_t current_slot_;
   ///\brief Append offset in the slot.
   monsoon::io::fd::offset_type slot_off_;
+  ///\brief Fraction of a WAL segment that is filled before compaction starts.
+  double compaction_threshold_ = default_compaction_threshold;
+  ///\brief Append offset at which background compaction is started.
+  monsoon::io::fd::offset_type compaction_trigger_off_;
 
   ///\brief Vector where tx_id is the index and bool indicates wether the transaction is in progress.
   ///\details A transaction that is in progress has been started, but has neither been committed, nor been rolled back.
@@ -330,37 +385,91 @@ class monsoon_tx_export_ wal_region {
   ///This holds the value `std::count(tx_id_states_.cbegin(), tx_id_states_.cend(), false)`.
   std::vector<bool>::size_type tx_id_completed_count_ = 0;
 
-  ///\brief Mutex providing read/write access to the file, excluding the WAL.
-  ///\details
-  ///Parts of the file covered by repl_ are not protected with this mutex (but repl_ itself is).
-  ///Instead, the log_mtx_ covers those sections.
-  ///
-  ///This mutex may not be locked with alloc_mtx_ held.
-  mutable std::shared_mutex mtx_;
   ///\brief Mutex providing access to the WAL.
   ///\details
-  ///This mutex may not be locked with mtx_ or alloc_mtx_ held.
+  ///This mutex may not be locked with alloc_mtx_ held.
+  ///It serializes changes to state_ and writes to the file, excluding the WAL.
   mutable std::mutex log_mtx_;
+  ///\brief Mutex protecting the commit queue.
+  ///\details
+  ///This mutex is never held while other mutexes are acquired.
+  std::mutex commit_mtx_;
+  ///\brief Signals completion of a batch of commits.
+  std::condition_variable commit_cnd_;
+  ///\brief Commits that will be written by the next batch.
+  std::deque<pending_commit_*> commit_queue_;
+  ///\brief Set while a thread is writing a batch of commits.
+  bool commit_leader_ = false;
+  ///\brief Signals the compactor thread and waiters for background compaction.
+  ///\details Used with log_mtx_.
+  std::condition_variable compactor_cnd_;
+  ///\brief Set when the compactor thread is to start a compaction.
+  ///\details Protected by log_mtx_.
+  bool compactor_wanted_ = false;
+  ///\brief Set when the compactor thread is to exit.
+  ///\details Protected by log_mtx_.
+  bool compactor_stop_ = false;
+  ///\brief Set while a background compaction is copying the log.
+  ///\details Protected by log_mtx_.
+  ///While set, records may be appended to the current slot,
+  ///but the other slot belongs to the compactor.
+  bool compacting_ = false;
   ///\brief Mutex providing access to the allocator data.
   ///\details
   ///Protects tx_id_states_ and tx_id_avail_.
   mutable std::mutex alloc_mtx_;
   ///\brief File descriptor.
   monsoon::io::fd fd_;
-  ///\brief Current size of the file.
-  monsoon::io::fd::size_type fd_size_;
-  ///\brief Pending writes.
-  replacement_map repl_;
+  ///\brief Committed state: the current size of the file and pending writes.
+  ///\details
+  ///Published snapshots are never modified:
+  ///changes are made by replacing the pointer, using std::atomic_store.
+  ///Readers load the pointer using std::atomic_load.
+  ///Writers hold log_mtx_, and may read the pointer directly.
+  std::shared_ptr<snapshot> state_;
 
   ///\brief Instrumentation.
-  instrumentation::counter commit_count_, write_ops_, compactions_, file_flush_;
+  instrumentation::counter commit_count_, write_ops_, compactions_, background_compactions_, file_flush_;
+  ///\brief Thread running background compactions.
+  ///\details Only started if the file is writable.
+  std::thread compactor_;
+};
+
+
+/**
+ * \brief Immutable view of the committed state of a WAL region.
+ * \details
+ * A snapshot holds the file size and pending writes as of the moment it
+ * was taken.
+ * Snapshots are shared between readers, and read without locking.
+ * Data that was already written to the file may be overwritten
+ * after the snapshot was taken (see wal_region::tx::read_at).
+ */
+class monsoon_tx_export_ wal_region::snapshot {
+  friend wal_region;
+  friend wal_region::tx;
+  friend wal_record_write;
+  friend wal_record_resize;
+
+  public:
+  ///\brief Size of the file.
+  auto size() const noexcept -> monsoon::io::fd::size_type {
+    return fd_size_;
+  }
+
+  private:
+  ///\brief Size of the file.
+  monsoon::io::fd::size_type fd_size_ = 0;
+  ///\brief Pending writes.
+  replacement_map repl_;
 };
 
 
 /**
  * \brief Transaction for WAL region.
  * \details
- * A WAL transaction runs at read-committed isolation.
+ * A WAL transaction runs at read-committed isolation,
+ * unless reads are performed against a snapshot.
  */
 class monsoon_tx_export_ wal_region::tx {
   public:
@@ -409,19 +518,23 @@ class monsoon_tx_export_ wal_region::tx {
   void rollback() noexcept;
 
   ///\brief Read operation.
-  ///\details Performs a read.
-  ///The data visible to the read operation is the set of committed transactions.
+  ///\details Performs a read against a snapshot.
+  ///The data visible to the read operation is the set of transactions
+  ///that were committed when the snapshot was taken.
   ///
-  ///The \p fn callback is invoked between reading the transaction-local information
-  ///and the WAL-committed information.
+  ///Data in the file may be overwritten by commits after the snapshot was taken.
+  ///The \p undo_fn callback is invoked on data read from the file,
+  ///and must fill in the before-images of those commits.
+  ///It has the same signature as replacement_map::read_at.
+  ///\param[in] s The snapshot against which the read happens.
   ///\param[in] off The file offset to read from.
   ///\param[out] buf The buffer to read data into.
   ///\param[in] len The size of the buffer.
-  ///\param[in] fn An invokable that is to participate in the read_at operation.
+  ///\param[in] undo_fn An invokable that supplies data overwritten after the snapshot.
   ///\return The number of bytes read.
   ///\throws std::bad_weak_ptr if the transaction is invalid.
-  template<typename IntermediateFn>
-  auto read_at(monsoon::io::fd::offset_type off, void* buf, std::size_t len, IntermediateFn&& fn) const -> std::size_t {
+  template<typename UndoFn>
+  auto read_at(const snapshot& s, monsoon::io::fd::offset_type off, void* buf, std::size_t len, UndoFn&& undo_fn) const -> std::size_t {
     const auto wal = std::shared_ptr<wal_region>(wal_);
 
     // If the transaction has an altered file size, apply it.
@@ -436,19 +549,22 @@ class monsoon_tx_export_ wal_region::tx {
       if (local_rlen != 0u) return local_rlen;
     }
 
-    // The callback and the WAL both are protected using the mtx_.
-    std::shared_lock<std::shared_mutex> lck{ wal->mtx_ };
-
-    // Second, evaluate callback read operation.
-    {
-      const auto fn_rlen = std::invoke(std::forward<IntermediateFn>(fn), off, buf, len); // May update len.
-      if (fn_rlen != 0u) return fn_rlen;
+    // Second, evaluate pending writes in the snapshot.
+    if (off < s.size()) {
+      if (len > s.size() - off) len = s.size() - off;
+      const auto repl_rlen = s.repl_.read_at(off, buf, len); // May update len.
+      if (repl_rlen != 0u) return repl_rlen;
     }
 
-    // Third, read directly from the WAL.
+    // Third, read from the file and undo later commits.
     {
-      const auto wal_rlen = wal->read_at_(off, buf, len);
-      if (wal_rlen != 0u) return wal_rlen;
+      const auto file_rlen = wal->read_file_at_(s, off, buf, len);
+      for (std::size_t i = 0; i < file_rlen; ) {
+        std::size_t undo_len = file_rlen - i;
+        const auto undo_rlen = std::invoke(undo_fn, off + i, reinterpret_cast<std::uint8_t*>(buf) + i, undo_len); // May update undo_len.
+        i += (undo_rlen != 0u ? undo_rlen : undo_len);
+      }
+      if (file_rlen != 0u) return file_rlen;
     }
 
     // If nothing can provide data, pretend the file is zero-filled.
@@ -479,8 +595,10 @@ class monsoon_tx_export_ wal_region::tx {
   ///\brief Reference to the WAL.
   std::weak_ptr<wal_region> wal_;
   ///\brief Writes performed in this transaction.
+  ///\details Logged when the transaction commits.
   replacement_map writes_;
   ///\brief Recorded change in file size.
+  ///\details Logged when the transaction commits.
   std::optional<monsoon::io::fd::size_type> new_file_size_;
   ///\brief Internal transaction ID.
   wal_record::tx_id_type tx_id_;
@@ -54,7 +54,15 @@ class monsoon_tx_export_ txfile_read_only_transaction
  *
  * The model of the transaction isolation implemented by this file is the repeatable read isolation:
  * - the transaction will see all of the data committed before it started.
- * - the transaction will see none of the data committed before it started.
+ * - the transaction will see none of the data committed after it started.
+ *
+ * Transactions read from a snapshot of the WAL that is taken when they start.
+ * Data in the file that is overwritten after that, is read from the
+ * before-images recorded by later commits.
+ * Neither requires a lock shared with committing transactions,
+ * so readers and writers don't stall each other.
+ * Snapshots and before-images are released once the last transaction
+ * that can observe them completes.
  *
  * Furthermore, this class guarantees that data that was successfully committed
  * will be stored on disk even in the event of a crash of the binary or the system.
@@ -203,6 +211,7 @@ class monsoon_tx_export_ txfile::transaction {
     using std::swap;
     swap(x.read_only_, y.read_only_);
     swap(x.owner_, y.owner_);
+    swap(x.snapshot_, y.snapshot_);
     swap(x.seq_, y.seq_);
     swap(x.wal_, y.wal_);
   }
@@ -220,6 +229,7 @@ class monsoon_tx_export_ txfile::transaction {
   transaction(transaction&& x) noexcept
   : read_only_(x.read_only_),
     owner_(std::exchange(x.owner_, nullptr)),
+    snapshot_(std::move(x.snapshot_)),
     seq_(std::move(x.seq_)),
     wal_(std::move(x.wal_))
   {}
@@ -234,6 +244,7 @@ class monsoon_tx_export_ txfile::transaction {
     if (*this) rollback();
     read_only_ = x.read_only_;
     owner_ = std::exchange(x.owner_, nullptr);
+    snapshot_ = std::move(x.snapshot_);
     seq_ = std::move(x.seq_);
     wal_ = std::move(x.wal_);
     return *this;
@@ -299,6 +310,9 @@ class monsoon_tx_export_ txfile::transaction {
   private:
   bool read_only_;
   impl_* owner_ = nullptr;
+  ///\brief Snapshot of the WAL when the transaction started.
+  ///\details Declared before seq_, as it is assigned while seq_ is constructed.
+  std::shared_ptr<const detail::wal_region::snapshot> snapshot_;
   ///\brief Hold on to the transaction sequencer.
   detail::tx_sequencer::tx seq_;
   ///\brief Hold on to the WAL transaction.
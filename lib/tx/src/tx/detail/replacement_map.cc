@@ -1,4 +1,5 @@
 #include <monsoon/tx/detail/replacement_map.h>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 
@@ -113,6 +114,12 @@ auto replacement_map::write_at_from_file(monsoon::io::fd::offset_type off, const
   std::uint8_t* buffer_pos = buffer.get();
   while (fd_nbytes > 0) {
     const auto rlen = fd.read_at(fd_off, buffer_pos, fd_nbytes);
+    if (rlen == 0u) {
+      // Past the end of the file, which reads as zeroes
+      // (the file may not have been extended yet).
+      std::fill_n(buffer_pos, fd_nbytes, std::uint8_t(0));
+      break;
+    }
     buffer_pos += rlen;
     fd_off += rlen;
     fd_nbytes -= rlen;
@@ -3,6 +3,16 @@
 namespace monsoon::tx::detail {
 
 
+auto tx_sequencer::tx::operator=(tx&& x) noexcept -> tx& {
+  if (this != &x) {
+    [[maybe_unused]] const tx discard = std::move(*this);
+    seq_ = std::move(x.seq_);
+    record_ = std::move(x.record_);
+    commit_count_ = x.commit_count_;
+  }
+  return *this;
+}
+
 tx_sequencer::tx::~tx() noexcept {
   const auto seq = seq_.lock();
   if (record_ != nullptr && !record_->committed && seq != nullptr) {
@@ -15,6 +25,9 @@ tx_sequencer::tx::~tx() noexcept {
 
 auto tx_sequencer::tx::read_at(monsoon::io::fd::offset_type off, void* buf, std::size_t& nbytes) const -> std::size_t {
   const auto seq = std::shared_ptr<tx_sequencer>(seq_);
+  // Data is only replaced by transactions that committed after we started.
+  if (seq->commit_count_.load(std::memory_order_acquire) == commit_count_) return 0;
+
   std::shared_lock<std::shared_mutex> lck{ seq->mtx_ };
 
   for (record_list::const_iterator iter = seq->c_.iterator_to(*record_);
@@ -36,6 +49,7 @@ void tx_sequencer::tx::commit(replacement_map&& undo_map) noexcept {
   record_->replaced = std::move(undo_map);
   record_->committed = true;
   seq->c_.push_back(*record_);
+  seq->commit_count_.fetch_add(1u, std::memory_order_release);
   record_.detach();
   seq->do_maintenance_();
 
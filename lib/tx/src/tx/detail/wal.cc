@@ -1,6 +1,8 @@
 #include <monsoon/tx/detail/wal.h>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <tuple>
@@ -119,7 +121,7 @@ class wal_record_write
   }
 
   auto do_apply(wal_region& wal) const -> void override {
-    wal.repl_.write_at(offset, data.data(), data.size()).commit();
+    wal.state_->repl_.write_at(offset, data.data(), data.size()).commit();
   }
 
   std::uint64_t offset;
@@ -153,7 +155,7 @@ class wal_record_resize
   }
 
   auto do_apply(wal_region& wal) const -> void override {
-    wal.fd_size_ = new_size;
+    wal.state_->fd_size_ = new_size;
   }
 
   std::uint64_t new_size;
@@ -198,7 +200,7 @@ auto wal_record::read(monsoon::xdr::xdr_istream& in) -> std::unique_ptr<wal_reco
   }
 
   assert(result != nullptr
-      && static_cast<std::uint32_t>(result->get_wal_entry()) == discriminant);
+      && static_cast<std::uint32_t>(result->get_wal_entry()) == (discriminant & 0xffu));
   return result;
 }
 
@@ -257,6 +259,7 @@ wal_region::wal_region(std::string name, monsoon::io::fd&& fd, monsoon::io::fd::
   commit_count_("monsoon.wal.commits", {{"name", name}}),
   write_ops_("monsoon.wal.writes", {{"name", name}}),
   compactions_("monsoon.wal.compactions", {{"name", name}}),
+  background_compactions_("monsoon.wal.background_compactions", {{"name", name}}),
   file_flush_("monsoon.wal.file_flush", {{"name", name}})
 {
   static_assert(num_segments_ == 2u, "Algorithm assumes two segments.");
@@ -276,7 +279,8 @@ wal_region::wal_region(std::string name, monsoon::io::fd&& fd, monsoon::io::fd::
   current_slot_ = std::get<std::size_t>(segments[0]);
   const auto old_slot = 1u - current_slot_;
   const auto old_data = read_segment_(old_slot);
-  fd_size_ = old_data.file_size;
+  state_ = std::make_shared<snapshot>();
+  state_->fd_size_ = old_data.file_size;
   current_seq_ = old_data.seq + 1u;
 
   // In-memory application of the WAL log.
@@ -313,23 +317,26 @@ wal_region::wal_region(std::string name, monsoon::io::fd&& fd, monsoon::io::fd::
 
     // Write all pending writes.
     monsoon::io::aio aio;
-    for (const auto& w : repl_)
+    for (const auto& w : state_->repl_)
       aio.on(fd_).write_at(w.begin_offset() + wal_end_offset(), w.data(), w.size());
     aio.start_and_join();
-    repl_.clear();
-    fd_.truncate(monsoon::io::fd::size_type(wal_end_offset()) + fd_size_);
+    state_->repl_.clear();
+    fd_.truncate(monsoon::io::fd::size_type(wal_end_offset()) + state_->fd_size_);
     fd_.flush(true);
     ++file_flush_;
 
     // Start a new segment.
     auto xdr = monsoon::xdr::xdr_stream_writer<lp_writer>(lp_writer(segment_len_(), fd_, slot_begin_off(current_slot_)));
-    wal_header(current_seq_, fd_size_).write(xdr);
+    wal_header(current_seq_, state_->fd_size_).write(xdr);
     slot_off_ = xdr.underlying_stream().offset();
     wal_record_end().write(xdr);
 
     // Flush data onto disk.
     fd_.flush(true);
     ++file_flush_;
+
+    update_compaction_trigger_();
+    compactor_ = std::thread(&wal_region::compactor_run_, this);
   }
 }
 
@@ -339,10 +346,11 @@ wal_region::wal_region(std::string name, [[maybe_unused]] create c, monsoon::io:
   current_seq_(0),
   current_slot_(0),
   fd_(std::move(fd)),
-  fd_size_(0),
+  state_(std::make_shared<snapshot>()),
   commit_count_("monsoon.wal.commits", {{"name", name}}),
   write_ops_("monsoon.wal.writes", {{"name", name}}),
   compactions_("monsoon.wal.compactions", {{"name", name}}),
+  background_compactions_("monsoon.wal.background_compactions", {{"name", name}}),
   file_flush_("monsoon.wal.file_flush", {{"name", name}})
 {
   using lp_writer = monsoon::io::limited_stream_writer<monsoon::io::positional_writer>;
@@ -368,6 +376,18 @@ wal_region::wal_region(std::string name, [[maybe_unused]] create c, monsoon::io:
   // file metadata synced up. Because it seems like a nice thing to do.
   fd_.flush();
   ++file_flush_;
+
+  update_compaction_trigger_();
+  compactor_ = std::thread(&wal_region::compactor_run_, this);
+}
+
+wal_region::~wal_region() noexcept {
+  stop_compactor_();
+}
+
+auto wal_region::fd() && -> monsoon::io::fd&& {
+  stop_compactor_();
+  return std::move(fd_);
 }
 
 auto wal_region::allocate_tx_id() -> wal_record::tx_id_type {
@@ -382,7 +402,7 @@ auto wal_region::allocate_tx_id() -> wal_record::tx_id_type {
     // Compact the WAL log by replaying it.
     // We must release the lock temporarily, hence why this part is in a loop.
     lck.unlock();
-    compact_();
+    compact();
     lck.lock();
   }
 
@@ -434,34 +454,64 @@ auto wal_region::read_segment_(std::size_t idx) const -> wal_vector {
 }
 
 auto wal_region::read_at(monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t {
-  std::shared_lock<std::shared_mutex> lck{ mtx_ };
-  return read_at_(off, buf, len);
+  return read_at_(*current_snapshot(), off, buf, len);
 }
 
 void wal_region::compact() {
-  std::lock_guard<std::mutex> lck{ log_mtx_ };
+  std::unique_lock<std::mutex> lck{ log_mtx_ };
+  compactor_cnd_.wait(lck, [this]() { return !compacting_; });
   compact_();
 }
 
+void wal_region::set_compaction_threshold(double threshold) {
+  if (!(threshold >= 0.0 && threshold <= 1.0))
+    throw std::invalid_argument("WAL compaction threshold must be between 0 and 1");
+
+  std::lock_guard<std::mutex> lck{ log_mtx_ };
+  compaction_threshold_ = threshold;
+  if (compactor_.joinable()) {
+    update_compaction_trigger_();
+    maybe_start_compaction_();
+  }
+}
+
 auto wal_region::size() const noexcept -> monsoon::io::fd::size_type {
-  std::shared_lock<std::shared_mutex> lck{ mtx_ };
-  return fd_size_;
+  return current_snapshot()->size();
 }
 
-auto wal_region::read_at_(monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t {
+auto wal_region::current_snapshot() const noexcept -> std::shared_ptr<const snapshot> {
+  return std::atomic_load(&state_);
+}
+
+void wal_region::publish_(std::shared_ptr<snapshot>&& s) noexcept {
+  std::atomic_store(&state_, std::move(s));
+}
+
+auto wal_region::read_at_(const snapshot& s, monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t {
   // Reads past the logic end of the file will fail.
-  if (off >= fd_size_) return 0;
+  if (off >= s.fd_size_) return 0;
   // Clamp len, so we won't perform reads past-the-end.
-  if (len > fd_size_ - off) len = fd_size_ - off;
+  if (len > s.fd_size_ - off) len = s.fd_size_ - off;
   // Zero length reads are very easy.
   if (len == 0u) return 0u;
 
   // Try to read from the list of pending writes.
-  const auto repl_rlen = repl_.read_at(off, buf, len); // May modify len.
+  const auto repl_rlen = s.repl_.read_at(off, buf, len); // May modify len.
   if (repl_rlen != 0u) return repl_rlen;
   assert(len != 0u);
 
   // We have to fall back to the file.
+  return read_file_at_(s, off, buf, len);
+}
+
+auto wal_region::read_file_at_(const snapshot& s, monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t {
+  // Reads past the logic end of the file will fail.
+  if (off >= s.fd_size_) return 0;
+  // Clamp len, so we won't perform reads past-the-end.
+  if (len > s.fd_size_ - off) len = s.fd_size_ - off;
+  // Zero length reads are very easy.
+  if (len == 0u) return 0u;
+
   const auto read_rlen = fd_.read_at(off + wal_end_offset(), buf, len);
   if (read_rlen != 0u) [[likely]] return read_rlen;
   assert(len != 0u);
@@ -473,87 +523,23 @@ auto wal_region::read_at_(monsoon::io::fd::offset_type off, void* buf, std::size
   return len;
 }
 
-void wal_region::log_write_(const wal_record& r) {
-  assert(!r.is_commit()); // Commit is special cased.
-
-  monsoon::xdr::xdr_bytevector_ostream<> xdr;
-  r.write(xdr);
-  assert(xdr.size() >= wal_record_end::XDR_SIZE);
-  wal_record_end().write(xdr);
-
-  log_write_raw_(xdr);
-}
-
-void wal_region::log_write_raw_(const monsoon::xdr::xdr_bytevector_ostream<>& xdr) {
-  std::lock_guard<std::mutex> lck{ log_mtx_ };
-
-  assert(slot_begin_off(current_slot_) <= slot_off_ && slot_off_ < slot_end_off(current_slot_));
-
-#ifndef NDEBUG // Assert that the slot offset contains a record-end-marker.
-  {
-    using lp_reader = monsoon::io::limited_stream_reader<monsoon::io::positional_reader>;
-
-    assert(slot_end_off(current_slot_) - slot_off_ >= wal_record_end::XDR_SIZE);
-
-    auto xdr_read = monsoon::xdr::xdr_stream_reader<lp_reader>(lp_reader(wal_record_end::XDR_SIZE, fd_, slot_off_));
-    const auto last_record = wal_record::read(xdr_read);
-    assert(last_record->is_end());
-    assert(xdr_read.at_end());
-  }
-#endif
-
-  // Run a compaction cycle if the log has insuficient space for the new data.
-  if (slot_end_off(current_slot_) - slot_off_ < xdr.size()) {
-    compact_();
-
-    if (slot_end_off(current_slot_) - slot_off_ < xdr.size())
-      throw wal_bad_alloc("no space in WAL");
-  }
-
-  // Perform write-ahead of the record.
-  {
-    auto buf = xdr.data() + wal_record_end::XDR_SIZE;
-    auto len = xdr.size() - wal_record_end::XDR_SIZE;
-    auto off = slot_off_ + wal_record_end::XDR_SIZE;
-    while (len > 0u) {
-      const auto wlen = fd_.write_at(off, buf, len);
-      buf += wlen;
-      len -= wlen;
-      off += wlen;
-    }
-  }
-  fd_.flush(true);
-  ++file_flush_;
-
-  // Write the marker of the record.
-  {
-    auto buf = xdr.data();
-    auto len = wal_record_end::XDR_SIZE;
-    auto off = slot_off_;
-    while (len > 0u) {
-      const auto wlen = fd_.write_at(off, buf, len);
-      buf += wlen;
-      len -= wlen;
-      off += wlen;
-    }
-  }
-
-  // Advance slot offset.
-  slot_off_ += xdr.size() - wal_record_end::XDR_SIZE;
-
-  ++write_ops_;
-}
-
 void wal_region::compact_() {
+  assert(!compacting_);
+
+  // Transactions that are in progress.
+  // New transactions can't write records while we hold log_mtx_,
+  // so they don't need to be copied.
+  std::vector<bool> tx_id_states;
   {
     // Don't run a compaction if we know we won't free up any information.
     std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
     if (tx_id_completed_count_ == 0u) return;
+    tx_id_states = tx_id_states_;
   }
 
   ++compactions_;
   monsoon::xdr::xdr_bytevector_ostream<> wal_segment_header;
-  wal_header(current_seq_ + 1u, fd_size_).write(wal_segment_header);
+  wal_header(current_seq_ + 1u, state_->fd_size_).write(wal_segment_header);
 
   using lp_writer = monsoon::io::limited_stream_writer<monsoon::io::positional_writer>;
 
@@ -572,12 +558,12 @@ void wal_region::compact_() {
             return !record.is_control_record();
           })
       .filter( // Only valid transaction IDs.
-          [this](const auto& record) -> bool {
-            return tx_id_states_.size() > record.tx_id();
+          [&tx_id_states](const auto& record) -> bool {
+            return tx_id_states.size() > record.tx_id();
           })
       .filter( // Only copy in-progress transactions.
-          [this](const auto& record) -> bool {
-            return tx_id_states_[record.tx_id()];
+          [&tx_id_states](const auto& record) -> bool {
+            return tx_id_states[record.tx_id()];
           })
       .for_each(
           [&xdr](const auto& record) {
@@ -589,17 +575,20 @@ void wal_region::compact_() {
   wal_record_end().write(xdr);
 
   // Apply the replacement map.
+  // Readers don't access these parts of the file,
+  // as they are covered by the pending writes in the snapshot they use.
   {
-    std::lock_guard<std::shared_mutex> lck{ mtx_ };
     monsoon::io::aio aio;
-    for (const auto& r : repl_)
+    for (const auto& r : state_->repl_)
       aio.on(fd_).write_at(r.begin_offset() + wal_end_offset(), r.data(), r.size());
     // Ensure all data is on disk, before activating the segment.
     aio.on(fd_).flush(true);
     ++file_flush_;
     aio.start_and_join();
     // Now that the replacement map is written out, we can clear it.
-    repl_.clear();
+    auto new_state = std::make_shared<snapshot>();
+    new_state->fd_size_ = state_->fd_size_;
+    publish_(std::move(new_state));
   }
 
   // Now that all the writes from the old segment have been applied,
@@ -625,180 +614,532 @@ void wal_region::compact_() {
 
   {
     std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
-    // Update tx_id allocation state.
-    while (!tx_id_states_.empty() && !tx_id_states_.back())
-      tx_id_states_.pop_back();
-    while (!tx_id_avail_.empty()) tx_id_avail_.pop(); // tx_id_avail_ lacks a clear() method.
-    for (wal_record::tx_id_type tx_id = 0u; tx_id < tx_id_states_.size() && tx_id <= wal_record::tx_id_mask; ++tx_id) {
-      if (!tx_id_states_[tx_id]) {
-        try {
-          tx_id_avail_.push(tx_id);
-        } catch (const std::bad_alloc&) {
-          // SKIP: ignore this exception
-        }
-      }
-    }
+    reset_tx_ids_(tx_id_states);
   }
 
   // Update segment information.
   current_slot_ = new_slot;
   slot_off_ = new_slot_off;
   ++current_seq_;
-  tx_id_completed_count_ = 0;
+  update_compaction_trigger_();
 }
 
-void wal_region::tx_write_(wal_record::tx_id_type tx_id, monsoon::io::fd::offset_type off, const void* buf, std::size_t len) {
-  monsoon::xdr::xdr_bytevector_ostream<> xdr;
-  wal_record_write::to_stream(xdr, tx_id, off, buf, len);
-  assert(xdr.size() >= wal_record_end::XDR_SIZE);
-  wal_record_end().write(xdr);
+void wal_region::make_space_(std::unique_lock<std::mutex>& log_lck, std::size_t len) {
+  assert(log_lck.owns_lock() && log_lck.mutex() == &log_mtx_);
+
+  // A running background compaction may free up the space we need.
+  compactor_cnd_.wait(log_lck, [this]() { return !compacting_; });
+  if (slot_end_off(current_slot_) - slot_off_ >= len) return;
 
-  log_write_raw_(xdr);
+  // Last resort: compact the log while holding the lock.
+  compact_();
 }
 
-void wal_region::tx_resize_(wal_record::tx_id_type tx_id, monsoon::io::fd::size_type new_size) {
-  if (new_size > std::numeric_limits<std::uint64_t>::max())
-    throw std::overflow_error("wal_region::tx::resize");
+namespace {
+
+///\brief Remove the data that was written out to the file from a replacement map.
+///\details
+///Data in \p repl that equals the data in \p applied, is present in the file.
+///Data that differs was written after \p applied was taken, and must be kept.
+auto without_applied(const replacement_map& repl, const replacement_map& applied) -> replacement_map {
+  replacement_map result;
+  std::vector<std::uint8_t> buf;
+
+  for (const auto& r : repl) {
+    const auto data = reinterpret_cast<const std::uint8_t*>(r.data());
+    auto off = r.begin_offset();
+    while (off < r.end_offset()) {
+      std::size_t len = r.end_offset() - off;
+      buf.resize(len);
+      const auto rlen = applied.read_at(off, buf.data(), len); // May modify len.
+      const auto local = data + (off - r.begin_offset());
+
+      if (rlen == 0u) { // Not applied.
+        result.write_at(off, local, len).commit();
+        off += len;
+        continue;
+      }
 
-  log_write_(wal_record_resize(tx_id, new_size));
+      // Keep the runs of bytes that differ.
+      std::size_t i = 0;
+      while (i < rlen) {
+        const std::size_t run_begin = std::mismatch(local + i, local + rlen, buf.data() + i).first - local;
+        const std::size_t run_end = std::mismatch(local + run_begin, local + rlen, buf.data() + run_begin, std::not_equal_to<std::uint8_t>()).first - local;
+        if (run_begin != run_end)
+          result.write_at(off + run_begin, local + run_begin, run_end - run_begin).commit();
+        i = run_end;
+      }
+      off += rlen;
+    }
+  }
+
+  return result;
 }
 
-void wal_region::tx_commit_(wal_record::tx_id_type tx_id, replacement_map&& writes, std::optional<monsoon::io::fd::size_type> new_file_size, std::function<void(replacement_map)> undo_op_fn) {
-  // Create record of the commit.
-  monsoon::xdr::xdr_bytevector_ostream<> xdr;
-  wal_record_commit(tx_id).write(xdr);
-  assert(xdr.size() >= wal_record_end::XDR_SIZE);
-  wal_record_end().write(xdr);
+} /* namespace monsoon::tx::detail::<unnamed> */
+
+void wal_region::compact_background_(std::unique_lock<std::mutex>& log_lck) {
+  using lp_reader = monsoon::io::limited_stream_reader<monsoon::io::positional_reader>;
+  using lp_writer = monsoon::io::limited_stream_writer<monsoon::io::positional_writer>;
 
-  // Grab the WAL lock.
-  std::lock_guard<std::mutex> log_lck{ log_mtx_ };
-  assert(slot_begin_off(current_slot_) <= slot_off_ && slot_off_ < slot_end_off(current_slot_));
+  assert(log_lck.owns_lock() && log_lck.mutex() == &log_mtx_);
+  assert(!compacting_);
 
-#ifndef NDEBUG // Assert that the slot offset contains a record-end-marker.
+  // Transactions that are in progress.
+  std::vector<bool> tx_id_states;
   {
-    using lp_reader = monsoon::io::limited_stream_reader<monsoon::io::positional_reader>;
+    // Don't run a compaction if we know we won't free up any information.
+    std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
+    if (tx_id_completed_count_ == 0u) return;
+    tx_id_states = tx_id_states_;
+  }
 
-    assert(slot_end_off(current_slot_) - slot_off_ >= wal_record_end::XDR_SIZE);
+  // Records up to copy_end are copied while the log is unlocked.
+  // The pending writes up to this point are written to the file.
+  const auto old_slot = current_slot_;
+  const auto new_slot = 1u - old_slot;
+  const auto copy_end = slot_off_;
+  const std::shared_ptr<const snapshot> applied = state_;
+  monsoon::xdr::xdr_bytevector_ostream<> wal_segment_header;
+  wal_header(current_seq_ + 1u, applied->fd_size_).write(wal_segment_header);
+
+  ++background_compactions_;
+  compacting_ = true;
+  log_lck.unlock();
+
+  monsoon::io::fd::offset_type new_slot_off;
+  try {
+    auto xdr = monsoon::xdr::xdr_stream_writer<lp_writer>(lp_writer(
+            slot_end_off(new_slot) - slot_begin_off(new_slot) - wal_segment_header.size(),
+            fd_,
+            slot_begin_off(new_slot) + wal_segment_header.size()));
+
+    // Copy all information for in-progress transactions.
+    // Records after copy_end are being appended concurrently,
+    // so we must not read past it.
+    auto xdr_in = monsoon::xdr::xdr_stream_reader<lp_reader>(
+        lp_reader(copy_end - slot_begin_off(old_slot), fd_, slot_begin_off(old_slot)));
+    wal_header::read(xdr_in);
+    while (!xdr_in.at_end()) {
+      const auto record = wal_record::read(xdr_in);
+      if (!record->is_control_record()
+          && record->tx_id() < tx_id_states.size()
+          && tx_id_states[record->tx_id()])
+        record->write(xdr);
+    }
+    new_slot_off = xdr.underlying_stream().offset();
 
-    auto xdr_read = monsoon::xdr::xdr_stream_reader<lp_reader>(lp_reader(wal_record_end::XDR_SIZE, fd_, slot_off_));
-    const auto last_record = wal_record::read(xdr_read);
-    assert(last_record->is_end());
-    assert(xdr_read.at_end());
+    // Apply the replacement map.
+    // Readers and committers don't access these parts of the file,
+    // as they are covered by the pending writes until the compaction completes.
+    monsoon::io::aio aio;
+    for (const auto& r : applied->repl_)
+      aio.on(fd_).write_at(r.begin_offset() + wal_end_offset(), r.data(), r.size());
+    // Ensure all data is on disk, before activating the segment.
+    aio.on(fd_).flush(true);
+    ++file_flush_;
+    aio.start_and_join();
+  } catch (...) {
+    log_lck.lock();
+    throw;
   }
-#endif
 
-  // Run a compaction cycle if the log has insuficient space for the new data.
-  if (slot_end_off(current_slot_) - slot_off_ < xdr.size()) {
-    compact_();
-
-    if (slot_end_off(current_slot_) - slot_off_ < xdr.size())
-      throw wal_bad_alloc("no space in WAL");
-  }
-
-  // Grab the lock that protects against non-wal changes.
-  std::lock_guard<std::shared_mutex> lck{ mtx_ };
-
-  // Prepare a merging of the transactions in repl.
-  // We must prepare this after acquiring the mutex mtx_,
-  // but before the WAL record is written.
-  // We write into a copy of repl that we can swap later.
-  replacement_map new_repl = repl_;
-  for (const auto& w : writes)
-    new_repl.write_at(w.begin_offset(), w.data(), w.size()).commit();
-
-  // Prepare the undo map.
-  // This map holds all data overwritten by this transaction.
-  replacement_map undo;
-  for (const auto& w : writes) {
-    const std::unique_ptr<std::uint8_t[]> buf = std::make_unique<std::uint8_t[]>(w.size());
-
-    auto off = w.begin_offset();
-    while (off < w.end_offset()) {
-      std::size_t len = w.end_offset() - off;
-      assert(len <= w.size());
-
-      const auto rlen = repl_.read_at(off, buf.get(), len);
-      if (rlen != 0u) {
-        undo.write_at(off, buf.get(), rlen).commit();
-      } else if (off >= fd_size_) {
-        std::fill_n(buf.get(), len, std::uint8_t(0));
-        undo.write_at(off, buf.get(), len).commit();
-      } else {
-        if (len > fd_size_ - off) len = fd_size_ - off;
-        undo.write_at_from_file(off, fd_, off + wal_end_offset(), len).commit();
-      }
-      off += len;
+  log_lck.lock();
+  assert(current_slot_ == old_slot);
+  assert(copy_end <= slot_off_);
+
+  // Copy all records that were appended during the compaction.
+  // These are copied regardless of transaction state, since they hold
+  // the commits that have not been applied to the file.
+  std::vector<std::uint8_t> tail(slot_off_ - copy_end);
+  if (slot_end_off(new_slot) - new_slot_off < tail.size() + wal_record_end::XDR_SIZE)
+    return; // Doesn't fit, leave it for compact_().
+  {
+    auto buf = tail.data();
+    auto len = tail.size();
+    auto off = copy_end;
+    while (len > 0u) {
+      const auto rlen = fd_.read_at(off, buf, len);
+      if (rlen == 0u) throw wal_error("WAL log truncated");
+      buf += rlen;
+      len -= rlen;
+      off += rlen;
     }
   }
-
-  // Write everything but the record header.
-  // By not writing the record header, the transaction itself looks as if
-  // the commit hasn't happened, because there's a wal_record_end message.
+  monsoon::xdr::xdr_bytevector_ostream<> tail_xdr;
+  tail_xdr.put_opaque_n(tail.data(), tail.size());
+  wal_record_end().write(tail_xdr);
   {
-    auto buf = xdr.data() + wal_record_end::XDR_SIZE;
-    auto len = xdr.size() - wal_record_end::XDR_SIZE;
-    auto off = slot_off_ + wal_record_end::XDR_SIZE;
+    auto buf = tail_xdr.data();
+    auto len = tail_xdr.size();
+    auto off = new_slot_off;
     while (len > 0u) {
       const auto wlen = fd_.write_at(off, buf, len);
       buf += wlen;
       len -= wlen;
       off += wlen;
     }
-    fd_.flush(true);
-    ++file_flush_;
   }
+  fd_.flush(true);
+  ++file_flush_;
 
-  // Grab the allocation lock.
-  std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
-  assert(tx_id < tx_id_states_.size());
-  assert(tx_id_states_[tx_id]);
+  // Data covered by applied is now in the file.
+  auto new_state = std::make_shared<snapshot>();
+  new_state->fd_size_ = state_->fd_size_;
+  new_state->repl_ = without_applied(state_->repl_, applied->repl_);
 
-  // Write the marker of the record.
+  // Activate the new segment.
+  // As with compact_(), we don't flush after this write:
+  // both logs are equivalent until a new record is appended.
   {
-    auto buf = xdr.data();
-    auto len = wal_record_end::XDR_SIZE;
-    auto off = slot_off_;
-    while (len > 0u) {
+    auto buf = wal_segment_header.data();
+    auto len = wal_segment_header.size();
+    auto off = slot_begin_off(new_slot);
+    while (len > 0) {
       const auto wlen = fd_.write_at(off, buf, len);
       buf += wlen;
       len -= wlen;
       off += wlen;
     }
+  }
+
+  publish_(std::move(new_state));
+
+  {
+    std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
+    reset_tx_ids_(tx_id_states);
+  }
+
+  // Update segment information.
+  current_slot_ = new_slot;
+  slot_off_ = new_slot_off + tail.size();
+  ++current_seq_;
+  update_compaction_trigger_();
+}
+
+void wal_region::reset_tx_ids_(const std::vector<bool>& copied_states) noexcept {
+  // Transactions that completed during the compaction have records
+  // in the new segment, so their IDs can't be reused until the next compaction.
+  const auto was_completed = [&copied_states](wal_record::tx_id_type tx_id) -> bool {
+    return tx_id < copied_states.size() && !copied_states[tx_id];
+  };
+
+  while (!tx_id_states_.empty() && !tx_id_states_.back() && was_completed(tx_id_states_.size() - 1u))
+    tx_id_states_.pop_back();
+  while (!tx_id_avail_.empty()) tx_id_avail_.pop(); // tx_id_avail_ lacks a clear() method.
+  tx_id_completed_count_ = 0;
+  for (wal_record::tx_id_type tx_id = 0u; tx_id < tx_id_states_.size() && tx_id <= wal_record::tx_id_mask; ++tx_id) {
+    if (tx_id_states_[tx_id]) continue;
+    if (!was_completed(tx_id)) {
+      ++tx_id_completed_count_;
+      continue;
+    }
 
-    // If this flush fails, we can't recover.
-    // The commit has been written in full and any attempt to undo it
-    // would likely run into the same error as the flush operation.
-    // So we'll log it and silently continue.
-    //
-    // While we only require a dataflush, we do a full flush to get the
-    // file metadata synced up. Because it seems like a nice thing to do.
     try {
-      fd_.flush();
-      ++file_flush_;
+      tx_id_avail_.push(tx_id);
+    } catch (const std::bad_alloc&) {
+      // SKIP: ignore this exception
+    }
+  }
+}
+
+void wal_region::compactor_run_() noexcept {
+  std::unique_lock<std::mutex> lck{ log_mtx_ };
+  for (;;) {
+    compactor_cnd_.wait(lck, [this]() { return compactor_stop_ || compactor_wanted_; });
+    if (compactor_stop_) return;
+    compactor_wanted_ = false;
+
+    // If this fails, the next commit that runs out of space
+    // will compact the log instead.
+    try {
+      compact_background_(lck);
     } catch (const std::exception& e) {
-      std::cerr << "Warning: failed to flush WAL log: " << e.what() << std::endl;
+      std::cerr << "Warning: failed to compact WAL log: " << e.what() << std::endl;
     } catch (...) {
-      std::cerr << "Warning: failed to flush WAL log." << std::endl;
+      std::cerr << "Warning: failed to compact WAL log." << std::endl;
     }
+    assert(lck.owns_lock());
+
+    compacting_ = false;
+    compactor_cnd_.notify_all();
   }
+}
 
-  // Now commit the change in repl_.
-  swap(repl_, new_repl); // Never throws.
-  // And update the tx_id_states_.
-  tx_id_states_[tx_id] = false;
-  ++tx_id_completed_count_;
-  // Update the file size.
-  if (new_file_size.has_value()) {
-    fd_size_ = *new_file_size;
-    repl_.truncate(fd_size_);
+void wal_region::stop_compactor_() noexcept {
+  if (!compactor_.joinable()) return;
+
+  {
+    std::lock_guard<std::mutex> lck{ log_mtx_ };
+    compactor_stop_ = true;
   }
+  compactor_cnd_.notify_all();
+  compactor_.join();
+}
+
+void wal_region::maybe_start_compaction_() noexcept {
+  if (slot_off_ < compaction_trigger_off_ || compacting_ || compactor_wanted_) return;
+  if (!compactor_.joinable()) return;
 
-  // Advance slot offset.
-  slot_off_ += xdr.size() - wal_record_end::XDR_SIZE;
+  compactor_wanted_ = true;
+  compactor_cnd_.notify_all();
+}
 
-  undo_op_fn(std::move(undo));
+void wal_region::update_compaction_trigger_() noexcept {
+  const auto begin = slot_begin_off(current_slot_);
+  const auto end = slot_end_off(current_slot_);
+  const auto threshold_off = begin + static_cast<monsoon::io::fd::size_type>(std::floor(compaction_threshold_ * (end - begin)));
 
-  ++commit_count_;
+  // Wait for half the free space to be used, so that a log holding mostly
+  // in-progress transactions isn't compacted on every append.
+  compaction_trigger_off_ = std::max(threshold_off, slot_off_ + (end - slot_off_) / 2u);
+}
+
+struct wal_region::pending_commit_ {
+  pending_commit_(wal_record::tx_id_type tx_id, replacement_map&& writes, std::optional<monsoon::io::fd::size_type> new_file_size, std::function<void(replacement_map)>&& undo_op_fn)
+  : tx_id(tx_id),
+    writes(std::move(writes)),
+    new_file_size(new_file_size),
+    undo_op_fn(std::move(undo_op_fn))
+  {}
+
+  const wal_record::tx_id_type tx_id;
+  const replacement_map writes;
+  const std::optional<monsoon::io::fd::size_type> new_file_size;
+  const std::function<void(replacement_map)> undo_op_fn;
+
+  ///\brief Set once the commit has been processed.
+  ///\details Protected by commit_mtx_.
+  bool done = false;
+  ///\brief Exception that caused the commit to fail.
+  std::exception_ptr ex;
+};
+
+void wal_region::tx_commit_(wal_record::tx_id_type tx_id, replacement_map&& writes, std::optional<monsoon::io::fd::size_type> new_file_size, std::function<void(replacement_map)> undo_op_fn) {
+  pending_commit_ self(tx_id, std::move(writes), new_file_size, std::move(undo_op_fn));
+
+  // Group commit:
+  // commits that arrive while a batch is being written, are queued.
+  // Once the batch completes, one of the queued committers writes all
+  // queued commits as the next batch.
+  std::unique_lock<std::mutex> commit_lck{ commit_mtx_ };
+  commit_queue_.push_back(&self);
+  for (;;) {
+    commit_cnd_.wait(commit_lck, [this, &self]() { return self.done || !commit_leader_; });
+    if (self.done) break;
+
+    commit_leader_ = true;
+    const std::vector<pending_commit_*> batch(commit_queue_.begin(), commit_queue_.end());
+    commit_queue_.clear();
+    commit_lck.unlock();
+
+    const std::size_t processed = commit_batch_(batch);
+    assert(processed > 0u && processed <= batch.size());
+
+    commit_lck.lock();
+    std::for_each(
+        batch.begin(), batch.begin() + processed,
+        [](pending_commit_* c) { c->done = true; });
+    // Commits that didn't fit, go first in the next batch.
+    commit_queue_.insert(commit_queue_.begin(), batch.begin() + processed, batch.end());
+    commit_leader_ = false;
+    commit_cnd_.notify_all();
+  }
+  commit_lck.unlock();
+
+  if (self.ex) std::rethrow_exception(self.ex);
+}
+
+auto wal_region::commit_batch_(const std::vector<pending_commit_*>& batch) noexcept -> std::size_t {
+  assert(!batch.empty());
+
+  std::size_t n = batch.size(); // Number of commits in this batch.
+  try {
+    // Create the records of the commits, before grabbing the WAL lock.
+    // Each transaction has its write and resize records followed by its commit record.
+    // record_end[i] is the offset past the records of the i'th commit.
+    monsoon::xdr::xdr_bytevector_ostream<> xdr;
+    std::vector<std::size_t> record_end;
+    record_end.reserve(batch.size());
+    for (const pending_commit_* c : batch) {
+      for (const auto& w : c->writes)
+        wal_record_write::to_stream(xdr, c->tx_id, w.begin_offset(), w.data(), w.size());
+      if (c->new_file_size.has_value())
+        wal_record_resize(c->tx_id, *c->new_file_size).write(xdr);
+      wal_record_commit(c->tx_id).write(xdr);
+      record_end.push_back(xdr.size());
+    }
+    monsoon::xdr::xdr_bytevector_ostream<> end_xdr;
+    wal_record_end().write(end_xdr);
+    assert(end_xdr.size() == wal_record_end::XDR_SIZE);
+    assert(record_end.front() >= wal_record_end::XDR_SIZE);
+
+    const auto xdr_len = [&record_end](std::size_t n) -> std::size_t {
+      return record_end[n - 1u] + wal_record_end::XDR_SIZE;
+    };
+    const auto write_all = [this](monsoon::io::fd::offset_type off, const std::uint8_t* buf, std::size_t len) {
+      while (len > 0u) {
+        const auto wlen = fd_.write_at(off, buf, len);
+        buf += wlen;
+        len -= wlen;
+        off += wlen;
+      }
+    };
+
+    // Grab the WAL lock.
+    std::unique_lock<std::mutex> log_lck{ log_mtx_ };
+    assert(slot_begin_off(current_slot_) <= slot_off_ && slot_off_ < slot_end_off(current_slot_));
+
+#ifndef NDEBUG // Assert that the slot offset contains a record-end-marker.
+    {
+      using lp_reader = monsoon::io::limited_stream_reader<monsoon::io::positional_reader>;
+
+      assert(slot_end_off(current_slot_) - slot_off_ >= wal_record_end::XDR_SIZE);
+
+      auto xdr_read = monsoon::xdr::xdr_stream_reader<lp_reader>(lp_reader(wal_record_end::XDR_SIZE, fd_, slot_off_));
+      const auto last_record = wal_record::read(xdr_read);
+      assert(last_record->is_end());
+      assert(xdr_read.at_end());
+    }
+#endif
+
+    // Run a compaction cycle if the log has insuficient space for the new data.
+    if (slot_end_off(current_slot_) - slot_off_ < xdr_len(n)) {
+      make_space_(log_lck, xdr_len(n));
+
+      // Shrink the batch to fit.
+      while (n > 0u && slot_end_off(current_slot_) - slot_off_ < xdr_len(n)) --n;
+      if (n == 0u) {
+        n = 1u;
+        throw wal_bad_alloc("no space in WAL");
+      }
+    }
+
+    // Prepare a merging of the transactions in repl.
+    // We must prepare this before the WAL record is written.
+    // We write into a copy of the committed state, that we publish later.
+    // Readers continue to use the current state until then.
+    //
+    // Each commit is applied on top of the commits preceding it in the batch.
+    auto new_state = std::make_shared<snapshot>(*state_);
+    replacement_map& new_repl = new_state->repl_;
+    monsoon::io::fd::size_type& new_fd_size = new_state->fd_size_;
+    std::vector<replacement_map> undo(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      const pending_commit_& c = *batch[i];
+
+      // Prepare the undo map.
+      // This map holds all data overwritten by this transaction.
+      for (const auto& w : c.writes) {
+        const std::unique_ptr<std::uint8_t[]> buf = std::make_unique<std::uint8_t[]>(w.size());
+
+        auto off = w.begin_offset();
+        while (off < w.end_offset()) {
+          std::size_t len = w.end_offset() - off;
+          assert(len <= w.size());
+
+          const auto rlen = new_repl.read_at(off, buf.get(), len);
+          if (rlen != 0u) {
+            len = rlen; // Only the part in new_repl was read.
+            undo[i].write_at(off, buf.get(), rlen).commit();
+          } else if (off >= new_fd_size) {
+            std::fill_n(buf.get(), len, std::uint8_t(0));
+            undo[i].write_at(off, buf.get(), len).commit();
+          } else {
+            if (len > new_fd_size - off) len = new_fd_size - off;
+            undo[i].write_at_from_file(off, fd_, off + wal_end_offset(), len).commit();
+          }
+          off += len;
+        }
+      }
+
+      for (const auto& w : c.writes)
+        new_repl.write_at(w.begin_offset(), w.data(), w.size()).commit();
+      // Update the file size.
+      if (c.new_file_size.has_value()) {
+        new_fd_size = *c.new_file_size;
+        new_repl.truncate(new_fd_size);
+      }
+    }
+
+    // Write everything but the record header, followed by a new end marker.
+    // By not writing the record header, the transactions look as if
+    // the commit hasn't happened, because there's a wal_record_end message.
+    {
+      write_all(
+          slot_off_ + wal_record_end::XDR_SIZE,
+          xdr.data() + wal_record_end::XDR_SIZE,
+          record_end[n - 1u] - wal_record_end::XDR_SIZE);
+      write_all(slot_off_ + record_end[n - 1u], end_xdr.data(), end_xdr.size());
+      fd_.flush(true);
+      ++file_flush_;
+    }
+
+    // Grab the allocation lock.
+    std::lock_guard<std::mutex> alloc_lck{ alloc_mtx_ };
+#ifndef NDEBUG
+    std::for_each(
+        batch.begin(), batch.begin() + n,
+        [this](const pending_commit_* c) {
+          assert(c->tx_id < tx_id_states_.size());
+          assert(tx_id_states_[c->tx_id]);
+        });
+#endif
+
+    // Write the marker of the first record.
+    // This activates all commits in the batch at once.
+    {
+      write_all(slot_off_, xdr.data(), wal_record_end::XDR_SIZE);
+
+      // If this flush fails, we can't recover.
+      // The commit has been written in full and any attempt to undo it
+      // would likely run into the same error as the flush operation.
+      // So we'll log it and silently continue.
+      //
+      // While we only require a dataflush, we do a full flush to get the
+      // file metadata synced up. Because it seems like a nice thing to do.
+      try {
+        fd_.flush();
+        ++file_flush_;
+      } catch (const std::exception& e) {
+        std::cerr << "Warning: failed to flush WAL log: " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "Warning: failed to flush WAL log." << std::endl;
+      }
+    }
+
+    // Now publish the committed state.
+    publish_(std::move(new_state));
+    // And update the tx_id_states_.
+    std::for_each(
+        batch.begin(), batch.begin() + n,
+        [this](const pending_commit_* c) {
+          tx_id_states_[c->tx_id] = false;
+        });
+    tx_id_completed_count_ += n;
+
+    // Advance slot offset.
+    slot_off_ += record_end[n - 1u];
+    maybe_start_compaction_();
+
+    for (std::size_t i = 0; i < n; ++i) {
+      try {
+        batch[i]->undo_op_fn(std::move(undo[i]));
+      } catch (...) {
+        batch[i]->ex = std::current_exception();
+      }
+      ++commit_count_;
+    }
+  } catch (...) {
+    // None of the commits in the batch happened.
+    std::for_each(
+        batch.begin(), batch.begin() + n,
+        [ex = std::current_exception()](pending_commit_* c) {
+          c->ex = ex;
+        });
+  }
+
+  return n;
 }
 
 void wal_region::tx_rollback_(wal_record::tx_id_type tx_id) noexcept {
@@ -831,13 +1172,16 @@ void wal_region::tx::write_at(monsoon::io::fd::offset_type off, const void* buf,
   if (off > file_size || file_size - monsoon::io::fd::size_type(off) < len)
     throw std::length_error("write past end of file (based on local transaction resize)");
 
-  auto writes_tx = writes_.write_at(off, buf, len);
-  std::shared_ptr<wal_region>(wal_)->tx_write_(tx_id_, off, buf, len);
-  writes_tx.commit();
+  // The write is logged when the transaction commits.
+  writes_.write_at(off, buf, len).commit();
 }
 
 void wal_region::tx::resize(monsoon::io::fd::size_type new_size) {
-  std::shared_ptr<wal_region>(wal_)->tx_resize_(tx_id_, new_size);
+  if (new_size > std::numeric_limits<std::uint64_t>::max())
+    throw std::overflow_error("wal_region::tx::resize");
+  if (wal_.expired()) throw std::bad_weak_ptr();
+
+  // The resize is logged when the transaction commits.
   new_file_size_.emplace(new_size);
 }
 
@@ -857,7 +1201,10 @@ void wal_region::tx::rollback() noexcept {
 }
 
 auto wal_region::tx::read_at(monsoon::io::fd::offset_type off, void* buf, std::size_t len) const -> std::size_t {
+  // Using the current snapshot gives read-committed isolation:
+  // data in the file is always that of a committed transaction.
   return read_at(
+      *std::shared_ptr<wal_region>(wal_)->current_snapshot(),
       off, buf, len,
       []([[maybe_unused]] const auto& off, [[maybe_unused]] const auto& buf, [[maybe_unused]] const auto& len) -> std::size_t {
         return 0u;
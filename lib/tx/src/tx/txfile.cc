@@ -1,5 +1,6 @@
 #include <monsoon/tx/txfile.h>
 #include <monsoon/tx/sequence.h>
+#include <functional>
 #include <mutex>
 #include <type_traits>
 
@@ -31,7 +32,14 @@ template<typename CB>
 txfile::transaction::transaction(bool read_only, const std::shared_ptr<impl_>& owner, CB&& cb)
 : read_only_(read_only),
   owner_(owner.get()),
-  seq_(std::shared_ptr<detail::tx_sequencer>(owner, &owner->sequencer_), cb),
+  seq_(
+      std::shared_ptr<detail::tx_sequencer>(owner, &owner->sequencer_),
+      [this, &owner, &cb]() {
+        // Taking the snapshot while the sequencer is locked ensures that
+        // commits not in the snapshot are sequenced after this transaction.
+        snapshot_ = owner->wal_.current_snapshot();
+        std::invoke(cb);
+      }),
   wal_(std::shared_ptr<detail::wal_region>(owner, &owner->wal_))
 {}
 
@@ -54,6 +62,7 @@ auto txfile::transaction::read_at(offset_type off, void* buf, std::size_t nbytes
   if (!*this) throw txfile_bad_transaction("txfile::transaction::read_at");
 
   return wal_.read_at(
+      *snapshot_,
       off, buf, nbytes,
       [this](offset_type off, void* buf, std::size_t& nbytes) -> std::size_t {
         // Read from the recorded change-sets of each transaction.
@@ -71,6 +80,9 @@ void txfile::transaction::commit() {
         });
   }
 
+  // Release the snapshot and the before-images it may require.
+  snapshot_.reset();
+  seq_ = detail::tx_sequencer::tx();
   owner_ = nullptr;
 }
 
@@ -78,6 +90,8 @@ void txfile::transaction::rollback() noexcept {
   if (!*this) return;
 
   wal_.rollback();
+  snapshot_.reset();
+  seq_ = detail::tx_sequencer::tx();
   owner_ = nullptr;
 }
 
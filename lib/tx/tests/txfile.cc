@@ -125,6 +125,28 @@ TEST(cant_see_started_before_commited_after_data) {
   CHECK_EQUAL(u8"XXXXXX", read(tx2));
 }
 
+TEST(cant_see_commits_written_to_file) {
+  // Small WAL, so that committed data is compacted into the file.
+  auto f = txfile::create(__func__, TMPFILE(), 0, 4096);
+  {
+    auto tx = f.begin(false);
+    tx.resize(6);
+    write_all_at(tx, 0, u8"XXXXXX");
+    tx.commit();
+  }
+
+  auto ro = f.begin();
+  for (int i = 0; i < 200; ++i) {
+    auto tx = f.begin(false);
+    write_all_at(tx, 0, (i % 2 == 0 ? u8"barfoo" : u8"foobar"));
+    tx.commit();
+
+    CHECK_EQUAL(u8"XXXXXX", read(ro));
+  }
+
+  CHECK_EQUAL(u8"foobar", read(f));
+}
+
 int main() {
   return UnitTest::RunAllTests();
 }
@@ -5,6 +5,8 @@
 #include <monsoon/io/positional_stream.h>
 #include <stdexcept>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 using monsoon::tx::detail::wal_region;
 
@@ -239,6 +241,65 @@ TEST(write_and_commit_and_reopen) {
   check_file_equals(u8"01234567", wal->fd(), 256);
 }
 
+TEST(concurrent_commits) {
+  constexpr unsigned int threads = 8, commits = 50;
+  auto wal = std::make_shared<wal_region>("waltest", wal_region::create(), TMPFILE(), 0, 4096);
+  {
+    auto tx = wal_region::tx(wal);
+    tx.resize(threads * sizeof(std::uint32_t));
+    tx.commit();
+  }
+
+  std::vector<std::thread> workers;
+  for (std::uint32_t t = 0; t < threads; ++t) {
+    workers.emplace_back(
+        [wal, t]() {
+          for (std::uint32_t i = 1; i <= commits; ++i) {
+            auto tx = wal_region::tx(wal);
+            tx.write_at(t * sizeof(i), &i, sizeof(i));
+            tx.commit();
+          }
+        });
+  }
+  for (auto& w : workers) w.join();
+
+  wal = std::make_shared<wal_region>("waltest", std::move(*wal).fd(), 0, 4096);
+  for (std::uint32_t t = 0; t < threads; ++t) {
+    std::uint32_t v = 0;
+    CHECK_EQUAL(sizeof(v), wal->read_at(t * sizeof(v), &v, sizeof(v)));
+    CHECK_EQUAL(commits, v);
+  }
+}
+
+TEST(background_compaction) {
+  constexpr std::uint32_t commits = 200;
+  auto wal = std::make_shared<wal_region>("waltest", wal_region::create(), TMPFILE(), 0, 512);
+  wal->set_compaction_threshold(0.0);
+  {
+    auto tx = wal_region::tx(wal);
+    tx.resize(2 * sizeof(std::uint32_t));
+    tx.commit();
+  }
+
+  // A transaction that stays in progress while the log is compacted.
+  auto long_tx = wal_region::tx(wal);
+  const std::uint32_t long_v = 17;
+  long_tx.write_at(sizeof(long_v), &long_v, sizeof(long_v));
+
+  for (std::uint32_t i = 1; i <= commits; ++i) {
+    auto tx = wal_region::tx(wal);
+    tx.write_at(0, &i, sizeof(i));
+    tx.commit();
+  }
+  long_tx.commit();
+
+  wal = std::make_shared<wal_region>("waltest", std::move(*wal).fd(), 0, 512);
+  std::uint32_t v[2] = { 0, 0 };
+  CHECK_EQUAL(sizeof(v), wal->read_at(0, &v, sizeof(v)));
+  CHECK_EQUAL(commits, v[0]);
+  CHECK_EQUAL(long_v, v[1]);
+}
+
 int main() {
   return UnitTest::RunAllTests();
 }